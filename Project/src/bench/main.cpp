@@ -0,0 +1,433 @@
+#include <chrono>
+#include <fstream>
+
+#include "raytracing/core.hpp"
+#include "raytracing/acceleration_structures/sah_builder.hpp"
+#include "raytracing/acceleration_structures/wide_bvh.hpp"
+#include "utils/parallel.hpp"
+
+// Micro- and macro-benchmarks, to track performance across commits on the same machine:
+//   TinyTracerBench [--scenes NAME,NAME,...] [--sizes N,N,...] [--mesh FILE.obj|.tmesh] [--rays N] [--repeat N] [--width W] [--height H] [--spp N]
+//                   [--threads N] [--output FILE.csv|.json]
+// Every scene is generated at every size with a fixed seed and every number is the best of --repeat runs. A --mesh is loaded, traced and
+// rendered after them. Without --output the results are only logged
+
+struct BenchOptions {
+	vector<SceneType> scenes = { SceneType::Uniform, SceneType::Clustered };
+	vector<int> sizes = { 1000, 10000, 100000, 1000000 };
+	std::filesystem::path mesh;
+	int rays = 1000000;
+	int repeat = 3;
+	RenderSettings settings;
+	std::filesystem::path output;
+};
+
+struct BenchResult {
+	string benchmark;
+	string scene;
+	int primitives;
+	double value;
+	string unit;
+};
+
+static void PrintUsage() {
+	spdlog::info("Usage: TinyTracerBench [--scenes NAME,NAME,...] [--sizes N,N,...] [--mesh FILE.obj|.tmesh] [--rays N] [--repeat N] [--width W] [--height H] [--spp N] [--threads N] [--output FILE.csv|.json]");
+}
+
+static bool ParseOptions(int argc, char** argv, BenchOptions& options) {
+	for (int i = 1; i < argc; i++) {
+		cstring argument = argv[i];
+		if (IsStringEqual(argument, "--help") || IsStringEqual(argument, "-h")) {
+			return false;
+		}
+
+		if (i + 1 >= argc) {
+			spdlog::error("Missing value for {}", argument);
+			return false;
+		}
+		cstring value = argv[++i];
+
+		RenderSettings& settings = options.settings;
+		if (IsStringEqual(argument, "--scenes")) {
+			options.scenes.clear();
+			std::stringstream list(value);
+			string name;
+			while (std::getline(list, name, ',')) {
+				SceneType type;
+				if (!SceneGenerator::ParseType(name.c_str(), type) || type == SceneType::Default || type == SceneType::Mesh) {
+					spdlog::error("Unknown scene {}, use uniform, clustered, grid, shells or manylights", name);
+					return false;
+				}
+				options.scenes.push_back(type);
+			}
+		}
+		else if (IsStringEqual(argument, "--sizes")) {
+			options.sizes.clear();
+			std::stringstream list(value);
+			string size;
+			while (std::getline(list, size, ',')) {
+				options.sizes.push_back(std::atoi(size.c_str()));
+			}
+		}
+		else if (IsStringEqual(argument, "--mesh")) {
+			options.mesh = value;
+		}
+		else if (IsStringEqual(argument, "--rays")) {
+			options.rays = std::atoi(value);
+		}
+		else if (IsStringEqual(argument, "--repeat")) {
+			options.repeat = std::atoi(value);
+		}
+		else if (IsStringEqual(argument, "--width")) {
+			settings.width = std::atoi(value);
+		}
+		else if (IsStringEqual(argument, "--height")) {
+			settings.height = std::atoi(value);
+		}
+		else if (IsStringEqual(argument, "--spp")) {
+			settings.samplesPerPixel = std::atoi(value);
+		}
+		else if (IsStringEqual(argument, "--threads")) {
+			settings.threadCount = std::atoi(value);
+		}
+		else if (IsStringEqual(argument, "--output") || IsStringEqual(argument, "-o")) {
+			options.output = value;
+		}
+		else {
+			spdlog::error("Unknown option {}", argument);
+			return false;
+		}
+	}
+
+	for (int size : options.sizes) {
+		if (size <= 0 || size > 10000000) {
+			spdlog::error("Scene sizes should be between 1 and 10000000, got {}", size);
+			return false;
+		}
+	}
+
+	const RenderSettings& settings = options.settings;
+	if (options.rays <= 0 || options.repeat <= 0 || settings.width <= 0 || settings.height <= 0 || settings.samplesPerPixel <= 0 || settings.threadCount < 0) {
+		spdlog::error("Rays, repeat, resolution and samples per pixel should be positive, thread count not negative");
+		return false;
+	}
+
+	string extension = options.output.extension().string();
+	if (!options.output.empty() && extension != ".csv" && extension != ".json") {
+		spdlog::error("Unsupported output format {}, use .csv or .json", extension);
+		return false;
+	}
+
+	return true;
+}
+
+// Best wall time of repeat runs of body, in seconds
+template<typename Function>
+static double MeasureBest(int repeat, const Function& body) {
+	double best = INFINITY;
+	for (int i = 0; i < repeat; i++) {
+#ifdef STATS
+		if (stats != nullptr) {
+			*stats = Stats();
+		}
+#endif
+		auto start = std::chrono::steady_clock::now();
+		body();
+		auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double>(end - start).count());
+	}
+	return best;
+}
+
+static Ray CreateRandomRay(RandomGenerator& random, float extent) {
+	float3 origin = float3(random.NextFloat() - 0.5f, random.NextFloat() - 0.5f, random.NextFloat() - 0.5f) * extent;
+	float3 direction = normalize(float3(random.NextFloat() - 0.5f, random.NextFloat() - 0.5f, random.NextFloat() - 0.5f));
+	return Ray(origin, direction);
+}
+
+static void BenchmarkPrimitives(const BenchOptions& options, vector<BenchResult>& results) {
+	// Every ray is tested against every object, so the loop runs options.rays tests in total
+	constexpr int OBJECT_COUNT = 1024;
+	int rayCount = std::max(1, options.rays / OBJECT_COUNT);
+
+	RandomGenerator random(1, 0, 0);
+	vector<Ray> rays;
+	for (int i = 0; i < rayCount; i++) {
+		rays.push_back(CreateRandomRay(random, 8.0f));
+	}
+
+	vector<AABB> boxes;
+	vector<Sphere> spheres;
+	TriangleSoA triangles;
+	for (int i = 0; i < OBJECT_COUNT; i++) {
+		float3 center = float3(random.NextFloat() - 0.5f, random.NextFloat() - 0.5f, random.NextFloat() - 0.5f) * 8.0f;
+		float3 halfSize = float3(0.1f + random.NextFloat(), 0.1f + random.NextFloat(), 0.1f + random.NextFloat());
+		boxes.push_back(AABB(center - halfSize, center + halfSize));
+		spheres.emplace_back(center, 0.1f + random.NextFloat());
+		triangles.Add(center - halfSize, center + float3(halfSize.x, -halfSize.y, 0.0f), center + float3(0.0f, halfSize.y, halfSize.z), -1);
+	}
+
+	// The hit counts are kept so the tests cannot be optimized away
+	Interval rayLength = Interval(0, INFINITY);
+	int boxHits = 0;
+	double boxTime = MeasureBest(options.repeat, [&]() {
+		for (const Ray& ray : rays) {
+			for (const AABB& box : boxes) {
+				boxHits += box.IntersectRayAABB(ray, rayLength) ? 1 : 0;
+			}
+		}
+	});
+
+	int sphereHits = 0;
+	double sphereTime = MeasureBest(options.repeat, [&]() {
+		IntersectionPoint intersectionPoint;
+		for (const Ray& ray : rays) {
+			for (const Sphere& sphere : spheres) {
+				sphereHits += sphere.Hit(ray, rayLength, intersectionPoint) ? 1 : 0;
+			}
+		}
+	});
+
+	int triangleHits = 0;
+	double triangleTime = MeasureBest(options.repeat, [&]() {
+		float t;
+		for (const Ray& ray : rays) {
+			for (int i = 0; i < OBJECT_COUNT; i++) {
+				triangleHits += IntersectTriangle(ray, triangles.GetVertex(i), triangles.GetEdge1(i), triangles.GetEdge2(i), 0.0f, INFINITY, t) ? 1 : 0;
+			}
+		}
+	});
+
+	// The leaf kernel, several triangles per instruction
+	int triangleSoAHits = 0;
+	double triangleSoATime = MeasureBest(options.repeat, [&]() {
+		for (const Ray& ray : rays) {
+			float tMax = INFINITY;
+			triangleSoAHits += triangles.IntersectClosest(0, OBJECT_COUNT, ray, 0.0f, tMax) >= 0 ? 1 : 0;
+		}
+	});
+
+	double testCount = (double)rayCount * OBJECT_COUNT;
+	results.push_back({ "aabb_intersect", "random", OBJECT_COUNT, testCount / boxTime * 1e-6, "Mtests/s" });
+	results.push_back({ "sphere_hit", "random", OBJECT_COUNT, testCount / sphereTime * 1e-6, "Mtests/s" });
+	results.push_back({ "triangle_intersect", "random", OBJECT_COUNT, testCount / triangleTime * 1e-6, "Mtests/s" });
+	results.push_back({ "triangle_soa_closest", "random", OBJECT_COUNT, testCount / triangleSoATime * 1e-6, "Mtests/s" });
+	spdlog::info("Bench | AABB::IntersectRayAABB: {:.1f} Mtests/s | Sphere::Hit: {:.1f} Mtests/s | Hits: {} {}", testCount / boxTime * 1e-6, testCount / sphereTime * 1e-6, boxHits, sphereHits);
+	spdlog::info("Bench | IntersectTriangle: {:.1f} Mtests/s | TriangleSoA::IntersectClosest: {:.1f} Mtests/s | Hits: {} {}", testCount / triangleTime * 1e-6,
+		testCount / triangleSoATime * 1e-6, triangleHits, triangleSoAHits);
+}
+
+// Closest hit and occlusion through the same tree the ray tracer traverses
+static void BenchmarkTraversal(const BenchOptions& options, const Scene& scene, const string& sceneName, vector<BenchResult>& results) {
+	int primitives = scene.GetObjectsCount();
+
+	LinearBVH* bvh = nullptr;
+	double buildTime = MeasureBest(options.repeat, [&]() {
+		delete bvh;
+		SAHBuilder builder(options.settings.bvhSettings);
+		bvh = builder.Build(scene.GetObjectsCopy());
+		bvh->GatherSphereData(scene.GetSphereData());
+		bvh->GatherTriangleData();
+	});
+#if BVH_WIDTH == 4 || BVH_WIDTH == 8
+	WideBVH<BVH_WIDTH> wideBVH(*bvh);
+	auto Hit = [&](const Ray& ray, const Interval& rayLength, IntersectionPoint& intersectionPoint) { return wideBVH.Hit(ray, rayLength, intersectionPoint); };
+	auto Occluded = [&](const Ray& ray, const Interval& rayLength) { return wideBVH.Occluded(ray, rayLength); };
+#else
+	auto Hit = [&](const Ray& ray, const Interval& rayLength, IntersectionPoint& intersectionPoint) { return bvh->Hit(ray, rayLength, intersectionPoint); };
+	auto Occluded = [&](const Ray& ray, const Interval& rayLength) { return bvh->Occluded(ray, rayLength); };
+#endif
+
+	// Primary rays through random pixels, and shadow rays from their hits to the first light
+	const RenderSettings& settings = options.settings;
+	Camera camera(settings, scene.GetCameraPosition(), scene.GetCameraPosition() + float3(0.f, 0.f, 1.f));
+	RandomGenerator random(2, 0, 0);
+	vector<Ray> primaryRays;
+	for (int i = 0; i < options.rays; i++) {
+		primaryRays.push_back(camera.GeneratePrimaryRay(random.NextFloat() * settings.width, random.NextFloat() * settings.height));
+	}
+
+	vector<IntersectionPoint> intersectionPoints(primaryRays.size());
+	double hitTime = MeasureBest(options.repeat, [&]() {
+		for (size_t i = 0; i < primaryRays.size(); i++) {
+			intersectionPoints[i] = IntersectionPoint();
+			Hit(primaryRays[i], Interval(0, INFINITY), intersectionPoints[i]);
+		}
+	});
+
+	vector<Ray> shadowRays;
+	vector<float> shadowLengths;
+	const float3 lightPosition = scene.GetLights().empty() ? float3(0.0f) : scene.GetLights()[0]->position;
+	for (const IntersectionPoint& intersectionPoint : intersectionPoints) {
+		if (intersectionPoint.objectID != -1) {
+			float3 origin = intersectionPoint.point + OFFSET * intersectionPoint.normal;
+			float3 toLight = lightPosition - origin;
+			shadowRays.push_back(Ray(origin, normalize(toLight)));
+			shadowLengths.push_back(length(toLight));
+		}
+	}
+
+	int occluded = 0;
+	double occlusionTime = MeasureBest(options.repeat, [&]() {
+		for (size_t i = 0; i < shadowRays.size(); i++) {
+			occluded += Occluded(shadowRays[i], Interval(0, shadowLengths[i])) ? 1 : 0;
+		}
+	});
+	delete bvh;
+
+	double hitRate = primaryRays.size() / hitTime * 1e-6;
+	double occlusionRate = shadowRays.empty() ? 0.0 : shadowRays.size() / occlusionTime * 1e-6;
+	results.push_back({ "bvh_build", sceneName, primitives, buildTime * 1e3, "ms" });
+	results.push_back({ "closest_hit", sceneName, primitives, hitRate, "Mrays/s" });
+	results.push_back({ "occlusion", sceneName, primitives, occlusionRate, "Mrays/s" });
+	spdlog::info("Bench | {} {} | Build: {:.2f} ms | Closest hit: {:.2f} Mrays/s | Occlusion: {:.2f} Mrays/s ({} of {} occluded)", sceneName, primitives,
+		buildTime * 1e3, hitRate, occlusionRate, occluded / options.repeat, shadowRays.size());
+}
+
+// Every sphere takes a small random step per frame, and the BVH follows through RayTracer::UpdateBVH instead of a full build.
+// Moves them back afterwards
+static void BenchmarkUpdate(const BenchOptions& options, Scene& scene, const string& sceneName, vector<BenchResult>& results) {
+	const SphereSoA& spheres = scene.GetSphereData();
+	if (spheres.Size() != scene.GetObjectsCount()) {
+		return;
+	}
+
+	vector<float3> centers;
+	for (int i = 0; i < spheres.Size(); i++) {
+		centers.push_back(spheres.GetCenter(i));
+	}
+
+	spdlog::set_level(spdlog::level::warn);
+	RayTracer rayTracer(options.settings);
+	rayTracer.BuildBVH(scene, options.settings.bvhSettings);
+
+	RandomGenerator random(3, 0, 0);
+	double updateTime = MeasureBest(options.repeat, [&]() {
+		for (int i = 0; i < spheres.Size(); i++) {
+			float3 step = float3(random.NextFloat() - 0.5f, random.NextFloat() - 0.5f, random.NextFloat() - 0.5f) * 0.2f;
+			scene.SetSphereCenter(spheres.GetObjectID(i), spheres.GetCenter(i) + step);
+		}
+		rayTracer.UpdateBVH(scene, options.settings.bvhSettings);
+	});
+	spdlog::set_level(spdlog::level::info);
+
+	for (int i = 0; i < spheres.Size(); i++) {
+		scene.SetSphereCenter(spheres.GetObjectID(i), centers[i]);
+	}
+
+	results.push_back({ "bvh_update", sceneName, scene.GetObjectsCount(), updateTime * 1e3, "ms" });
+	spdlog::info("Bench | {} {} | Move and update: {:.2f} ms", sceneName, scene.GetObjectsCount(), updateTime * 1e3);
+}
+
+// Whole GetPixels calls, tiles, threads and shading included. Core takes ownership of the scene
+static void BenchmarkFrame(const BenchOptions& options, Scene* scene, const string& sceneName, vector<BenchResult>& results) {
+	int primitives = scene->GetObjectsCount();
+#ifdef STATS
+	Stats* benchStats = stats;
+#endif
+
+	spdlog::set_level(spdlog::level::warn);
+	Core* core = new Core(options.settings, scene);
+	vector<uchar> pixels(options.settings.GetPixelCount() * 4);
+	double frameTime = MeasureBest(options.repeat, [&]() {
+		core->GetPixels(pixels.data());
+	});
+	delete core;
+	spdlog::set_level(spdlog::level::info);
+
+#ifdef STATS
+	// The render clears the counters pointer of every thread it ran on, this one included
+	stats = benchStats;
+#endif
+
+	results.push_back({ "frame", sceneName, primitives, frameTime * 1e3, "ms" });
+	spdlog::info("Bench | {} {} | Frame: {:.2f} ms at {}x{}, {} spp", sceneName, primitives, frameTime * 1e3, options.settings.width, options.settings.height,
+		options.settings.samplesPerPixel);
+}
+
+static bool WriteResults(const BenchOptions& options, const vector<BenchResult>& results) {
+	std::ofstream file(options.output);
+	if (!file) {
+		spdlog::error("Cannot open {} for writing", options.output.string());
+		return false;
+	}
+
+	if (options.output.extension() == ".csv") {
+		file << "benchmark,scene,primitives,value,unit\n";
+		for (const BenchResult& result : results) {
+			file << result.benchmark << "," << result.scene << "," << result.primitives << "," << result.value << "," << result.unit << "\n";
+		}
+		return true;
+	}
+
+	file << "{\n";
+	file << "  \"accelerationStructure\": \"" << ACC_STRUCT_STRING << "\",\n";
+	file << "  \"threads\": " << ResolveThreadCount(options.settings.threadCount) << ",\n";
+	file << "  \"results\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchResult& result = results[i];
+		file << "    { \"benchmark\": \"" << result.benchmark << "\", \"scene\": \"" << result.scene << "\", \"primitives\": " << result.primitives
+			<< ", \"value\": " << result.value << ", \"unit\": \"" << result.unit << "\" }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	file << "  ]\n";
+	file << "}\n";
+	return true;
+}
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+	if (!ParseOptions(argc, argv, options)) {
+		PrintUsage();
+		return 1;
+	}
+
+#ifdef STATS
+	// The counters stay on, so the numbers match what rendering pays for them
+	Stats benchStats;
+	stats = &benchStats;
+#endif
+
+	vector<BenchResult> results;
+	BenchmarkPrimitives(options, results);
+
+	for (SceneType type : options.scenes) {
+		for (int size : options.sizes) {
+			SceneSettings sceneSettings;
+			sceneSettings.type = type;
+			sceneSettings.primitiveCount = size;
+			Scene* scene = SceneGenerator::Generate(sceneSettings);
+			BenchmarkTraversal(options, *scene, SceneGenerator::GetName(type), results);
+			BenchmarkUpdate(options, *scene, SceneGenerator::GetName(type), results);
+			BenchmarkFrame(options, scene, SceneGenerator::GetName(type), results);
+		}
+	}
+
+	if (!options.mesh.empty()) {
+		SceneSettings sceneSettings;
+		sceneSettings.type = SceneType::Mesh;
+		sceneSettings.meshPath = options.mesh.string();
+		Scene* scene = nullptr;
+		double loadTime = MeasureBest(options.repeat, [&]() {
+			delete scene;
+			scene = SceneGenerator::Generate(sceneSettings);
+		});
+		if (scene == nullptr) {
+			return 1;
+		}
+
+		string sceneName = options.mesh.filename().string();
+		results.push_back({ "mesh_load", sceneName, scene->GetObjectsCount(), loadTime * 1e3, "ms" });
+		spdlog::info("Bench | {} {} | Load: {:.2f} ms", sceneName, scene->GetObjectsCount(), loadTime * 1e3);
+		BenchmarkTraversal(options, *scene, sceneName, results);
+		BenchmarkFrame(options, scene, sceneName, results);
+	}
+
+	if (!options.output.empty()) {
+		if (!WriteResults(options, results)) {
+			return 1;
+		}
+		spdlog::info("Results written to {}", options.output.string());
+	}
+
+	return 0;
+}
@@ -6,6 +6,8 @@ void glfw_error_callback(int error_code, cstring message) {
 }
 
 GlfwInitialization::GlfwInitialization() {
+	PROFILE_SCOPE("GLFW initialization");
+
 	glfwSetErrorCallback(glfw_error_callback);
 
 	if (glfwInit() != GLFW_TRUE) {
@@ -3,6 +3,7 @@
 #include "glfw_monitor.hpp"
 
 Window::Window(cstring name, int2 size) {
+	PROFILE_SCOPE("Create window");
 
 #if OPENGL
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -59,4 +60,8 @@ bool Window::TryMoveToPrimaryMonitor() {
 void Window::ProcessUserInput() {
 	if (glfwGetKey(m_pWindow, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(m_pWindow, true);
+}
+
+bool Window::IsKeyDown(int key) const {
+	return glfwGetKey(m_pWindow, key) == GLFW_PRESS;
 }
\ No newline at end of file
@@ -13,6 +13,7 @@ public:
 
 	bool TryMoveToPrimaryMonitor();
 	void ProcessUserInput();
+	bool IsKeyDown(int key) const;
 
 private:
 	GLFWwindow* m_pWindow;
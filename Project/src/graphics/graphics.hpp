@@ -19,7 +19,9 @@ public:
 	virtual void CreateVertexBuffer(span<Vertex> vertices) = 0;
 	virtual void CreateIndexBuffer(span<int> indices) = 0;
 	virtual void SetViewProjection(mat4 view, mat4 projection) = 0;
-	virtual void CreateTexture(uchar* pixels) = 0;
+	virtual void CreateTexture(uchar* pixels, int2 size) = 0;
+	// Uploads new pixels into the texture made by CreateTexture, reusing its image and upload memory. Call outside BeginFrame/EndFrame
+	virtual void UpdateTexture(const uchar* pixels) = 0;
 	virtual void RenderIndexedBuffer() = 0;
 
 protected:
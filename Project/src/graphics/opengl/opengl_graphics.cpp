@@ -70,6 +70,8 @@ bool OpenGLGraphics::BeginFrame() {
 }
 
 void OpenGLGraphics::EndFrame() {
+	PROFILE_SCOPE("Swap buffers");
+
 	glfwSwapBuffers(m_pWindow->GetHandle());
 }
 
@@ -111,18 +113,31 @@ void OpenGLGraphics::SetViewProjection(mat4 view, mat4 projection) { }
 
 #pragma region Texture
 
-void OpenGLGraphics::CreateTexture(uchar* pixels)
+void OpenGLGraphics::CreateTexture(uchar* pixels, int2 size)
 {
+	PROFILE_SCOPE("Create texture");
+
 	m_pPixels = pixels;
+	m_textureSize = size;
 	glGenTextures(1, &m_texture);
 	glBindTexture(GL_TEXTURE_2D, m_texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, IMAGE_WIDTH, IMAGE_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_pPixels);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_pPixels);
 	float borderColor[] = { 1.0f, 1.0f, 0.0f, 1.0f };
 	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 }
 
+void OpenGLGraphics::UpdateTexture(const uchar* pixels)
+{
+	PROFILE_SCOPE("Upload texture");
+
+	// Overwrites the existing storage instead of reallocating it with glTexImage2D
+	m_pPixels = pixels;
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_textureSize.x, m_textureSize.y, GL_RGBA, GL_UNSIGNED_BYTE, m_pPixels);
+}
+
 #pragma endregion
 
 #pragma region Class
@@ -135,6 +150,8 @@ OpenGLGraphics::~OpenGLGraphics() {
 }
 
 void OpenGLGraphics::Initialize() {
+	PROFILE_SCOPE("OpenGL initialization");
+
 	// Load GLAD
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
 		std::exit(EXIT_FAILURE); // TODO: Verify if this calls SPDLog
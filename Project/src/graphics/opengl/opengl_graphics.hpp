@@ -13,7 +13,8 @@ public:
 
 	void CreateVertexBuffer(span<Vertex> vertices) override;
 	void CreateIndexBuffer(span<int> indices) override;
-	void CreateTexture(uchar* pixels) override;
+	void CreateTexture(uchar* pixels, int2 size) override;
+	void UpdateTexture(const uchar* pixels) override;
 	void RenderIndexedBuffer() override;
 	void SetViewProjection(mat4 view, mat4 projection) override;
 
@@ -23,7 +24,8 @@ private:
 	uint m_VBO = 0;
 	uint m_EBO = 0;
 	uint m_texture = 0;
-	uchar* m_pPixels = nullptr;
+	int2 m_textureSize = int2(0, 0);
+	const uchar* m_pPixels = nullptr;
 
 	void Initialize() override;
 	void BindVertexArrayObject();
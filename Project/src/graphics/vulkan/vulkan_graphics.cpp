@@ -91,6 +91,8 @@ vector<VkLayerProperties> VulkanGraphics::GetSupportedValidationLayers() {
 #pragma region Instance and extensions
 
 void VulkanGraphics::CreateInstance() {
+	PROFILE_FUNCTION();
+
 	std::array<cstring, 1> validation_layers = { "VK_LAYER_KHRONOS_validation" };
 	if (!AreAllLayersSupported(validation_layers)) {
 		m_validationEnabled = false;
@@ -248,6 +250,8 @@ bool VulkanGraphics::IsDeviceSuitable(VkPhysicalDevice device) {
 }
 
 void VulkanGraphics::PickPhysicalDevice() {
+	PROFILE_FUNCTION();
+
 	vector<VkPhysicalDevice> devices = GetAvailableDevices();
 	std::erase_if(devices, std::not_fn(std::bind_front(&VulkanGraphics::IsDeviceSuitable, this)));
 
@@ -279,6 +283,8 @@ vector<VkPhysicalDevice> VulkanGraphics::GetAvailableDevices() {
 }
 
 void VulkanGraphics::CreateLogicalDeviceAndQueues() {
+	PROFILE_FUNCTION();
+
 	QueueFamilyIndices picked_device_families = FindQueueFamilies(m_physicalDevice);
 
 	// Sanity check
@@ -328,6 +334,8 @@ void VulkanGraphics::CreateLogicalDeviceAndQueues() {
 #pragma region Presentation
 
 void VulkanGraphics::CreateSurface() {
+	PROFILE_FUNCTION();
+
 	VkResult result = glfwCreateWindowSurface(m_instance, m_pWindow->GetHandle(), nullptr, &m_surface);
 	if (result != VK_SUCCESS) {
 		std::exit(EXIT_FAILURE);
@@ -398,6 +406,8 @@ uint VulkanGraphics::ChooseSwapImageCount(const VkSurfaceCapabilitiesKHR& capabi
 }
 
 void VulkanGraphics::CreateSwapChain() {
+	PROFILE_FUNCTION();
+
 	SwapChainProperties properties = GetSwapChainProperties(m_physicalDevice);
 
 	m_surfaceFormat = ChooseSwapSurfaceFormat(properties.formats);
@@ -444,6 +454,8 @@ void VulkanGraphics::CreateSwapChain() {
 }
 
 void VulkanGraphics::RecreateSwapChain() {
+	PROFILE_FUNCTION();
+
 	int2 size = m_pWindow->GetFrameBufferSize();
 	while (size.x == 0 || size.y == 0) {
 		size = m_pWindow->GetFrameBufferSize();
@@ -506,6 +518,8 @@ VkImageView VulkanGraphics::CreateImageView(VkImage image, VkFormat format, VkIm
 }
 
 void VulkanGraphics::CreateImageViews() {
+	PROFILE_FUNCTION();
+
 	m_swapChainImageViews.resize(m_swapChainImages.size());
 	auto image_view_it = m_swapChainImageViews.begin();
 	for (VkImage image : m_swapChainImages) {
@@ -539,6 +553,8 @@ VkShaderModule VulkanGraphics::CreateShaderModule(span<uchar> buffer) {
 }
 
 void VulkanGraphics::CreateGraphicsPipeline() {
+	PROFILE_FUNCTION();
+
 	vector<uchar> basic_vertex_data = m_pShader->GetVertexShaderBytes();
 	VkShaderModule vertex_shader = CreateShaderModule(basic_vertex_data);
 	gsl::final_action _destroy_vertex([this, vertex_shader]() {
@@ -707,6 +723,8 @@ VkRect2D VulkanGraphics::GetScissor() {
 }
 
 void VulkanGraphics::CreateRenderPass() {
+	PROFILE_FUNCTION();
+
 	VkAttachmentDescription color_attachment = {};
 	color_attachment.format = m_surfaceFormat.format;
 	color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -767,6 +785,8 @@ void VulkanGraphics::CreateRenderPass() {
 #pragma region Drawing
 
 void VulkanGraphics::CreateFramebuffers() {
+	PROFILE_FUNCTION();
+
 	m_swapChainFrameBuffers.resize(m_swapChainImageViews.size());
 	for (uint i = 0; i < m_swapChainImageViews.size(); i++) {
 		std::array<VkImageView, 1> attachments = { m_swapChainImageViews[i] };
@@ -879,6 +899,8 @@ void VulkanGraphics::CreateSignals() {
 }
 
 bool VulkanGraphics::BeginFrame() {
+	PROFILE_SCOPE("Acquire swapchain image");
+
 	vkWaitForFences(m_logicalDevice, 1, &m_stillRenderingFence, VK_TRUE, UINT64_MAX);
 	VkResult image_acquire_result = vkAcquireNextImageKHR(m_logicalDevice, m_swapChain, UINT64_MAX, m_imageAvailableSignal, VK_NULL_HANDLE, &m_currentImageIndex);
 
@@ -898,6 +920,8 @@ bool VulkanGraphics::BeginFrame() {
 }
 
 void VulkanGraphics::EndFrame() {
+	PROFILE_SCOPE("Submit and present");
+
 	EndCommands();
 
 	VkSubmitInfo submit_info = {};
@@ -990,6 +1014,8 @@ BufferHandle VulkanGraphics::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags
 }
 
 void VulkanGraphics::CreateVertexBuffer(span<Vertex> vertices) {
+	PROFILE_FUNCTION();
+
 	VkDeviceSize size = sizeof(Vertex) * vertices.size();
 	BufferHandle staging_handle = CreateBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vertices.size());
 
@@ -1013,6 +1039,8 @@ void VulkanGraphics::CreateVertexBuffer(span<Vertex> vertices) {
 }
 
 void VulkanGraphics::CreateIndexBuffer(span<int> indices) {
+	PROFILE_FUNCTION();
+
 	VkDeviceSize size = sizeof(uint) * indices.size();
 	BufferHandle staging_handle = CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, indices.size());
 
@@ -1159,6 +1187,8 @@ void VulkanGraphics::CreateDescriptorPools() {
 }
 
 void VulkanGraphics::CreateDescriptorSets() {
+	PROFILE_FUNCTION();
+
 	VkDescriptorSetAllocateInfo set_info = {};
 	set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	set_info.descriptorPool = m_uniformPool;
@@ -1215,22 +1245,24 @@ void VulkanGraphics::CreateTextureSampler() {
 	}
 }
 
-void VulkanGraphics::CreateTexture(uchar* pixels) {
-	int2 image_extents = int2(IMAGE_WIDTH, IMAGE_HEIGHT);
+void VulkanGraphics::CreateTexture(uchar* pixels, int2 size) {
+	PROFILE_SCOPE("Create texture");
+
+	int2 image_extents = size;
 	int channels = 4;
 	
+	// The staging buffer stays mapped, UpdateTexture copies every new frame through it
 	VkDeviceSize buffer_size = image_extents.x * image_extents.y * channels;
-	BufferHandle staging = CreateBuffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, image_extents.x * image_extents.y);
+	m_textureStaging = CreateBuffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, image_extents.x * image_extents.y);
+	m_textureSize = image_extents;
 
-	void* data_location;
-	vkMapMemory(m_logicalDevice, staging.memory, 0, buffer_size, 0, &data_location);
-	std::memcpy(data_location, pixels, buffer_size);
-	vkUnmapMemory(m_logicalDevice, staging.memory);
+	vkMapMemory(m_logicalDevice, m_textureStaging.memory, 0, buffer_size, 0, &m_pTextureStagingLocation);
+	std::memcpy(m_pTextureStagingLocation, pixels, buffer_size);
 
 	m_textureHandle = CreateImage(image_extents, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 	TransitionImageLayout(m_textureHandle.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-	CopyBufferToImage(staging.buffer, m_textureHandle.image, image_extents);
+	CopyBufferToImage(m_textureStaging.buffer, m_textureHandle.image, image_extents);
 	TransitionImageLayout(m_textureHandle.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 	m_textureHandle.image_view = CreateImageView(m_textureHandle.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
@@ -1261,8 +1293,21 @@ void VulkanGraphics::CreateTexture(uchar* pixels) {
 	descriptor_write.pImageInfo = &image_info;
 
 	vkUpdateDescriptorSets(m_logicalDevice, 1, &descriptor_write, 0, nullptr);
+}
 
-	DestroyBuffer(staging);
+void VulkanGraphics::UpdateTexture(const uchar* pixels) {
+	PROFILE_SCOPE("Upload texture");
+
+	// Earlier copies out of the staging buffer have finished, the transient command buffers wait for the queue to idle
+	VkDeviceSize buffer_size = m_textureSize.x * m_textureSize.y * 4;
+	std::memcpy(m_pTextureStagingLocation, pixels, buffer_size);
+
+	// Reuse the image: move it out of shader reads, copy, and hand it back to the fragment shader in one submission
+	VkCommandBuffer local_command_buffer = BeginTransientCommandBuffer();
+	RecordImageLayoutTransition(local_command_buffer, m_textureHandle.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	RecordCopyBufferToImage(local_command_buffer, m_textureStaging.buffer, m_textureHandle.image, m_textureSize);
+	RecordImageLayoutTransition(local_command_buffer, m_textureHandle.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	EndTransientCommandBuffer(local_command_buffer);
 }
 
 void VulkanGraphics::DestroyTexture(TextureHandle handle) {
@@ -1275,7 +1320,11 @@ void VulkanGraphics::DestroyTexture(TextureHandle handle) {
 
 void VulkanGraphics::TransitionImageLayout(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout) {
 	VkCommandBuffer local_command_buffer = BeginTransientCommandBuffer();
+	RecordImageLayoutTransition(local_command_buffer, image, old_layout, new_layout);
+	EndTransientCommandBuffer(local_command_buffer);
+}
 
+void VulkanGraphics::RecordImageLayoutTransition(VkCommandBuffer command_buffer, VkImage image, VkImageLayout old_layout, VkImageLayout new_layout) {
 	VkImageMemoryBarrier barrier = {};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	barrier.oldLayout = old_layout;
@@ -1303,6 +1352,12 @@ void VulkanGraphics::TransitionImageLayout(VkImage image, VkImageLayout old_layo
 		source_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 		destination_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 	}
+	else if (old_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+		barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		source_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		destination_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	}
 	else if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
 		barrier.srcAccessMask = 0;
 		barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
@@ -1317,14 +1372,16 @@ void VulkanGraphics::TransitionImageLayout(VkImage image, VkImageLayout old_layo
 		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	}
 
-	vkCmdPipelineBarrier(local_command_buffer, source_stage, destination_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-	EndTransientCommandBuffer(local_command_buffer);
+	vkCmdPipelineBarrier(command_buffer, source_stage, destination_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 }
 
 void VulkanGraphics::CopyBufferToImage(VkBuffer buffer, VkImage image, int2 image_size) {
 	VkCommandBuffer local_command_buffer = BeginTransientCommandBuffer();
+	RecordCopyBufferToImage(local_command_buffer, buffer, image, image_size);
+	EndTransientCommandBuffer(local_command_buffer);
+}
 
+void VulkanGraphics::RecordCopyBufferToImage(VkCommandBuffer command_buffer, VkBuffer buffer, VkImage image, int2 image_size) {
 	VkBufferImageCopy region = {};
 	region.bufferOffset = 0;
 	region.bufferRowLength = 0;
@@ -1336,9 +1393,7 @@ void VulkanGraphics::CopyBufferToImage(VkBuffer buffer, VkImage image, int2 imag
 	region.imageOffset = { 0, 0, 0 };
 	region.imageExtent = { static_cast<uint>(image_size.x), static_cast<uint>(image_size.y), 1 };
 
-	vkCmdCopyBufferToImage(local_command_buffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-	EndTransientCommandBuffer(local_command_buffer);
+	vkCmdCopyBufferToImage(command_buffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 }
 
 TextureHandle VulkanGraphics::CreateImage(int2 size, VkFormat image_format, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
@@ -1396,6 +1451,10 @@ VulkanGraphics::~VulkanGraphics() {
 		vkDeviceWaitIdle(m_logicalDevice);
 
 		DestroyTexture(m_textureHandle);
+		if (m_pTextureStagingLocation != nullptr) {
+			vkUnmapMemory(m_logicalDevice, m_textureStaging.memory);
+		}
+		DestroyBuffer(m_textureStaging);
 		DestroyBuffer(m_vertexBuffer);
 		DestroyBuffer(m_indexBuffer);
 		 
@@ -1470,6 +1529,8 @@ VulkanGraphics::~VulkanGraphics() {
 }
 
 void VulkanGraphics::Initialize() {
+	PROFILE_SCOPE("Vulkan initialization");
+
 #if !defined(NDEBUG) 
 	m_validationEnabled = true;
 #endif
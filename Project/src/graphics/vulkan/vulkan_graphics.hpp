@@ -15,7 +15,8 @@ public:
 
 	void CreateVertexBuffer(span<Vertex> vertices) override;
 	void CreateIndexBuffer(span<int> indices) override;
-	void CreateTexture(uchar* pixels) override;
+	void CreateTexture(uchar* pixels, int2 size) override;
+	void UpdateTexture(const uchar* pixels) override;
 	void RenderIndexedBuffer() override;
 	void SetViewProjection(mat4 view, mat4 projection) override;
 
@@ -74,6 +75,9 @@ private:
 
 	// Textures
 	TextureHandle m_textureHandle = {};
+	BufferHandle m_textureStaging = {};
+	void* m_pTextureStagingLocation = nullptr;
+	int2 m_textureSize = int2(0, 0);
 	VkDescriptorSetLayout m_textureSetLayout = VK_NULL_HANDLE;
 	VkDescriptorPool m_texturePool = VK_NULL_HANDLE;
 	VkSampler m_textureSampler = VK_NULL_HANDLE;
@@ -153,7 +157,9 @@ private:
 	void EndTransientCommandBuffer(VkCommandBuffer command_buffer);
 	TextureHandle CreateImage(int2 size, VkFormat format, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
 	void TransitionImageLayout(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout);
+	void RecordImageLayoutTransition(VkCommandBuffer command_buffer, VkImage image, VkImageLayout old_layout, VkImageLayout new_layout);
 	void CopyBufferToImage(VkBuffer buffer, VkImage image, int2 image_size);
+	void RecordCopyBufferToImage(VkCommandBuffer command_buffer, VkBuffer buffer, VkImage image, int2 image_size);
 	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flag);
 	
 	// Viewport helpers
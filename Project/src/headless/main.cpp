@@ -0,0 +1,419 @@
+#include <chrono>
+#include <fstream>
+
+#include "raytracing/core.hpp"
+#include "scene/scene_cache.hpp"
+#include "utils/image_writer.hpp"
+
+// Batch renderer without a window or graphics API:
+//   TinyTracerHeadless [--width W] [--height H] [--spp N] [--threads N] [--tile-size N] [--max-depth N] [--packet-size N]
+//                      [--sampler independent|stratified|sobol|bluenoise] [--seed N] [--adaptive THRESHOLD] [--max-spp N] [--heatmap FILE.ppm|.png]
+//                      [--denoise ITERATIONS] [--convergence FILE.csv] [--reference-spp N] [--output FILE.ppm|.png|.pfm]
+//                      [--scene default|uniform|clustered|grid|shells|manylights|instances] [--primitives N] [--lights N] [--scene-seed N]
+//                      [--mesh FILE.obj|.tmesh] [--save-mesh FILE.tmesh] [--scene-cache FILE] [--cost-heatmap FILE.ppm|.png] [--trace FILE.json]
+//
+// --mesh renders a triangle mesh instead of a sphere scene. With --save-mesh it is converted to the binary format instead, which loads
+// without parsing. With --scene instances it is the mesh --primitives instances are made of
+// --scene-cache loads a generated sphere scene and its BVH from FILE, or writes them there when FILE is missing or was made with other settings
+// --convergence skips the image and instead writes the RMSE of every sampler at 1, 2, 4, ... --spp samples per pixel, measured
+// against a --reference-spp Sobol render with another seed
+
+struct HeadlessOptions {
+	RenderSettings settings;
+	std::filesystem::path output = "render.png";
+	// Samples per pixel of an adaptive render, empty is no heatmap
+	std::filesystem::path heatmap;
+	// Traversal cost per pixel, needs STATS_LEVEL 2
+	std::filesystem::path costHeatmap;
+	// Chrome trace of the run, needs ENABLE_PROFILING
+	std::filesystem::path trace;
+	// RMSE against sample count per sampler, empty renders an image instead
+	std::filesystem::path convergence;
+	// Binary copy of the --mesh file, written instead of rendering
+	std::filesystem::path saveMesh;
+	int referenceSamples = 1024;
+};
+
+static const SamplerType SAMPLER_TYPES[] = { SamplerType::Independent, SamplerType::Stratified, SamplerType::Sobol, SamplerType::BlueNoise };
+
+static void PrintUsage() {
+	spdlog::info("Usage: TinyTracerHeadless [--width W] [--height H] [--spp N] [--threads N] [--tile-size N] [--max-depth N] [--packet-size N] [--sampler NAME] [--seed N] [--adaptive THRESHOLD] [--max-spp N] [--heatmap FILE.ppm|.png] [--denoise ITERATIONS] [--convergence FILE.csv] [--reference-spp N] [--output FILE.ppm|.png|.pfm] [--scene NAME] [--primitives N] [--lights N] [--scene-seed N] [--mesh FILE.obj|.tmesh] [--save-mesh FILE.tmesh] [--scene-cache FILE] [--cost-heatmap FILE.ppm|.png] [--trace FILE.json]");
+}
+
+static bool ParseOptions(int argc, char** argv, HeadlessOptions& options) {
+	bool hasMaxSamples = false;
+	for (int i = 1; i < argc; i++) {
+		cstring argument = argv[i];
+		if (IsStringEqual(argument, "--help") || IsStringEqual(argument, "-h")) {
+			return false;
+		}
+
+		if (i + 1 >= argc) {
+			spdlog::error("Missing value for {}", argument);
+			return false;
+		}
+		cstring value = argv[++i];
+
+		RenderSettings& settings = options.settings;
+		if (IsStringEqual(argument, "--width")) {
+			settings.width = std::atoi(value);
+		}
+		else if (IsStringEqual(argument, "--height")) {
+			settings.height = std::atoi(value);
+		}
+		else if (IsStringEqual(argument, "--spp")) {
+			settings.samplesPerPixel = std::atoi(value);
+		}
+		else if (IsStringEqual(argument, "--threads")) {
+			settings.threadCount = std::atoi(value);
+		}
+		else if (IsStringEqual(argument, "--tile-size")) {
+			settings.tileSize = std::atoi(value);
+		}
+		else if (IsStringEqual(argument, "--max-depth")) {
+			settings.maxRayDepth = std::atoi(value);
+		}
+		else if (IsStringEqual(argument, "--packet-size")) {
+			settings.rayPacketSize = std::atoi(value);
+		}
+		else if (IsStringEqual(argument, "--sampler")) {
+			bool found = false;
+			for (SamplerType type : SAMPLER_TYPES) {
+				if (IsStringEqual(value, Sampler::GetName(type))) {
+					settings.sampler = type;
+					found = true;
+				}
+			}
+			if (!found) {
+				spdlog::error("Unknown sampler {}, use independent, stratified, sobol or bluenoise", value);
+				return false;
+			}
+		}
+		else if (IsStringEqual(argument, "--seed")) {
+			settings.seed = (uint)std::strtoul(value, nullptr, 10);
+		}
+		else if (IsStringEqual(argument, "--convergence")) {
+			options.convergence = value;
+		}
+		else if (IsStringEqual(argument, "--reference-spp")) {
+			options.referenceSamples = std::atoi(value);
+		}
+		else if (IsStringEqual(argument, "--adaptive")) {
+			settings.adaptiveSampling = true;
+			settings.adaptiveThreshold = (float)std::atof(value);
+		}
+		else if (IsStringEqual(argument, "--max-spp")) {
+			settings.adaptiveMaxSamples = std::atoi(value);
+			hasMaxSamples = true;
+		}
+		else if (IsStringEqual(argument, "--heatmap")) {
+			options.heatmap = value;
+		}
+		else if (IsStringEqual(argument, "--cost-heatmap")) {
+			options.costHeatmap = value;
+		}
+		else if (IsStringEqual(argument, "--trace")) {
+			options.trace = value;
+		}
+		else if (IsStringEqual(argument, "--denoise")) {
+			settings.denoiseIterations = std::atoi(value);
+			settings.denoise = settings.denoiseIterations > 0;
+		}
+		else if (IsStringEqual(argument, "--scene")) {
+			if (!SceneGenerator::ParseType(value, settings.scene.type)) {
+				spdlog::error("Unknown scene {}, use default, uniform, clustered, grid, shells, manylights, mesh or instances", value);
+				return false;
+			}
+		}
+		else if (IsStringEqual(argument, "--primitives")) {
+			settings.scene.primitiveCount = std::atoi(value);
+		}
+		else if (IsStringEqual(argument, "--lights")) {
+			settings.scene.lightCount = std::atoi(value);
+		}
+		else if (IsStringEqual(argument, "--scene-seed")) {
+			settings.scene.seed = (uint)std::strtoul(value, nullptr, 10);
+		}
+		else if (IsStringEqual(argument, "--mesh")) {
+			if (settings.scene.type != SceneType::Instances) {
+				settings.scene.type = SceneType::Mesh;
+			}
+			settings.scene.meshPath = value;
+		}
+		else if (IsStringEqual(argument, "--save-mesh")) {
+			options.saveMesh = value;
+		}
+		else if (IsStringEqual(argument, "--scene-cache")) {
+			settings.sceneCache = value;
+		}
+		else if (IsStringEqual(argument, "--output") || IsStringEqual(argument, "-o")) {
+			options.output = value;
+		}
+		else {
+			spdlog::error("Unknown option {}", argument);
+			return false;
+		}
+	}
+
+	const RenderSettings& settings = options.settings;
+	if (settings.width <= 0 || settings.height <= 0) {
+		spdlog::error("Resolution should be positive, got {}x{}", settings.width, settings.height);
+		return false;
+	}
+
+	if (settings.samplesPerPixel <= 0 || settings.tileSize <= 0 || settings.threadCount < 0 || settings.maxRayDepth < 0) {
+		spdlog::error("Samples per pixel and tile size should be positive, thread count and max depth not negative");
+		return false;
+	}
+
+	if (settings.rayPacketSize != 0 && settings.rayPacketSize != 4 && settings.rayPacketSize != 8 && settings.rayPacketSize != 16) {
+		spdlog::error("Packet size should be 0, 4, 8 or 16, got {}", settings.rayPacketSize);
+		return false;
+	}
+
+	if (hasMaxSamples && !settings.adaptiveSampling) {
+		spdlog::error("--max-spp only limits adaptive sampling, it needs --adaptive");
+		return false;
+	}
+
+	if (settings.adaptiveSampling && (settings.adaptiveThreshold <= 0.0f || settings.adaptiveMaxSamples < 0)) {
+		spdlog::error("Adaptive threshold should be positive and max samples per pixel not negative");
+		return false;
+	}
+
+	if (settings.denoiseIterations < 0 || settings.denoiseIterations > 10) {
+		spdlog::error("Denoise iterations should be between 0 and 10, got {}", settings.denoiseIterations);
+		return false;
+	}
+
+	if (!options.heatmap.empty()) {
+		string heatmapExtension = options.heatmap.extension().string();
+		if (!settings.adaptiveSampling) {
+			spdlog::error("A sample count heatmap needs --adaptive");
+			return false;
+		}
+		if (heatmapExtension != ".ppm" && heatmapExtension != ".png") {
+			spdlog::error("Unsupported heatmap format {}, use .ppm or .png", heatmapExtension);
+			return false;
+		}
+	}
+
+	if (!options.costHeatmap.empty()) {
+		string costHeatmapExtension = options.costHeatmap.extension().string();
+#if STATS_LEVEL < 2
+		spdlog::error("A traversal cost heatmap needs a build with STATS_LEVEL 2");
+		return false;
+#endif
+		if (costHeatmapExtension != ".ppm" && costHeatmapExtension != ".png") {
+			spdlog::error("Unsupported heatmap format {}, use .ppm or .png", costHeatmapExtension);
+			return false;
+		}
+	}
+
+#if !PROFILING
+	if (!options.trace.empty()) {
+		spdlog::error("A trace needs a build with ENABLE_PROFILING");
+		return false;
+	}
+#endif
+
+	if (!options.convergence.empty() && options.referenceSamples < settings.samplesPerPixel) {
+		spdlog::error("Reference samples per pixel should be at least --spp, got {}", options.referenceSamples);
+		return false;
+	}
+
+	if (settings.scene.primitiveCount <= 0 || settings.scene.primitiveCount > 10000000 || settings.scene.lightCount <= 0) {
+		spdlog::error("Primitives should be between 1 and 10000000 and lights positive, got {} and {}", settings.scene.primitiveCount, settings.scene.lightCount);
+		return false;
+	}
+
+	if (settings.scene.type == SceneType::Mesh && settings.scene.meshPath.empty()) {
+		spdlog::error("The mesh scene needs a file, use --mesh FILE.obj|.tmesh");
+		return false;
+	}
+
+	if (!options.saveMesh.empty() && (settings.scene.type != SceneType::Mesh || options.saveMesh.extension() != ".tmesh")) {
+		spdlog::error("--save-mesh needs a --mesh to convert and a .tmesh file to write");
+		return false;
+	}
+
+	if (!settings.sceneCache.empty() && !SceneCache::IsSupported(settings.scene.type)) {
+		spdlog::error("--scene-cache only holds generated sphere scenes, not {}", SceneGenerator::GetName(settings.scene.type));
+		return false;
+	}
+
+	string extension = options.output.extension().string();
+	if (extension != ".ppm" && extension != ".png" && extension != ".pfm") {
+		spdlog::error("Unsupported output format {}, use .ppm, .png or .pfm", extension);
+		return false;
+	}
+
+	return true;
+}
+
+static double ComputeRMSE(const vector<float>& image, const vector<float>& reference) {
+	double squaredError = 0.0;
+	for (size_t i = 0; i < image.size(); i++) {
+		double difference = image[i] - reference[i];
+		squaredError += difference * difference;
+	}
+	return std::sqrt(squaredError / image.size());
+}
+
+static bool RunConvergence(const HeadlessOptions& options) {
+	RenderSettings settings = options.settings;
+	vector<uchar> pixels(settings.GetPixelCount() * 4);
+	vector<float> reference(settings.GetPixelCount() * 3);
+	vector<float> image(settings.GetPixelCount() * 3);
+
+	// The reference has its own seed, or it would share its first samples with the renders it is compared to
+	RenderSettings referenceSettings = settings;
+	referenceSettings.sampler = SamplerType::Sobol;
+	referenceSettings.samplesPerPixel = options.referenceSamples;
+	referenceSettings.seed = settings.seed + 1;
+	Core* referenceCore = new Core(referenceSettings);
+	referenceCore->GetPixels(pixels.data(), reference.data());
+	delete referenceCore;
+
+	std::ofstream file(options.convergence);
+	if (!file) {
+		spdlog::error("Cannot open {} for writing", options.convergence.string());
+		return false;
+	}
+	file << "sampler,spp,rmse,seconds\n";
+
+	for (SamplerType type : SAMPLER_TYPES) {
+		for (int samples = 1; samples <= options.settings.samplesPerPixel; samples *= 2) {
+			settings.sampler = type;
+			settings.samplesPerPixel = samples;
+			Core* core = new Core(settings);
+
+			auto start = std::chrono::steady_clock::now();
+			core->GetPixels(pixels.data(), image.data());
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			delete core;
+
+			double rmse = ComputeRMSE(image, reference);
+			spdlog::info("Convergence | Sampler: {} | Samples: {} | RMSE: {:.6f}", Sampler::GetName(type), samples, rmse);
+			file << Sampler::GetName(type) << "," << samples << "," << rmse << "," << seconds << "\n";
+		}
+	}
+
+	spdlog::info("Convergence written to {}", options.convergence.string());
+	return true;
+}
+
+static bool WriteHeatmap(const std::filesystem::path& path, const vector<uchar>& pixels, const RenderSettings& settings) {
+	if (path.extension() == ".png") {
+		return WritePNG(path, pixels.data(), settings.width, settings.height);
+	}
+	return WritePPM(path, pixels.data(), settings.width, settings.height);
+}
+
+static bool RenderImage(const HeadlessOptions& options) {
+	// Initialize ray tracing core
+	auto start = std::chrono::steady_clock::now();
+	const RenderSettings& settings = options.settings;
+	Core* core = nullptr;
+	if (!settings.sceneCache.empty()) {
+		// Core maps the cache, or generates the scene and writes it
+		core = new Core(settings);
+	}
+	else {
+		Scene* scene = SceneGenerator::Generate(settings.scene);
+		if (scene == nullptr) {
+			return false;
+		}
+		core = new Core(settings, scene);
+	}
+	auto initialized = std::chrono::steady_clock::now();
+
+	// Calculate pixel values
+	bool isHDR = options.output.extension() == ".pfm";
+	vector<uchar> pixels(settings.GetPixelCount() * 4);
+	vector<float> hdrPixels(isHDR ? settings.GetPixelCount() * 3 : 0);
+	core->GetPixels(pixels.data(), isHDR ? hdrPixels.data() : nullptr);
+	auto rendered = std::chrono::steady_clock::now();
+
+	double initializeTime = std::chrono::duration<double>(initialized - start).count();
+	double renderTime = std::chrono::duration<double>(rendered - initialized).count();
+	double primaryRays = (double)core->GetLastSampleCount();
+	spdlog::info("Timer | Initialize: {} | Render: {} | Total: {}", initializeTime, renderTime, initializeTime + renderTime);
+	spdlog::info("Throughput | Primary rays: {} | Primary rays/sec: {:.0f}", primaryRays, primaryRays / renderTime);
+
+	// Write image
+	bool written = false;
+	if (isHDR) {
+		written = WritePFM(options.output, hdrPixels.data(), settings.width, settings.height);
+	}
+	else if (options.output.extension() == ".png") {
+		written = WritePNG(options.output, pixels.data(), settings.width, settings.height);
+	}
+	else {
+		written = WritePPM(options.output, pixels.data(), settings.width, settings.height);
+	}
+
+	if (written) {
+		spdlog::info("Image written to {}", options.output.string());
+	}
+
+	if (written && !options.heatmap.empty()) {
+		core->GetSampleCountHeatmap(pixels.data());
+		written = WriteHeatmap(options.heatmap, pixels, settings);
+		if (written) {
+			spdlog::info("Sample count heatmap written to {}", options.heatmap.string());
+		}
+	}
+
+	if (written && !options.costHeatmap.empty()) {
+		core->GetTraversalCostHeatmap(pixels.data());
+		written = WriteHeatmap(options.costHeatmap, pixels, settings);
+		if (written) {
+			spdlog::info("Traversal cost heatmap written to {}", options.costHeatmap.string());
+		}
+	}
+
+	// Clear memory
+	delete core;
+
+	return written;
+}
+
+static bool SaveMesh(const HeadlessOptions& options) {
+	Mesh* mesh = Mesh::Load(options.settings.scene.meshPath, options.settings.threadCount);
+	if (mesh == nullptr) {
+		return false;
+	}
+
+	bool written = mesh->SaveBinary(options.saveMesh);
+	if (written) {
+		spdlog::info("Mesh written to {}", options.saveMesh.string());
+	}
+	delete mesh;
+	return written;
+}
+
+int main(int argc, char** argv) {
+	HeadlessOptions options;
+	if (!ParseOptions(argc, argv, options)) {
+		PrintUsage();
+		return 1;
+	}
+
+	PROFILE_THREAD_NAME("Main thread");
+	bool succeeded = false;
+	if (!options.saveMesh.empty()) {
+		succeeded = SaveMesh(options);
+	}
+	else {
+		succeeded = options.convergence.empty() ? RenderImage(options) : RunConvergence(options);
+	}
+
+#if PROFILING
+	if (!options.trace.empty()) {
+		succeeded = Profiler::WriteChromeTrace(options.trace) && succeeded;
+	}
+#endif
+
+	return succeeded ? 0 : 1;
+}
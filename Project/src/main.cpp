@@ -7,10 +7,11 @@
 #include "graphics/opengl/opengl_graphics.hpp"
 #include "graphics/vulkan/vulkan_graphics.hpp"
 
-#include "raytracing/core.hpp"
+#include "raytracing/render_thread.hpp"
 #include "shaders/shader.hpp"
 
 int main() {
+	PROFILE_THREAD_NAME("Main thread");
 
 	// Initialize glfw
 	const GlfwInitialization glfw;
@@ -53,20 +54,68 @@ int main() {
 	mat4 projection = mat4(1.0f);
 	graphics.SetViewProjection(view, projection);
 
-	// Initialize ray tracing core
-	Core* core = new Core();
+	// Start rendering in the background, at the window's resolution
+	RenderSettings settings;
+	settings.width = VIEWPORT_WIDTH;
+	settings.height = VIEWPORT_HEIGHT;
+	RenderThread renderThread(settings);
 	
-	// Calculate pixel values and set up textures
-	uchar* pixels = new uchar[IMAGE_WIDTH * IMAGE_HEIGHT * 4];
-	core->GetPixels(pixels);
-	graphics.CreateTexture(pixels);
+	// Start from a black texture, finished passes replace it while the image is refined
+	vector<uchar> pixels(settings.GetPixelCount() * 4, 0);
+	graphics.CreateTexture(pixels.data(), int2(settings.width, settings.height));
+
+	bool restartKeyWasDown = false;
+	bool packetKeyWasDown = false;
+	bool cancelKeyWasDown = false;
+	bool sceneKeyWasDown = false;
+	bool animateKeyWasDown = false;
 
 	while (!window.ShouldClose()) {
+		PROFILE_SCOPE("Frame");
 		glfwPollEvents();
 
 		// Handle user input
 		window.ProcessUserInput();
 
+		// R restarts the accumulation, P toggles ray packets, C stops refining the current image, S switches to the next generated scene,
+		// A starts or stops moving the spheres
+		bool restartKeyDown = window.IsKeyDown(GLFW_KEY_R);
+		if (restartKeyDown && !restartKeyWasDown) {
+			renderThread.Restart();
+		}
+		restartKeyWasDown = restartKeyDown;
+
+		bool packetKeyDown = window.IsKeyDown(GLFW_KEY_P);
+		if (packetKeyDown && !packetKeyWasDown) {
+			settings.rayPacketSize = settings.rayPacketSize > 0 ? 0 : 16;
+			renderThread.Restart(settings);
+		}
+		packetKeyWasDown = packetKeyDown;
+
+		bool cancelKeyDown = window.IsKeyDown(GLFW_KEY_C);
+		if (cancelKeyDown && !cancelKeyWasDown) {
+			renderThread.Cancel();
+		}
+		cancelKeyWasDown = cancelKeyDown;
+
+		bool sceneKeyDown = window.IsKeyDown(GLFW_KEY_S);
+		if (sceneKeyDown && !sceneKeyWasDown) {
+			settings.scene.type = (SceneType)(((int)settings.scene.type + 1) % ((int)SceneType::ManyLights + 1));
+			renderThread.Restart(settings);
+		}
+		sceneKeyWasDown = sceneKeyDown;
+
+		bool animateKeyDown = window.IsKeyDown(GLFW_KEY_A);
+		if (animateKeyDown && !animateKeyWasDown) {
+			renderThread.SetAnimating(!renderThread.IsAnimating());
+		}
+		animateKeyWasDown = animateKeyDown;
+
+		// Only upload when the render thread finished a new pass
+		if (const uchar* latestPixels = renderThread.AcquireLatestPixels()) {
+			graphics.UpdateTexture(latestPixels);
+		}
+
 		if (graphics.BeginFrame()) {
 			// Render scene
 			graphics.RenderIndexedBuffer();
@@ -76,9 +125,10 @@ int main() {
 		}
 	}
 
-	// Clear memory
-	delete[] pixels;
-	delete core;
+#if PROFILING
+	// Startup and every frame so far, open it in chrome://tracing or ui.perfetto.dev
+	Profiler::WriteChromeTrace("trace.json");
+#endif
 
 	return 0;
 }
\ No newline at end of file
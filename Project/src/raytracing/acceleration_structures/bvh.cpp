@@ -52,4 +52,12 @@ bool BVHNode::Hit(const Ray& ray, const Interval& ray_t, IntersectionPoint& inte
 	return hitLeft || hitRight;
 }
 
+bool BVHNode::Occluded(const Ray& ray, const Interval& ray_t) const {
+	if (!m_bbox.IntersectRayAABB(ray, ray_t)) {
+		return false;
+	}
+
+	return m_pLeft->Occluded(ray, ray_t) || (m_pRight != nullptr && m_pRight->Occluded(ray, ray_t));
+}
+
 BVHNode::~BVHNode() { }
\ No newline at end of file
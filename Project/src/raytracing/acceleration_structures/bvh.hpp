@@ -11,6 +11,11 @@ public:
 	~BVHNode();
 
 	bool Hit(const Ray& ray, const Interval& ray_t, IntersectionPoint& intersectionPoint) const override;
+	bool Occluded(const Ray& ray, const Interval& ray_t) const override;
+
+	std::shared_ptr<GeometricObject> GetLeft() const { return m_pLeft; }
+	std::shared_ptr<GeometricObject> GetRight() const { return m_pRight; }
+
 private:
 	std::shared_ptr<GeometricObject> m_pLeft = nullptr;
 	std::shared_ptr<GeometricObject> m_pRight = nullptr;
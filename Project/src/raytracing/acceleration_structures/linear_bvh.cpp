@@ -0,0 +1,613 @@
+#include "linear_bvh.hpp"
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include "../../utils/parallel.hpp"
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+LinearBVH::LinearBVH(const BVHNode& root) {
+	Flatten(root);
+	PointAtOwnedNodes();
+}
+
+LinearBVH::LinearBVH(vector<LinearBVHNode>&& nodes, vector<std::shared_ptr<Primitive>>&& orderedPrimitives) :
+	m_ownedNodes(std::move(nodes)), m_primitives(std::move(orderedPrimitives)) {
+	PointAtOwnedNodes();
+}
+
+LinearBVH::LinearBVH(const LinearBVHNode* nodes, int nodeCount, const SphereSoA& spheres) :
+	m_nodes(nodes), m_nodeCount(nodeCount), m_spheres(spheres), m_sphereLeaves(nodeCount > 0) { }
+
+void LinearBVH::PointAtOwnedNodes() {
+	m_nodes = m_ownedNodes.data();
+	m_nodeCount = (int)m_ownedNodes.size();
+}
+
+void LinearBVH::GatherSphereData(const SphereSoA& sceneSpheres) {
+	m_spheres.Clear();
+	m_sphereLeaves = false;
+
+	vector<int> sphereIndices;
+	for (int i = 0; i < sceneSpheres.Size(); i++) {
+		int objectID = sceneSpheres.GetObjectID(i);
+		if (objectID >= (int)sphereIndices.size()) {
+			sphereIndices.resize(objectID + 1, -1);
+		}
+		sphereIndices[objectID] = i;
+	}
+
+	m_spheres.Reserve((int)m_primitives.size());
+	for (const std::shared_ptr<Primitive>& primitive : m_primitives) {
+		int objectID = (int)primitive->GetID();
+		if (objectID < 0 || objectID >= (int)sphereIndices.size() || sphereIndices[objectID] < 0) {
+			m_spheres.Clear();
+			return;
+		}
+
+		int index = sphereIndices[objectID];
+		m_spheres.Add(sceneSpheres.GetCenter(index), sceneSpheres.GetRadius(index), sceneSpheres.GetAlbedoIndex(index), objectID);
+	}
+	m_sphereLeaves = !m_primitives.empty();
+}
+
+void LinearBVH::GatherTriangleData() {
+	m_triangles.Clear();
+	m_triangleLeaves = false;
+
+	m_triangles.Reserve((int)m_primitives.size());
+	for (const std::shared_ptr<Primitive>& primitive : m_primitives) {
+		const Triangle* triangle = dynamic_cast<const Triangle*>(primitive.get());
+		if (triangle == nullptr) {
+			m_triangles.Clear();
+			return;
+		}
+
+		float3 v0, v1, v2;
+		triangle->GetVertices(v0, v1, v2);
+		m_triangles.Add(v0, v1, v2, (int)triangle->GetID());
+	}
+	m_triangleLeaves = !m_primitives.empty();
+}
+
+float LinearBVH::ComputeSAHCost(float traversalCost, float intersectionCost, int rootNode) const {
+	if (m_nodeCount == 0) {
+		return 0.0f;
+	}
+
+	float rootArea = GetSurfaceArea(m_nodes[rootNode]);
+	if (rootArea <= 0.0f) {
+		return 0.0f;
+	}
+
+	float cost = 0.0f;
+	int end = GetSubtreeEnd(rootNode);
+	for (int i = rootNode; i < end; i++) {
+		const LinearBVHNode& node = m_nodes[i];
+		float nodeCost = node.primitiveCount > 0 ? intersectionCost * node.primitiveCount : traversalCost;
+		cost += nodeCost * GetSurfaceArea(node);
+	}
+	return cost / rootArea;
+}
+
+void LinearBVH::Refit(int threadCount) {
+	if (m_nodeCount == 0) {
+		return;
+	}
+
+	// Enough subtrees to give every thread a few
+	int resolvedThreadCount = m_nodeCount < PARALLEL_REFIT_THRESHOLD ? 1 : ResolveThreadCount(threadCount);
+	int depth = 0;
+	while ((1 << depth) < 4 * resolvedThreadCount) {
+		depth++;
+	}
+
+	// Children come after their parent, so a backwards sweep over a subtree reaches a node once both its children are done
+	vector<int> subtreeRoots = GetSubtreeRoots(depth);
+	ParallelForChunks((int)subtreeRoots.size(), resolvedThreadCount, [&](int, int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			for (int node = GetSubtreeEnd(subtreeRoots[i]) - 1; node >= subtreeRoots[i]; node--) {
+				RefitNode(node);
+			}
+		}
+	});
+	RefitAbove(0, depth);
+}
+
+// The nodes less than depth levels above the subtrees Refit already did
+void LinearBVH::RefitAbove(int nodeIndex, int depth) {
+	if (depth == 0 || m_nodes[nodeIndex].primitiveCount > 0) {
+		return;
+	}
+
+	RefitAbove(nodeIndex + 1, depth - 1);
+	RefitAbove(m_nodes[nodeIndex].secondChildOffset, depth - 1);
+	RefitNode(nodeIndex);
+}
+
+void LinearBVH::RefitNode(int nodeIndex) {
+	LinearBVHNode& node = m_ownedNodes[nodeIndex];
+	float3 min = float3(INFINITY);
+	float3 max = float3(-INFINITY);
+
+	if (node.primitiveCount > 0) {
+		for (int i = node.primitivesOffset; i < node.primitivesOffset + node.primitiveCount; i++) {
+			AABB bbox = m_primitives[i]->GetBoundingBox();
+			min = glm::min(min, float3(bbox.GetAxis(0).min, bbox.GetAxis(1).min, bbox.GetAxis(2).min));
+			max = glm::max(max, float3(bbox.GetAxis(0).max, bbox.GetAxis(1).max, bbox.GetAxis(2).max));
+			// Spheres are the only primitives with leaf-order copies that can move, triangles stay where their mesh put them
+			if (m_sphereLeaves) {
+				m_spheres.SetCenter(i, m_primitives[i]->GetCenter());
+			}
+		}
+	}
+	else {
+		for (int child : { nodeIndex + 1, node.secondChildOffset }) {
+			const LinearBVHNode& childNode = m_nodes[child];
+			min = glm::min(min, float3(childNode.boundsMin[0], childNode.boundsMin[1], childNode.boundsMin[2]));
+			max = glm::max(max, float3(childNode.boundsMax[0], childNode.boundsMax[1], childNode.boundsMax[2]));
+		}
+	}
+
+	for (int axis = 0; axis < 3; axis++) {
+		node.boundsMin[axis] = min[axis];
+		node.boundsMax[axis] = max[axis];
+	}
+}
+
+vector<int> LinearBVH::GetSubtreeRoots(int depth) const {
+	vector<int> roots;
+	if (m_nodeCount == 0) {
+		return roots;
+	}
+
+	// Preorder with the first child on top of the stack, so the roots come out in node order
+	vector<std::pair<int, int>> nodesToVisit = { { 0, 0 } };
+	while (!nodesToVisit.empty()) {
+		auto [node, nodeDepth] = nodesToVisit.back();
+		nodesToVisit.pop_back();
+		if (nodeDepth == depth || m_nodes[node].primitiveCount > 0) {
+			roots.push_back(node);
+			continue;
+		}
+		nodesToVisit.push_back({ m_nodes[node].secondChildOffset, nodeDepth + 1 });
+		nodesToVisit.push_back({ node + 1, nodeDepth + 1 });
+	}
+	return roots;
+}
+
+// The second child's subtree is the last part of its parent's, down to the last leaf
+int LinearBVH::GetSubtreeEnd(int rootNode) const {
+	int node = rootNode;
+	while (m_nodes[node].primitiveCount == 0) {
+		node = m_nodes[node].secondChildOffset;
+	}
+	return node + 1;
+}
+
+int LinearBVH::GetFirstPrimitive(int rootNode) const {
+	int node = rootNode;
+	while (m_nodes[node].primitiveCount == 0) {
+		node++;
+	}
+	return m_nodes[node].primitivesOffset;
+}
+
+vector<std::shared_ptr<Primitive>> LinearBVH::GetSubtreePrimitives(int rootNode) const {
+	int first = GetFirstPrimitive(rootNode);
+	int count = 0;
+	int end = GetSubtreeEnd(rootNode);
+	for (int i = rootNode; i < end; i++) {
+		count += m_nodes[i].primitiveCount;
+	}
+	return vector<std::shared_ptr<Primitive>>(m_primitives.begin() + first, m_primitives.begin() + first + count);
+}
+
+void LinearBVH::ReplaceSubtree(int rootNode, const LinearBVH& subtree) {
+	int oldEnd = GetSubtreeEnd(rootNode);
+	int firstPrimitive = GetFirstPrimitive(rootNode);
+	int shift = subtree.m_nodeCount - (oldEnd - rootNode);
+
+	// Links past the old subtree move with the nodes after it, the new nodes are offset to where they are put
+	auto shiftLink = [&](LinearBVHNode node) {
+		if (node.primitiveCount == 0 && node.secondChildOffset >= oldEnd) {
+			node.secondChildOffset += shift;
+		}
+		return node;
+	};
+
+	vector<LinearBVHNode> nodes;
+	nodes.reserve(m_nodeCount + shift);
+	std::transform(m_nodes, m_nodes + rootNode, std::back_inserter(nodes), shiftLink);
+	for (int i = 0; i < subtree.m_nodeCount; i++) {
+		LinearBVHNode node = subtree.m_nodes[i];
+		if (node.primitiveCount > 0) {
+			node.primitivesOffset += firstPrimitive;
+		}
+		else {
+			node.secondChildOffset += rootNode;
+		}
+		nodes.push_back(node);
+	}
+	std::transform(m_nodes + oldEnd, m_nodes + m_nodeCount, std::back_inserter(nodes), shiftLink);
+
+	std::copy(subtree.m_primitives.begin(), subtree.m_primitives.end(), m_primitives.begin() + firstPrimitive);
+	m_ownedNodes = std::move(nodes);
+	PointAtOwnedNodes();
+	m_spheres.Clear();
+	m_sphereLeaves = false;
+	m_triangles.Clear();
+	m_triangleLeaves = false;
+}
+
+float LinearBVH::GetSurfaceArea(const LinearBVHNode& node) {
+	float dx = std::max(0.0f, node.boundsMax[0] - node.boundsMin[0]);
+	float dy = std::max(0.0f, node.boundsMax[1] - node.boundsMin[1]);
+	float dz = std::max(0.0f, node.boundsMax[2] - node.boundsMin[2]);
+	return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+int LinearBVH::Flatten(const BVHNode& node) {
+	std::shared_ptr<GeometricObject> left = node.GetLeft();
+	std::shared_ptr<GeometricObject> right = node.GetRight();
+	const BVHNode* leftNode = dynamic_cast<const BVHNode*>(left.get());
+	const BVHNode* rightNode = dynamic_cast<const BVHNode*>(right.get());
+
+	// Children that are both primitives are merged into a single leaf
+	if (leftNode == nullptr && rightNode == nullptr) {
+		return AddLeaf(node.GetBoundingBox(), { left, right });
+	}
+
+	AABB bbox = node.GetBoundingBox();
+	int nodeIndex = (int)m_ownedNodes.size();
+	m_ownedNodes.emplace_back();
+
+	LinearBVHNode& linearNode = m_ownedNodes[nodeIndex];
+	for (int axis = 0; axis < 3; axis++) {
+		linearNode.boundsMin[axis] = bbox.GetAxis(axis).min;
+		linearNode.boundsMax[axis] = bbox.GetAxis(axis).max;
+	}
+	linearNode.primitiveCount = 0;
+	linearNode.axis = (std::uint8_t)bbox.GetLongestAxis();
+
+	leftNode != nullptr ? Flatten(*leftNode) : AddLeaf(left->GetBoundingBox(), { left });
+	int secondChildOffset = rightNode != nullptr ? Flatten(*rightNode) : AddLeaf(right->GetBoundingBox(), { right });
+	m_ownedNodes[nodeIndex].secondChildOffset = secondChildOffset;
+
+	return nodeIndex;
+}
+
+int LinearBVH::AddLeaf(const AABB& bbox, std::initializer_list<std::shared_ptr<GeometricObject>> objects) {
+	int nodeIndex = (int)m_ownedNodes.size();
+	LinearBVHNode& leaf = m_ownedNodes.emplace_back();
+	for (int axis = 0; axis < 3; axis++) {
+		leaf.boundsMin[axis] = bbox.GetAxis(axis).min;
+		leaf.boundsMax[axis] = bbox.GetAxis(axis).max;
+	}
+	leaf.primitivesOffset = (int)m_primitives.size();
+	leaf.primitiveCount = 0;
+	leaf.axis = 0;
+
+	for (const std::shared_ptr<GeometricObject>& object : objects) {
+		std::shared_ptr<Primitive> primitive = std::dynamic_pointer_cast<Primitive>(object);
+		if (primitive != nullptr) {
+			m_primitives.push_back(primitive);
+			leaf.primitiveCount++;
+		}
+	}
+
+	return nodeIndex;
+}
+
+bool LinearBVH::Hit(const Ray& ray, const Interval& ray_t, IntersectionPoint& intersectionPoint) const {
+	if (m_nodeCount == 0) {
+		return false;
+	}
+
+	return HitSubtree(0, ray, ray_t, intersectionPoint);
+}
+
+bool LinearBVH::HitSubtree(int rootNode, const Ray& ray, const Interval& ray_t, IntersectionPoint& intersectionPoint) const {
+	float3 inverseDirection = 1.0f / ray.direction;
+	bool directionIsNegative[3] = { inverseDirection.x < 0, inverseDirection.y < 0, inverseDirection.z < 0 };
+
+	int nodesToVisit[STACK_SIZE];
+	int toVisitCount = 0;
+	int currentNode = rootNode;
+
+	float closest = ray_t.max;
+	bool hit = false;
+	int closestSphere = -1;
+	int closestTriangle = -1;
+
+	while (true) {
+		const LinearBVHNode& node = m_nodes[currentNode];
+#ifdef STATS
+		stats->traversalStepCounter++;
+#endif
+		if (IntersectNode(node, ray.origin, inverseDirection, ray_t.min, closest)) {
+			if (node.primitiveCount > 0) {
+#ifdef STATS
+				stats->leafVisitCounter++;
+#endif
+				if (m_sphereLeaves) {
+					int sphere = m_spheres.IntersectClosest(node.primitivesOffset, node.primitiveCount, ray, ray_t.min, closest);
+					if (sphere >= 0) {
+						closestSphere = sphere;
+					}
+				}
+				else if (m_triangleLeaves) {
+					int triangle = m_triangles.IntersectClosest(node.primitivesOffset, node.primitiveCount, ray, ray_t.min, closest);
+					if (triangle >= 0) {
+						closestTriangle = triangle;
+					}
+				}
+				else {
+					for (int i = 0; i < node.primitiveCount; i++) {
+						if (m_primitives[node.primitivesOffset + i]->Hit(ray, Interval(ray_t.min, closest), intersectionPoint)) {
+							hit = true;
+							closest = intersectionPoint.t;
+						}
+					}
+				}
+
+				if (toVisitCount == 0) break;
+				currentNode = nodesToVisit[--toVisitCount];
+			}
+			else {
+				// Visit the child closest to the ray origin first, so the far child can be culled by the closer hit
+				if (directionIsNegative[node.axis]) {
+					nodesToVisit[toVisitCount++] = currentNode + 1;
+					currentNode = node.secondChildOffset;
+				}
+				else {
+					nodesToVisit[toVisitCount++] = node.secondChildOffset;
+					currentNode = currentNode + 1;
+				}
+			}
+		}
+		else {
+			if (toVisitCount == 0) break;
+			currentNode = nodesToVisit[--toVisitCount];
+		}
+	}
+
+	// The sphere and triangle kernels only track distances, point and normal are computed for the closest hit alone
+	if (closestSphere >= 0) {
+		intersectionPoint.t = closest;
+		m_spheres.SetHit(closestSphere, ray, intersectionPoint);
+		hit = true;
+	}
+	if (closestTriangle >= 0) {
+		intersectionPoint.t = closest;
+		m_triangles.SetHit(closestTriangle, ray, intersectionPoint);
+		hit = true;
+	}
+
+	return hit;
+}
+
+bool LinearBVH::Occluded(const Ray& ray, const Interval& ray_t) const {
+	if (m_nodeCount == 0) {
+		return false;
+	}
+
+	float3 inverseDirection = 1.0f / ray.direction;
+
+	int nodesToVisit[STACK_SIZE];
+	int toVisitCount = 0;
+	int currentNode = 0;
+
+	// Child order does not matter here, the first hit ends the traversal
+	while (true) {
+		const LinearBVHNode& node = m_nodes[currentNode];
+#ifdef STATS
+		stats->traversalStepCounter++;
+#endif
+		if (IntersectNode(node, ray.origin, inverseDirection, ray_t.min, ray_t.max)) {
+			if (node.primitiveCount > 0) {
+#ifdef STATS
+				stats->leafVisitCounter++;
+#endif
+				if (m_sphereLeaves) {
+					if (m_spheres.IntersectAny(node.primitivesOffset, node.primitiveCount, ray, ray_t.min, ray_t.max)) {
+						return true;
+					}
+				}
+				else if (m_triangleLeaves) {
+					if (m_triangles.IntersectAny(node.primitivesOffset, node.primitiveCount, ray, ray_t.min, ray_t.max)) {
+						return true;
+					}
+				}
+				else {
+					for (int i = 0; i < node.primitiveCount; i++) {
+						if (m_primitives[node.primitivesOffset + i]->Occluded(ray, ray_t)) {
+							return true;
+						}
+					}
+				}
+
+				if (toVisitCount == 0) break;
+				currentNode = nodesToVisit[--toVisitCount];
+			}
+			else {
+				nodesToVisit[toVisitCount++] = node.secondChildOffset;
+				currentNode = currentNode + 1;
+			}
+		}
+		else {
+			if (toVisitCount == 0) break;
+			currentNode = nodesToVisit[--toVisitCount];
+		}
+	}
+
+	return false;
+}
+
+void LinearBVH::HitPacket(RayPacket& packet, IntersectionPoint* intersectionPoints) const {
+	if (m_nodeCount == 0 || packet.activeMask == 0) {
+		return;
+	}
+
+#ifdef STATS
+	stats->rayPacketCounter++;
+#endif
+
+	// Rays with different direction signs disagree on the child order, trace them one by one
+	if (!packet.HasCoherentDirections()) {
+		for (int lane = 0; lane < packet.size; lane++) {
+			if ((packet.activeMask & (1 << lane)) != 0 && HitSubtree(0, packet.GetRay(lane), Interval(packet.tMin, packet.tMax[lane]), intersectionPoints[lane])) {
+				packet.tMax[lane] = intersectionPoints[lane].t;
+			}
+		}
+		return;
+	}
+
+	int firstLane = 0;
+	while ((packet.activeMask & (1 << firstLane)) == 0) {
+		firstLane++;
+	}
+	bool directionIsNegative[3] = { packet.inverseDirectionX[firstLane] < 0, packet.inverseDirectionY[firstLane] < 0, packet.inverseDirectionZ[firstLane] < 0 };
+
+	int nodesToVisit[STACK_SIZE];
+	int toVisitCount = 0;
+	int currentNode = 0;
+
+	while (true) {
+		const LinearBVHNode& node = m_nodes[currentNode];
+#ifdef STATS
+		stats->traversalStepCounter++;
+#endif
+		int hitMask = IntersectNodePacket(node, packet, packet.activeMask, directionIsNegative);
+
+		if (hitMask != 0 && node.primitiveCount > 0) {
+#ifdef STATS
+			stats->leafVisitCounter++;
+#endif
+			// Mapped trees have no primitive objects, their sphere leaves are tested one lane at a time
+			if (m_primitives.empty()) {
+				for (int lane = 0; lane < packet.size; lane++) {
+					float closest = packet.tMax[lane];
+					int sphere = (hitMask & (1 << lane)) != 0 ?
+						m_spheres.IntersectClosest(node.primitivesOffset, node.primitiveCount, packet.GetRay(lane), packet.tMin, closest) : -1;
+					if (sphere >= 0) {
+						intersectionPoints[lane].t = closest;
+						m_spheres.SetHit(sphere, packet.GetRay(lane), intersectionPoints[lane]);
+						packet.tMax[lane] = closest;
+					}
+				}
+			}
+			else {
+				for (int i = 0; i < node.primitiveCount; i++) {
+					m_primitives[node.primitivesOffset + i]->HitPacket(packet, hitMask, intersectionPoints);
+				}
+			}
+		}
+		else if (hitMask != 0 && (hitMask & (hitMask - 1)) == 0) {
+			// Only one ray is left in this subtree, a packet step would waste the other lanes
+			int lane = 0;
+			while ((hitMask & (1 << lane)) == 0) {
+				lane++;
+			}
+			if (HitSubtree(currentNode, packet.GetRay(lane), Interval(packet.tMin, packet.tMax[lane]), intersectionPoints[lane])) {
+				packet.tMax[lane] = intersectionPoints[lane].t;
+			}
+		}
+		else if (hitMask != 0) {
+			if (directionIsNegative[node.axis]) {
+				nodesToVisit[toVisitCount++] = currentNode + 1;
+				currentNode = node.secondChildOffset;
+			}
+			else {
+				nodesToVisit[toVisitCount++] = node.secondChildOffset;
+				currentNode = currentNode + 1;
+			}
+			continue;
+		}
+
+		if (toVisitCount == 0) break;
+		currentNode = nodesToVisit[--toVisitCount];
+	}
+}
+
+// Slab test of one box against the lanes in laneMask, 4 lanes per SSE instruction.
+// All lanes share direction signs, so the near and far planes are the same for the whole packet.
+int LinearBVH::IntersectNodePacket(const LinearBVHNode& node, const RayPacket& packet, int laneMask, const bool* directionIsNegative) {
+#ifdef STATS
+	// One test per ray, so the counts compare with single ray traversal
+	stats->aabbRayIntersectionCounter += std::popcount((uint)laneMask);
+#endif
+
+	float nearX = directionIsNegative[0] ? node.boundsMax[0] : node.boundsMin[0];
+	float farX = directionIsNegative[0] ? node.boundsMin[0] : node.boundsMax[0];
+	float nearY = directionIsNegative[1] ? node.boundsMax[1] : node.boundsMin[1];
+	float farY = directionIsNegative[1] ? node.boundsMin[1] : node.boundsMax[1];
+	float nearZ = directionIsNegative[2] ? node.boundsMax[2] : node.boundsMin[2];
+	float farZ = directionIsNegative[2] ? node.boundsMin[2] : node.boundsMax[2];
+
+	int hitMask = 0;
+	for (int first = 0; first < packet.size; first += 4) {
+		if (((laneMask >> first) & 0xF) == 0) {
+			continue;
+		}
+
+#if defined(__SSE2__) || defined(_M_X64)
+		__m128 originX = _mm_load_ps(&packet.originX[first]);
+		__m128 originY = _mm_load_ps(&packet.originY[first]);
+		__m128 originZ = _mm_load_ps(&packet.originZ[first]);
+		__m128 inverseX = _mm_load_ps(&packet.inverseDirectionX[first]);
+		__m128 inverseY = _mm_load_ps(&packet.inverseDirectionY[first]);
+		__m128 inverseZ = _mm_load_ps(&packet.inverseDirectionZ[first]);
+
+		// A NaN from 0 * inf is placed first in min/max, which then returns the other operand
+		__m128 tNear = _mm_set1_ps(packet.tMin);
+		tNear = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(nearX), originX), inverseX), tNear);
+		tNear = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(nearY), originY), inverseY), tNear);
+		tNear = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(nearZ), originZ), inverseZ), tNear);
+
+		__m128 tFar = _mm_load_ps(&packet.tMax[first]);
+		tFar = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(farX), originX), inverseX), tFar);
+		tFar = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(farY), originY), inverseY), tFar);
+		tFar = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(farZ), originZ), inverseZ), tFar);
+
+		hitMask |= _mm_movemask_ps(_mm_cmplt_ps(tNear, tFar)) << first;
+#else
+		for (int lane = first; lane < first + 4; lane++) {
+			float tNear = packet.tMin, tFar = packet.tMax[lane];
+			tNear = std::max(tNear, (nearX - packet.originX[lane]) * packet.inverseDirectionX[lane]);
+			tNear = std::max(tNear, (nearY - packet.originY[lane]) * packet.inverseDirectionY[lane]);
+			tNear = std::max(tNear, (nearZ - packet.originZ[lane]) * packet.inverseDirectionZ[lane]);
+			tFar = std::min(tFar, (farX - packet.originX[lane]) * packet.inverseDirectionX[lane]);
+			tFar = std::min(tFar, (farY - packet.originY[lane]) * packet.inverseDirectionY[lane]);
+			tFar = std::min(tFar, (farZ - packet.originZ[lane]) * packet.inverseDirectionZ[lane]);
+			hitMask |= (tNear < tFar) ? (1 << lane) : 0;
+		}
+#endif
+	}
+
+	return hitMask & laneMask;
+}
+
+inline bool LinearBVH::IntersectNode(const LinearBVHNode& node, const float3& origin, const float3& inverseDirection, float tMin, float tMax) {
+#ifdef STATS
+	stats->aabbRayIntersectionCounter++;
+#endif
+
+	for (int axis = 0; axis < 3; axis++) {
+		float t0 = (node.boundsMin[axis] - origin[axis]) * inverseDirection[axis];
+		float t1 = (node.boundsMax[axis] - origin[axis]) * inverseDirection[axis];
+
+		if (t0 > t1) {
+			std::swap(t0, t1);
+		}
+
+		tMin = std::max(tMin, t0);
+		tMax = std::min(tMax, t1);
+
+		if (tMax <= tMin)
+			return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstdint>
+#include "bvh.hpp"
+#include "../../scene/sphere_soa.hpp"
+#include "../../scene/triangle_soa.hpp"
+
+// Compact BVH node, nodes are laid out depth-first so the first child of an interior node directly follows it
+struct alignas(32) LinearBVHNode {
+	float boundsMin[3];
+	float boundsMax[3];
+	union {
+		int primitivesOffset;  // leaf
+		int secondChildOffset; // interior
+	};
+	std::uint16_t primitiveCount; // 0 for interior nodes
+	std::uint8_t axis;
+	std::uint8_t padding;
+};
+static_assert(sizeof(LinearBVHNode) == 32, "LinearBVHNode should fit in half a cache line");
+
+// Pointer-free BVH, flattened from a built BVHNode tree (or emitted directly by SAHBuilder) and traversed iteratively
+class LinearBVH {
+public:
+	LinearBVH(const BVHNode& root);
+	LinearBVH(vector<LinearBVHNode>&& nodes, vector<std::shared_ptr<Primitive>>&& orderedPrimitives);
+	// Read-only view of nodes built before, over spheres already in leaf order (a scene cache). There are no primitive objects, the leaves
+	// only run the sphere kernel, and nodes and spheres have to outlive the tree
+	LinearBVH(const LinearBVHNode* nodes, int nodeCount, const SphereSoA& spheres);
+	~LinearBVH() = default;
+
+	LinearBVH(const LinearBVH&) = delete;
+	LinearBVH& operator=(const LinearBVH&) = delete;
+
+	bool Hit(const Ray& ray, const Interval& ray_t, IntersectionPoint& intersectionPoint) const;
+	bool Occluded(const Ray& ray, const Interval& ray_t) const;
+	// Closest hit for every active lane, traversed together while the rays stay coherent
+	void HitPacket(RayPacket& packet, IntersectionPoint* intersectionPoints) const;
+
+	// Expected cost of a random ray relative to the box of rootNode, for the subtree below it. Lower is a better tree
+	float ComputeSAHCost(float traversalCost, float intersectionCost, int rootNode = 0) const;
+	int GetNodeCount() const { return m_nodeCount; }
+	const LinearBVHNode* GetNodes() const { return m_nodes; }
+	// Mapped trees cannot be refit or have subtrees replaced
+	bool IsMapped() const { return m_nodes != m_ownedNodes.data(); }
+	const vector<std::shared_ptr<Primitive>>& GetPrimitives() const { return m_primitives; }
+
+	// Copies the scene's sphere data in leaf order, so leaves with only spheres run the SIMD kernel instead of the virtual calls.
+	// Leaves fall back to the primitives if any of them is not in sceneSpheres
+	void GatherSphereData(const SphereSoA& sceneSpheres);
+	const SphereSoA& GetSphereData() const { return m_spheres; }
+	bool HasSphereLeaves() const { return m_sphereLeaves; }
+	// Same for meshes: copies the triangles' vertices in leaf order when every primitive is a Triangle
+	void GatherTriangleData();
+	const TriangleSoA& GetTriangleData() const { return m_triangles; }
+	bool HasTriangleLeaves() const { return m_triangleLeaves; }
+
+	// Recomputes every box from the current bounds of the primitives, bottom-up, and the leaf-order sphere copies with them. The tree
+	// keeps its shape, so the cost is one pass over the nodes, split into subtrees for threadCount threads (0 uses all hardware threads).
+	// Trees under PARALLEL_REFIT_THRESHOLD nodes are refit on the calling thread
+	void Refit(int threadCount = 0);
+	// The nodes depth levels below the root and the leaves above them, in node order. Together they cover every node but the few above them
+	vector<int> GetSubtreeRoots(int depth) const;
+	// Nodes are depth-first, the subtree of rootNode is [rootNode, GetSubtreeEnd(rootNode)) and its primitives are consecutive as well
+	int GetSubtreeEnd(int rootNode) const;
+	vector<std::shared_ptr<Primitive>> GetSubtreePrimitives(int rootNode) const;
+	// Swaps the subtree of rootNode for a tree built over the same primitives, in any order. The sphere and triangle data have to be gathered again
+	void ReplaceSubtree(int rootNode, const LinearBVH& subtree);
+
+	static float GetSurfaceArea(const LinearBVHNode& node);
+
+	// Deepest a leaf may be, the builders keep to it (SAHBuilder falls back to median splits near it) and the traversal stacks are sized for it
+	static constexpr int MAX_DEPTH = 64;
+	// Starting the threads costs more than refitting a smaller tree, which animated scenes do every frame
+	static constexpr int PARALLEL_REFIT_THRESHOLD = 1 << 16;
+
+private:
+	const LinearBVHNode* m_nodes = nullptr;
+	int m_nodeCount = 0;
+	vector<LinearBVHNode> m_ownedNodes;
+	vector<std::shared_ptr<Primitive>> m_primitives;
+	SphereSoA m_spheres;
+	bool m_sphereLeaves = false;
+	TriangleSoA m_triangles;
+	bool m_triangleLeaves = false;
+
+	// Every level above the current node left at most one node to visit
+	static constexpr int STACK_SIZE = MAX_DEPTH;
+
+	void PointAtOwnedNodes();
+	int Flatten(const BVHNode& node);
+	void RefitNode(int nodeIndex);
+	void RefitAbove(int nodeIndex, int depth);
+	int GetFirstPrimitive(int rootNode) const;
+	int AddLeaf(const AABB& bbox, std::initializer_list<std::shared_ptr<GeometricObject>> objects);
+	bool HitSubtree(int rootNode, const Ray& ray, const Interval& ray_t, IntersectionPoint& intersectionPoint) const;
+	static int IntersectNodePacket(const LinearBVHNode& node, const RayPacket& packet, int laneMask, const bool* directionIsNegative);
+	static bool IntersectNode(const LinearBVHNode& node, const float3& origin, const float3& inverseDirection, float tMin, float tMax);
+};
@@ -0,0 +1,323 @@
+#include "sah_builder.hpp"
+#include <algorithm>
+#include <future>
+#include "../../utils/parallel.hpp"
+
+void SAHBuilder::Bounds::Grow(const float3& point) {
+	min = glm::min(min, point);
+	max = glm::max(max, point);
+}
+
+void SAHBuilder::Bounds::Grow(const Bounds& bounds) {
+	min = glm::min(min, bounds.min);
+	max = glm::max(max, bounds.max);
+}
+
+float SAHBuilder::Bounds::SurfaceArea() const {
+	float3 extent = max - min;
+	if (extent.x < 0 || extent.y < 0 || extent.z < 0) {
+		return 0.0f;
+	}
+	return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+static int CeilLog2(int count) {
+	int log = 0;
+	while ((1ll << log) < count) {
+		log++;
+	}
+	return log;
+}
+
+SAHBuilder::SAHBuilder(const BVHBuildSettings& settings) : m_settings(settings) {
+	m_settings.binCount = std::max(2, m_settings.binCount);
+	m_settings.maxLeafSize = std::clamp(m_settings.maxLeafSize, 1, (int)UINT16_MAX);
+	m_settings.parallelThreshold = std::max(m_settings.maxLeafSize, m_settings.parallelThreshold);
+	m_threadCount = ResolveThreadCount(m_settings.threadCount);
+
+	// Enough task levels to give every thread a few subtrees, without spawning a thread per node
+	m_maxTaskDepth = 0;
+	while ((1 << m_maxTaskDepth) < 4 * m_threadCount) {
+		m_maxTaskDepth++;
+	}
+}
+
+LinearBVH* SAHBuilder::Build(const vector<std::shared_ptr<Primitive>>& objects, int rootDepth) {
+	int objectCount = (int)objects.size();
+	m_rootDepth = rootDepth;
+	m_buildPrimitives.resize(objectCount);
+	m_scratch.resize(objectCount);
+
+	int chunkCount = objectCount >= PARALLEL_BINNING_THRESHOLD ? m_threadCount : 1;
+	ParallelForChunks(objectCount, chunkCount, [&](int, int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			AABB bbox = objects[i]->GetBoundingBox();
+			BuildPrimitive& buildPrimitive = m_buildPrimitives[i];
+			buildPrimitive.bounds.min = float3(bbox.GetAxis(0).min, bbox.GetAxis(1).min, bbox.GetAxis(2).min);
+			buildPrimitive.bounds.max = float3(bbox.GetAxis(0).max, bbox.GetAxis(1).max, bbox.GetAxis(2).max);
+			buildPrimitive.centroid = 0.5f * (buildPrimitive.bounds.min + buildPrimitive.bounds.max);
+			buildPrimitive.index = i;
+		}
+	});
+
+	vector<LinearBVHNode> nodes;
+	nodes.reserve(2 * objectCount);
+	if (objectCount > 0) {
+		BuildRecursive(0, objectCount, nodes, 0, m_threadCount);
+	}
+
+	// Leaves cover consecutive ranges of the partitioned build primitives, so that order is the leaf order
+	vector<std::shared_ptr<Primitive>> orderedPrimitives(objectCount);
+	for (int i = 0; i < objectCount; i++) {
+		orderedPrimitives[i] = objects[m_buildPrimitives[i].index];
+	}
+
+	m_buildPrimitives.clear();
+	m_scratch.clear();
+	return new LinearBVH(std::move(nodes), std::move(orderedPrimitives));
+}
+
+int SAHBuilder::BuildRecursive(int start, int end, vector<LinearBVHNode>& nodes, int depth, int threadCount) {
+	Bounds bounds, centroidBounds;
+	ComputeBounds(start, end, threadCount, bounds, centroidBounds);
+
+	int primitiveCount = end - start;
+	if (primitiveCount == 1) {
+		return AddLeaf(bounds, start, end, nodes);
+	}
+
+	// Bin the centroids along every axis and sweep the bin boundaries for the cheapest split
+	const int binCount = m_settings.binCount;
+	vector<Bin> bins(3 * binCount);
+	BinPrimitives(start, end, threadCount, centroidBounds, bins);
+
+	float bestCost = INFINITY;
+	int bestAxis = -1;
+	int bestSplit = 0;
+
+	vector<float> rightAreas(binCount);
+	vector<int> rightCounts(binCount);
+
+	for (int axis = 0; axis < 3; axis++) {
+		if (centroidBounds.max[axis] - centroidBounds.min[axis] <= 0.0f) {
+			continue;
+		}
+
+		const Bin* axisBins = &bins[axis * binCount];
+
+		Bounds rightBounds;
+		int rightCount = 0;
+		for (int split = binCount - 1; split > 0; split--) {
+			rightBounds.Grow(axisBins[split].bounds);
+			rightCount += axisBins[split].count;
+			rightAreas[split] = rightBounds.SurfaceArea();
+			rightCounts[split] = rightCount;
+		}
+
+		Bounds leftBounds;
+		int leftCount = 0;
+		for (int split = 1; split < binCount; split++) {
+			leftBounds.Grow(axisBins[split - 1].bounds);
+			leftCount += axisBins[split - 1].count;
+
+			float cost = leftBounds.SurfaceArea() * leftCount + rightAreas[split] * rightCounts[split];
+			if (leftCount > 0 && rightCounts[split] > 0 && cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	float area = bounds.SurfaceArea();
+	float leafCost = m_settings.intersectionCost * primitiveCount;
+	float splitCost = m_settings.traversalCost + (area > 0.0f ? m_settings.intersectionCost * bestCost / area : 0.0f);
+
+	if (primitiveCount <= m_settings.maxLeafSize && (bestAxis == -1 || leafCost <= splitCost)) {
+		return AddLeaf(bounds, start, end, nodes);
+	}
+
+	// Halving the range needs ceil(log2(primitiveCount)) more levels, once that is all the depth left every split is a median split
+	int depthLeft = LinearBVH::MAX_DEPTH - m_rootDepth - depth;
+	bool medianSplit = depthLeft <= CeilLog2(primitiveCount);
+
+	int mid;
+	if (bestAxis == -1) {
+		// All centroids coincide, any split is as good as another
+		bestAxis = 0;
+		mid = start + primitiveCount / 2;
+	}
+	else if (medianSplit) {
+		bestAxis = 0;
+		for (int axis = 1; axis < 3; axis++) {
+			if (centroidBounds.max[axis] - centroidBounds.min[axis] > centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis]) {
+				bestAxis = axis;
+			}
+		}
+		mid = start + primitiveCount / 2;
+		std::nth_element(m_buildPrimitives.begin() + start, m_buildPrimitives.begin() + mid, m_buildPrimitives.begin() + end,
+			[&](const BuildPrimitive& first, const BuildPrimitive& second) { return first.centroid[bestAxis] < second.centroid[bestAxis]; });
+	}
+	else {
+		mid = Partition(start, end, threadCount, bestAxis, bestSplit, centroidBounds);
+	}
+
+	int nodeIndex = (int)nodes.size();
+	LinearBVHNode& node = nodes.emplace_back();
+	for (int axis = 0; axis < 3; axis++) {
+		node.boundsMin[axis] = bounds.min[axis];
+		node.boundsMax[axis] = bounds.max[axis];
+	}
+	node.primitiveCount = 0;
+	node.axis = (std::uint8_t)bestAxis;
+
+	int secondChildOffset;
+	if (primitiveCount >= m_settings.parallelThreshold && depth < m_maxTaskDepth) {
+		// Build the right subtree on another thread into its own array, then splice it in behind the left one
+		vector<LinearBVHNode> rightNodes;
+		int rightThreadCount = std::max(1, threadCount / 2);
+		std::future<void> rightTask = std::async(std::launch::async, [&]() {
+			rightNodes.reserve(2 * (end - mid));
+			BuildRecursive(mid, end, rightNodes, depth + 1, rightThreadCount);
+		});
+		BuildRecursive(start, mid, nodes, depth + 1, std::max(1, threadCount - rightThreadCount));
+		rightTask.get();
+		secondChildOffset = AppendSubtree(nodes, rightNodes);
+	}
+	else {
+		BuildRecursive(start, mid, nodes, depth + 1, threadCount);
+		secondChildOffset = BuildRecursive(mid, end, nodes, depth + 1, threadCount);
+	}
+	nodes[nodeIndex].secondChildOffset = secondChildOffset;
+
+	return nodeIndex;
+}
+
+int SAHBuilder::AddLeaf(const Bounds& bounds, int start, int end, vector<LinearBVHNode>& nodes) {
+	int nodeIndex = (int)nodes.size();
+	LinearBVHNode& leaf = nodes.emplace_back();
+	for (int axis = 0; axis < 3; axis++) {
+		leaf.boundsMin[axis] = bounds.min[axis];
+		leaf.boundsMax[axis] = bounds.max[axis];
+	}
+	leaf.primitivesOffset = start;
+	leaf.primitiveCount = (std::uint16_t)(end - start);
+	leaf.axis = 0;
+
+	return nodeIndex;
+}
+
+int SAHBuilder::AppendSubtree(vector<LinearBVHNode>& nodes, const vector<LinearBVHNode>& subtree) {
+	int offset = (int)nodes.size();
+	nodes.insert(nodes.end(), subtree.begin(), subtree.end());
+	for (int i = offset; i < (int)nodes.size(); i++) {
+		if (nodes[i].primitiveCount == 0) {
+			nodes[i].secondChildOffset += offset;
+		}
+	}
+	return offset;
+}
+
+void SAHBuilder::ComputeBounds(int start, int end, int threadCount, Bounds& bounds, Bounds& centroidBounds) {
+	int count = end - start;
+	int chunkCount = count >= PARALLEL_BINNING_THRESHOLD ? threadCount : 1;
+
+	vector<Bounds> chunkBounds(chunkCount), chunkCentroidBounds(chunkCount);
+	ParallelForChunks(count, chunkCount, [&](int chunk, int begin, int finish) {
+		for (int i = start + begin; i < start + finish; i++) {
+			chunkBounds[chunk].Grow(m_buildPrimitives[i].bounds);
+			chunkCentroidBounds[chunk].Grow(m_buildPrimitives[i].centroid);
+		}
+	});
+
+	for (int chunk = 0; chunk < chunkCount; chunk++) {
+		bounds.Grow(chunkBounds[chunk]);
+		centroidBounds.Grow(chunkCentroidBounds[chunk]);
+	}
+}
+
+int SAHBuilder::GetBinIndex(const BuildPrimitive& primitive, int axis, const Bounds& centroidBounds) const {
+	float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+	int binIndex = (int)((primitive.centroid[axis] - centroidBounds.min[axis]) * (m_settings.binCount / extent));
+	return std::clamp(binIndex, 0, m_settings.binCount - 1);
+}
+
+void SAHBuilder::BinPrimitives(int start, int end, int threadCount, const Bounds& centroidBounds, vector<Bin>& bins) {
+	const int binCount = m_settings.binCount;
+	int count = end - start;
+	int chunkCount = count >= PARALLEL_BINNING_THRESHOLD ? threadCount : 1;
+
+	// Every chunk fills its own set of bins, they are merged afterwards
+	vector<vector<Bin>> chunkBins(chunkCount, vector<Bin>(3 * binCount));
+	ParallelForChunks(count, chunkCount, [&](int chunk, int begin, int finish) {
+		vector<Bin>& localBins = chunkBins[chunk];
+		for (int axis = 0; axis < 3; axis++) {
+			if (centroidBounds.max[axis] - centroidBounds.min[axis] <= 0.0f) {
+				continue;
+			}
+
+			Bin* axisBins = &localBins[axis * binCount];
+			for (int i = start + begin; i < start + finish; i++) {
+				Bin& bin = axisBins[GetBinIndex(m_buildPrimitives[i], axis, centroidBounds)];
+				bin.count++;
+				bin.bounds.Grow(m_buildPrimitives[i].bounds);
+			}
+		}
+	});
+
+	for (const vector<Bin>& localBins : chunkBins) {
+		for (int i = 0; i < 3 * binCount; i++) {
+			bins[i].count += localBins[i].count;
+			bins[i].bounds.Grow(localBins[i].bounds);
+		}
+	}
+}
+
+int SAHBuilder::Partition(int start, int end, int threadCount, int axis, int split, const Bounds& centroidBounds) {
+	auto isLeft = [&](const BuildPrimitive& primitive) { return GetBinIndex(primitive, axis, centroidBounds) < split; };
+
+	int count = end - start;
+	if (count < PARALLEL_BINNING_THRESHOLD) {
+		auto middle = std::partition(m_buildPrimitives.begin() + start, m_buildPrimitives.begin() + end, isLeft);
+		return (int)(middle - m_buildPrimitives.begin());
+	}
+
+	// Count per chunk, prefix sum the counts into output offsets, then scatter through the scratch buffer
+	int chunkCount = threadCount;
+	vector<int> leftCounts(chunkCount, 0);
+	ParallelForChunks(count, chunkCount, [&](int chunk, int begin, int finish) {
+		for (int i = start + begin; i < start + finish; i++) {
+			leftCounts[chunk] += isLeft(m_buildPrimitives[i]) ? 1 : 0;
+		}
+	});
+
+	int totalLeft = 0;
+	for (int leftCount : leftCounts) {
+		totalLeft += leftCount;
+	}
+
+	vector<int> leftOffsets(chunkCount), rightOffsets(chunkCount);
+	int leftOffset = start;
+	int rightOffset = start + totalLeft;
+	for (int chunk = 0; chunk < chunkCount; chunk++) {
+		int chunkSize = (int)((long long)count * (chunk + 1) / chunkCount) - (int)((long long)count * chunk / chunkCount);
+		leftOffsets[chunk] = leftOffset;
+		rightOffsets[chunk] = rightOffset;
+		leftOffset += leftCounts[chunk];
+		rightOffset += chunkSize - leftCounts[chunk];
+	}
+
+	ParallelForChunks(count, chunkCount, [&](int chunk, int begin, int finish) {
+		int left = leftOffsets[chunk];
+		int right = rightOffsets[chunk];
+		for (int i = start + begin; i < start + finish; i++) {
+			m_scratch[isLeft(m_buildPrimitives[i]) ? left++ : right++] = m_buildPrimitives[i];
+		}
+	});
+
+	ParallelForChunks(count, chunkCount, [&](int, int begin, int finish) {
+		std::copy(m_scratch.begin() + start + begin, m_scratch.begin() + start + finish, m_buildPrimitives.begin() + start + begin);
+	});
+
+	return start + totalLeft;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "linear_bvh.hpp"
+
+enum class BVHBuilder {
+	Median, // BVHNode: object median on the longest axis, one or two primitives per leaf
+	SAH,    // SAHBuilder: binned surface area heuristic
+};
+
+struct BVHBuildSettings {
+	BVHBuilder builder = BVHBuilder::SAH;
+	int binCount = 16;
+	int maxLeafSize = 4;
+	float traversalCost = 1.0f;
+	float intersectionCost = 1.0f;
+
+	// Subtrees with more primitives than this are built as separate tasks, 0 threads uses all hardware threads
+	int threadCount = 0;
+	int parallelThreshold = 4096;
+
+	// RayTracer::UpdateBVH rebuilds a refit subtree once its SAH cost is this many times what it was after its last build,
+	// and the whole tree when the total cost is
+	float rebuildCostGrowth = 1.5f;
+};
+
+// Binned SAH builder (Wald, "On fast Construction of SAH-based Bounding Volume Hierarchies"), emits the flattened layout directly.
+// Large subtrees are built in parallel, and the top levels also bin and partition their primitives in parallel.
+class SAHBuilder {
+public:
+	SAHBuilder(const BVHBuildSettings& settings);
+	~SAHBuilder() = default;
+
+	// rootDepth is how deep the tree's root will sit, for subtrees that are spliced into a bigger tree (LinearBVH::ReplaceSubtree)
+	LinearBVH* Build(const vector<std::shared_ptr<Primitive>>& objects, int rootDepth = 0);
+
+private:
+	struct Bounds {
+		float3 min = float3(INFINITY);
+		float3 max = float3(-INFINITY);
+
+		void Grow(const float3& point);
+		void Grow(const Bounds& bounds);
+		float SurfaceArea() const;
+	};
+
+	struct BuildPrimitive {
+		Bounds bounds;
+		float3 centroid;
+		int index;
+	};
+
+	struct Bin {
+		Bounds bounds;
+		int count = 0;
+	};
+
+	BVHBuildSettings m_settings;
+	int m_threadCount;
+	int m_maxTaskDepth;
+	int m_rootDepth = 0;
+
+	vector<BuildPrimitive> m_buildPrimitives;
+	vector<BuildPrimitive> m_scratch;
+
+	// Ranges this large are binned and partitioned by all the threads of their task together
+	static constexpr int PARALLEL_BINNING_THRESHOLD = 1 << 16;
+
+	// threadCount is the task's share of the threads: every fork halves it, so the binning of tasks running side by side never
+	// starts more threads than the build has
+	int BuildRecursive(int start, int end, vector<LinearBVHNode>& nodes, int depth, int threadCount);
+	int AddLeaf(const Bounds& bounds, int start, int end, vector<LinearBVHNode>& nodes);
+	int AppendSubtree(vector<LinearBVHNode>& nodes, const vector<LinearBVHNode>& subtree);
+
+	void ComputeBounds(int start, int end, int threadCount, Bounds& bounds, Bounds& centroidBounds);
+	void BinPrimitives(int start, int end, int threadCount, const Bounds& centroidBounds, vector<Bin>& bins);
+	int Partition(int start, int end, int threadCount, int axis, int split, const Bounds& centroidBounds);
+	int GetBinIndex(const BuildPrimitive& primitive, int axis, const Bounds& centroidBounds) const;
+};
@@ -0,0 +1,313 @@
+#include "wide_bvh.hpp"
+#if defined(__SSE2__) || defined(_M_X64) || defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+template<int Width>
+WideBVH<Width>::WideBVH(const LinearBVH& binaryBVH) :
+	m_primitives(binaryBVH.GetPrimitives()), m_spheres(binaryBVH.GetSphereData()), m_sphereLeaves(binaryBVH.HasSphereLeaves()),
+	m_triangles(binaryBVH.GetTriangleData()), m_triangleLeaves(binaryBVH.HasTriangleLeaves()) {
+	if (binaryBVH.GetNodeCount() > 0) {
+		m_nodes.reserve(binaryBVH.GetNodeCount() / (Width - 1) + 1);
+		Collapse(binaryBVH.GetNodes(), 0);
+	}
+}
+
+template<int Width>
+int WideBVH<Width>::Collapse(const LinearBVHNode* binaryNodes, int binaryNodeIndex) {
+	int nodeIndex = (int)m_nodes.size();
+	m_nodes.emplace_back();
+
+	// Start from the two children and keep opening the largest interior child until all slots are used
+	int slots[Width];
+	int slotCount = 0;
+	const LinearBVHNode& binaryNode = binaryNodes[binaryNodeIndex];
+	if (binaryNode.primitiveCount > 0) {
+		slots[slotCount++] = binaryNodeIndex;
+	}
+	else {
+		slots[slotCount++] = binaryNodeIndex + 1;
+		slots[slotCount++] = binaryNode.secondChildOffset;
+	}
+
+	while (slotCount < Width) {
+		int largestSlot = -1;
+		float largestArea = -1.0f;
+		for (int slot = 0; slot < slotCount; slot++) {
+			const LinearBVHNode& child = binaryNodes[slots[slot]];
+			float area = LinearBVH::GetSurfaceArea(child);
+			if (child.primitiveCount == 0 && area > largestArea) {
+				largestArea = area;
+				largestSlot = slot;
+			}
+		}
+
+		if (largestSlot == -1) {
+			break;
+		}
+
+		int opened = slots[largestSlot];
+		slots[largestSlot] = opened + 1;
+		slots[slotCount++] = binaryNodes[opened].secondChildOffset;
+	}
+
+	WideBVHNode<Width> node;
+	for (int slot = 0; slot < Width; slot++) {
+		if (slot >= slotCount) {
+			// Inverted bounds are never hit
+			node.boundsMinX[slot] = node.boundsMinY[slot] = node.boundsMinZ[slot] = INFINITY;
+			node.boundsMaxX[slot] = node.boundsMaxY[slot] = node.boundsMaxZ[slot] = -INFINITY;
+			node.children[slot] = -1;
+			node.primitiveCounts[slot] = 0;
+			continue;
+		}
+
+		const LinearBVHNode& child = binaryNodes[slots[slot]];
+		node.boundsMinX[slot] = child.boundsMin[0];
+		node.boundsMinY[slot] = child.boundsMin[1];
+		node.boundsMinZ[slot] = child.boundsMin[2];
+		node.boundsMaxX[slot] = child.boundsMax[0];
+		node.boundsMaxY[slot] = child.boundsMax[1];
+		node.boundsMaxZ[slot] = child.boundsMax[2];
+		node.primitiveCounts[slot] = child.primitiveCount;
+		node.children[slot] = child.primitiveCount > 0 ? child.primitivesOffset : Collapse(binaryNodes, slots[slot]);
+	}
+
+	m_nodes[nodeIndex] = node;
+	return nodeIndex;
+}
+
+template<int Width>
+bool WideBVH<Width>::Hit(const Ray& ray, const Interval& ray_t, IntersectionPoint& intersectionPoint) const {
+	if (m_nodes.empty()) {
+		return false;
+	}
+
+	struct StackEntry {
+		int child;
+		int primitiveCount;
+		float tEntry;
+	};
+
+	float3 inverseDirection = 1.0f / ray.direction;
+	bool directionIsNegative[3] = { inverseDirection.x < 0, inverseDirection.y < 0, inverseDirection.z < 0 };
+
+	StackEntry stack[STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = { 0, 0, ray_t.min };
+
+	float closest = ray_t.max;
+	bool hit = false;
+	int closestSphere = -1;
+	int closestTriangle = -1;
+
+	while (stackSize > 0) {
+		StackEntry entry = stack[--stackSize];
+		if (entry.tEntry >= closest) {
+			continue;
+		}
+#ifdef STATS
+		stats->traversalStepCounter++;
+#endif
+
+		if (entry.primitiveCount > 0) {
+#ifdef STATS
+			stats->leafVisitCounter++;
+#endif
+			if (m_sphereLeaves) {
+				int sphere = m_spheres.IntersectClosest(entry.child, entry.primitiveCount, ray, ray_t.min, closest);
+				if (sphere >= 0) {
+					closestSphere = sphere;
+				}
+				continue;
+			}
+			if (m_triangleLeaves) {
+				int triangle = m_triangles.IntersectClosest(entry.child, entry.primitiveCount, ray, ray_t.min, closest);
+				if (triangle >= 0) {
+					closestTriangle = triangle;
+				}
+				continue;
+			}
+
+			for (int i = 0; i < entry.primitiveCount; i++) {
+				if (m_primitives[entry.child + i]->Hit(ray, Interval(ray_t.min, closest), intersectionPoint)) {
+					hit = true;
+					closest = intersectionPoint.t;
+				}
+			}
+			continue;
+		}
+
+		const WideBVHNode<Width>& node = m_nodes[entry.child];
+		float tEntry[Width];
+		int hitMask = IntersectChildren(node, ray.origin, inverseDirection, directionIsNegative, ray_t.min, closest, tEntry);
+
+		// Sort the hit children far to near, so the nearest one is popped first
+		int order[Width];
+		int hitCount = 0;
+		for (int slot = 0; slot < Width; slot++) {
+			if ((hitMask & (1 << slot)) == 0) {
+				continue;
+			}
+
+			int position = hitCount++;
+			while (position > 0 && tEntry[order[position - 1]] < tEntry[slot]) {
+				order[position] = order[position - 1];
+				position--;
+			}
+			order[position] = slot;
+		}
+
+		for (int i = 0; i < hitCount; i++) {
+			int slot = order[i];
+			stack[stackSize++] = { node.children[slot], node.primitiveCounts[slot], tEntry[slot] };
+		}
+	}
+
+	if (closestSphere >= 0) {
+		intersectionPoint.t = closest;
+		m_spheres.SetHit(closestSphere, ray, intersectionPoint);
+		hit = true;
+	}
+	if (closestTriangle >= 0) {
+		intersectionPoint.t = closest;
+		m_triangles.SetHit(closestTriangle, ray, intersectionPoint);
+		hit = true;
+	}
+
+	return hit;
+}
+
+template<int Width>
+bool WideBVH<Width>::Occluded(const Ray& ray, const Interval& ray_t) const {
+	if (m_nodes.empty()) {
+		return false;
+	}
+
+	float3 inverseDirection = 1.0f / ray.direction;
+	bool directionIsNegative[3] = { inverseDirection.x < 0, inverseDirection.y < 0, inverseDirection.z < 0 };
+
+	int stack[STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	// Leaf children are tested right away and interior children are pushed unsorted, the first hit ends the traversal
+	while (stackSize > 0) {
+		const WideBVHNode<Width>& node = m_nodes[stack[--stackSize]];
+#ifdef STATS
+		stats->traversalStepCounter++;
+#endif
+		float tEntry[Width];
+		int hitMask = IntersectChildren(node, ray.origin, inverseDirection, directionIsNegative, ray_t.min, ray_t.max, tEntry);
+
+		for (int slot = 0; slot < Width; slot++) {
+			if ((hitMask & (1 << slot)) == 0) {
+				continue;
+			}
+
+			if (node.primitiveCounts[slot] == 0) {
+				stack[stackSize++] = node.children[slot];
+				continue;
+			}
+#ifdef STATS
+			stats->leafVisitCounter++;
+#endif
+
+			if (m_sphereLeaves) {
+				if (m_spheres.IntersectAny(node.children[slot], node.primitiveCounts[slot], ray, ray_t.min, ray_t.max)) {
+					return true;
+				}
+				continue;
+			}
+			if (m_triangleLeaves) {
+				if (m_triangles.IntersectAny(node.children[slot], node.primitiveCounts[slot], ray, ray_t.min, ray_t.max)) {
+					return true;
+				}
+				continue;
+			}
+
+			for (int i = 0; i < node.primitiveCounts[slot]; i++) {
+				if (m_primitives[node.children[slot] + i]->Occluded(ray, ray_t)) {
+					return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+// Slab test against all children at once, returns a bit per hit child and writes the entry distances.
+// Near and far planes are picked per axis from the ray direction, so inverted (empty) boxes never report a hit.
+template<int Width>
+int WideBVH<Width>::IntersectChildren(const WideBVHNode<Width>& node, const float3& origin, const float3& inverseDirection, const bool* directionIsNegative, float tMin, float tMax, float* tEntry) {
+#ifdef STATS
+	stats->aabbRayIntersectionCounter += Width;
+#endif
+
+	const float* nearX = directionIsNegative[0] ? node.boundsMaxX : node.boundsMinX;
+	const float* farX = directionIsNegative[0] ? node.boundsMinX : node.boundsMaxX;
+	const float* nearY = directionIsNegative[1] ? node.boundsMaxY : node.boundsMinY;
+	const float* farY = directionIsNegative[1] ? node.boundsMinY : node.boundsMaxY;
+	const float* nearZ = directionIsNegative[2] ? node.boundsMaxZ : node.boundsMinZ;
+	const float* farZ = directionIsNegative[2] ? node.boundsMinZ : node.boundsMaxZ;
+
+#if defined(__AVX__)
+	if constexpr (Width == 8) {
+		__m256 originX = _mm256_set1_ps(origin.x), originY = _mm256_set1_ps(origin.y), originZ = _mm256_set1_ps(origin.z);
+		__m256 inverseX = _mm256_set1_ps(inverseDirection.x), inverseY = _mm256_set1_ps(inverseDirection.y), inverseZ = _mm256_set1_ps(inverseDirection.z);
+
+		// A NaN from 0 * inf is placed first in min/max, which then returns the other operand
+		__m256 tNear = _mm256_set1_ps(tMin);
+		tNear = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(nearX), originX), inverseX), tNear);
+		tNear = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(nearY), originY), inverseY), tNear);
+		tNear = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(nearZ), originZ), inverseZ), tNear);
+
+		__m256 tFar = _mm256_set1_ps(tMax);
+		tFar = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(farX), originX), inverseX), tFar);
+		tFar = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(farY), originY), inverseY), tFar);
+		tFar = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(farZ), originZ), inverseZ), tFar);
+
+		_mm256_storeu_ps(tEntry, tNear);
+		return _mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LT_OQ));
+	}
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+	if constexpr (Width == 4) {
+		__m128 originX = _mm_set1_ps(origin.x), originY = _mm_set1_ps(origin.y), originZ = _mm_set1_ps(origin.z);
+		__m128 inverseX = _mm_set1_ps(inverseDirection.x), inverseY = _mm_set1_ps(inverseDirection.y), inverseZ = _mm_set1_ps(inverseDirection.z);
+
+		__m128 tNear = _mm_set1_ps(tMin);
+		tNear = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearX), originX), inverseX), tNear);
+		tNear = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearY), originY), inverseY), tNear);
+		tNear = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearZ), originZ), inverseZ), tNear);
+
+		__m128 tFar = _mm_set1_ps(tMax);
+		tFar = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(farX), originX), inverseX), tFar);
+		tFar = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(farY), originY), inverseY), tFar);
+		tFar = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(farZ), originZ), inverseZ), tFar);
+
+		_mm_storeu_ps(tEntry, tNear);
+		return _mm_movemask_ps(_mm_cmplt_ps(tNear, tFar));
+	}
+#endif
+
+	// Scalar fallback for targets without the matching instruction set
+	int hitMask = 0;
+	for (int slot = 0; slot < Width; slot++) {
+		float tNear = tMin, tFar = tMax;
+		tNear = std::max(tNear, (nearX[slot] - origin.x) * inverseDirection.x);
+		tNear = std::max(tNear, (nearY[slot] - origin.y) * inverseDirection.y);
+		tNear = std::max(tNear, (nearZ[slot] - origin.z) * inverseDirection.z);
+		tFar = std::min(tFar, (farX[slot] - origin.x) * inverseDirection.x);
+		tFar = std::min(tFar, (farY[slot] - origin.y) * inverseDirection.y);
+		tFar = std::min(tFar, (farZ[slot] - origin.z) * inverseDirection.z);
+
+		tEntry[slot] = tNear;
+		hitMask |= (tNear < tFar) ? (1 << slot) : 0;
+	}
+	return hitMask;
+}
+
+template class WideBVH<4>;
+template class WideBVH<8>;
@@ -0,0 +1,40 @@
+#pragma once
+#include "linear_bvh.hpp"
+
+// BVH node with Width children whose boxes are stored per axis (SoA), so all of them are tested with one SIMD slab test
+template<int Width>
+struct alignas(32) WideBVHNode {
+	float boundsMinX[Width], boundsMinY[Width], boundsMinZ[Width];
+	float boundsMaxX[Width], boundsMaxY[Width], boundsMaxZ[Width];
+	int children[Width];                   // node index, or primitive offset for leaf children
+	std::uint16_t primitiveCounts[Width];  // > 0 for leaf children
+};
+
+// 4- or 8-wide BVH, built by collapsing a binary LinearBVH
+template<int Width>
+class WideBVH {
+public:
+	static_assert(Width == 4 || Width == 8, "WideBVH supports 4 or 8 children per node");
+
+	WideBVH(const LinearBVH& binaryBVH);
+	~WideBVH() = default;
+
+	bool Hit(const Ray& ray, const Interval& ray_t, IntersectionPoint& intersectionPoint) const;
+	bool Occluded(const Ray& ray, const Interval& ray_t) const;
+
+	int GetNodeCount() const { return (int)m_nodes.size(); }
+
+private:
+	vector<WideBVHNode<Width>> m_nodes;
+	vector<std::shared_ptr<Primitive>> m_primitives;
+	SphereSoA m_spheres;
+	bool m_sphereLeaves;
+	TriangleSoA m_triangles;
+	bool m_triangleLeaves;
+
+	// A wide node is at least one binary level below its parent, and every level leaves at most Width - 1 children to visit
+	static constexpr int STACK_SIZE = (Width - 1) * LinearBVH::MAX_DEPTH + 1;
+
+	int Collapse(const LinearBVHNode* binaryNodes, int binaryNodeIndex);
+	static int IntersectChildren(const WideBVHNode<Width>& node, const float3& origin, const float3& inverseDirection, const bool* directionIsNegative, float tMin, float tMax, float* tEntry);
+};
@@ -0,0 +1,89 @@
+#include "adaptive_sampler.hpp"
+
+// Dark pixels measure their error against this luminance instead of their own, or shadows would never converge
+static constexpr float MIN_REFERENCE_LUMINANCE = 0.05f;
+// Two-sided 95% confidence
+static constexpr float CONFIDENCE_Z = 1.96f;
+
+AdaptiveSampler::AdaptiveSampler(const RenderSettings& settings) : m_width(settings.width), m_height(settings.height), m_threshold(settings.adaptiveThreshold) {
+	m_maxSamples = settings.adaptiveMaxSamples > 0 ? settings.adaptiveMaxSamples : 4 * settings.samplesPerPixel;
+	// The variance needs at least two samples
+	m_minSamples = std::clamp(settings.adaptiveMinSamples, 2, std::max(2, m_maxSamples));
+	m_pixels.resize(settings.GetPixelCount());
+	m_noisy.resize(settings.GetPixelCount());
+	Reset();
+}
+
+void AdaptiveSampler::Reset() {
+	std::fill(m_pixels.begin(), m_pixels.end(), PixelStatistics{ { 0.0f, 0.0f, 0.0f }, 0.0f, 0.0f, 0, false });
+	std::fill(m_noisy.begin(), m_noisy.end(), 1);
+}
+
+void AdaptiveSampler::AddSample(int pixelIndex, const Color& sample) {
+	PixelStatistics& pixel = m_pixels[pixelIndex];
+	pixel.sum[0] += sample.r;
+	pixel.sum[1] += sample.g;
+	pixel.sum[2] += sample.b;
+
+	float luminance = 0.2126f * sample.r + 0.7152f * sample.g + 0.0722f * sample.b;
+	pixel.sampleCount++;
+	float delta = luminance - pixel.mean;
+	pixel.mean += delta / pixel.sampleCount;
+	pixel.m2 += delta * (luminance - pixel.mean);
+}
+
+bool AdaptiveSampler::IsNoisy(const PixelStatistics& pixel) const {
+	if (pixel.sampleCount < m_minSamples) {
+		return true;
+	}
+
+	float variance = pixel.m2 / (pixel.sampleCount - 1);
+	float halfWidth = CONFIDENCE_Z * std::sqrt(variance / pixel.sampleCount);
+	return halfWidth > m_threshold * std::max(pixel.mean, MIN_REFERENCE_LUMINANCE);
+}
+
+void AdaptiveSampler::UpdateNoise(int pixelIndex) {
+	m_noisy[pixelIndex] = IsNoisy(m_pixels[pixelIndex]);
+}
+
+int AdaptiveSampler::UpdateConvergence(const Tile& tile) {
+	// A few samples that all land on the same side of an edge have no variance at all, so a pixel only stops
+	// once its neighbours are quiet as well. Noisy regions grow by a pixel per round until their borders are covered
+	int activePixels = 0;
+	for (int y = tile.y0; y < tile.y1; y++) {
+		for (int x = tile.x0; x < tile.x1; x++) {
+			PixelStatistics& pixel = m_pixels[y * m_width + x];
+			if (pixel.sampleCount >= m_maxSamples) {
+				pixel.converged = true;
+				continue;
+			}
+
+			bool quiet = true;
+			for (int ny = std::max(0, y - 1); ny <= std::min(m_height - 1, y + 1) && quiet; ny++) {
+				for (int nx = std::max(0, x - 1); nx <= std::min(m_width - 1, x + 1); nx++) {
+					if (m_noisy[ny * m_width + nx]) {
+						quiet = false;
+						break;
+					}
+				}
+			}
+			pixel.converged = quiet;
+			activePixels += quiet ? 0 : 1;
+		}
+	}
+	return activePixels;
+}
+
+Color AdaptiveSampler::GetMean(int pixelIndex) const {
+	const PixelStatistics& pixel = m_pixels[pixelIndex];
+	float scale = 1.0f / std::max(1, pixel.sampleCount);
+	return Color(pixel.sum[0] * scale, pixel.sum[1] * scale, pixel.sum[2] * scale, 1.0f);
+}
+
+void AdaptiveSampler::WriteHeatmap(uchar* pixels) const {
+	float range = (float)std::max(1, m_maxSamples - m_minSamples);
+	for (int i = 0; i < (int)m_pixels.size(); i++) {
+		float t = Saturate((m_pixels[i].sampleCount - m_minSamples) / range);
+		WriteColor(pixels, m_width, i % m_width, i / m_width, HeatmapColor(t));
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "render_settings.hpp"
+#include "tile_scheduler.hpp"
+
+// Running per-pixel statistics for adaptive sampling. Every pixel keeps its color sum and a Welford mean/variance of the
+// sample luminance, and stops taking samples once the 95% confidence interval of that mean is narrow enough
+class AdaptiveSampler {
+public:
+	AdaptiveSampler(const RenderSettings& settings);
+
+	void Reset();
+	// Different pixels can be sampled from different threads. UpdateNoise tests the confidence interval once the pixel's samples of a round are in
+	void AddSample(int pixelIndex, const Color& sample);
+	void UpdateNoise(int pixelIndex);
+	// Called per tile between rounds, after all UpdateNoise calls: a pixel is done once it and its 8 neighbours have a narrow enough
+	// confidence interval, or once it hit the sample limit. Returns the pixels of the tile that are not done
+	int UpdateConvergence(const Tile& tile);
+
+	bool IsConverged(int pixelIndex) const { return m_pixels[pixelIndex].converged; }
+	int GetSampleCount(int pixelIndex) const { return m_pixels[pixelIndex].sampleCount; }
+	Color GetMean(int pixelIndex) const;
+	int GetMinSamples() const { return m_minSamples; }
+	int GetMaxSamples() const { return m_maxSamples; }
+
+	// Samples per pixel from blue (adaptiveMinSamples) over green to red (the per-pixel limit), as RGBA
+	void WriteHeatmap(uchar* pixels) const;
+
+private:
+	struct PixelStatistics {
+		float sum[3];
+		float mean;
+		float m2;
+		int sampleCount;
+		bool converged;
+	};
+
+	vector<PixelStatistics> m_pixels;
+	vector<uchar> m_noisy;
+	int m_width;
+	int m_height;
+	float m_threshold;
+	int m_minSamples;
+	int m_maxSamples;
+
+	bool IsNoisy(const PixelStatistics& pixel) const;
+};
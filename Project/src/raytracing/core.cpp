@@ -1,51 +1,443 @@
 #include <chrono>
 #include "core.hpp"
 #include "raytracer.hpp"
+#include "../scene/scene_cache.hpp"
 
-Core::Core() {
-    InitializeCore();
+Core::Core(const RenderSettings& settings) : m_settings(settings), m_frameIndex(settings.seed) {
+#if BVH
+    bool useCache = !settings.sceneCache.empty() && SceneCache::IsSupported(settings.scene.type);
+    if (useCache) {
+        std::uint64_t key = SceneCache::GetKey(settings.scene, settings.bvhSettings);
+        LinearBVH* bvh = nullptr;
+        if (Scene* scene = SceneCache::Load(settings.sceneCache, key, bvh)) {
+            InitializeCore(scene, bvh);
+            return;
+        }
+    }
+#endif
+
+    // A mesh that cannot be loaded leaves the default scene, the error is logged
+    Scene* scene = SceneGenerator::Generate(settings.scene);
+    InitializeCore(scene != nullptr ? scene : Scene::CreateDefault());
+
+#if BVH
+    if (useCache) {
+        SceneCache::Save(settings.sceneCache, SceneCache::GetKey(settings.scene, settings.bvhSettings), *m_pScene, *m_pRayTracer->GetBVH());
+    }
+#endif
+}
+
+Core::Core(const RenderSettings& settings, Scene* scene) : m_settings(settings), m_frameIndex(settings.seed) {
+    InitializeCore(scene);
 }
 
 Core::~Core() {
+    // The BVH of a cached scene points into the scene's file
     delete m_pMainCamera;
-    delete m_pScene;
     delete m_pRayTracer;
+    delete m_pScene;
+    delete m_pTileScheduler;
+    delete m_pAdaptiveSampler;
+    delete m_pDenoiser;
 }
 
-void Core::InitializeCore() {
-	m_pMainCamera = new Camera(float3(0.f, 0.f, -2.f));
-    m_pScene = new Scene();
-    m_pRayTracer = new RayTracer(8);
+void Core::InitializeCore(Scene* scene, [[maybe_unused]] LinearBVH* bvh) {
+    PROFILE_SCOPE("Initialize core");
+    m_pScene = scene;
+    m_pMainCamera = new Camera(m_settings, m_pScene->GetCameraPosition(), m_pScene->GetCameraPosition() + float3(0.f, 0.f, 1.f));
+    m_pRayTracer = new RayTracer(m_settings);
+    m_pTileScheduler = new TileScheduler(m_settings.tileSize, m_settings.threadCount);
+    if (m_settings.adaptiveSampling) {
+        m_pAdaptiveSampler = new AdaptiveSampler(m_settings);
+    }
+    if (m_settings.denoise) {
+        m_pDenoiser = new Denoiser(m_settings);
+    }
 
 #if BVH
-    m_pRayTracer->BuildBVH(*m_pScene);
+    if (bvh != nullptr) {
+        m_pRayTracer->SetBVH(bvh);
+    }
+    else {
+        m_pRayTracer->BuildBVH(*m_pScene, m_settings.bvhSettings);
+    }
+#endif
+}
+
+void Core::UpdateScene() {
+#if BVH
+    m_pRayTracer->UpdateBVH(*m_pScene, m_settings.bvhSettings);
+#endif
+    ResetAccumulation();
+}
+
+void Core::GetPixels(uchar* pixels, float* hdrPixels) {
+    PROFILE_SCOPE("GetPixels");
+#ifdef STATS
+    m_stats = Stats();
+    m_statsTime = 0.0;
+#endif
+#ifdef STATS_PIXEL_COST
+    m_pixelCost.assign(m_settings.GetPixelCount(), 0.0f);
+#endif
+
+    // The denoiser filters linear color, in hdrPixels when there is one, and needs the features of the primary hits
+    float* linearPixels = hdrPixels;
+    PixelFeatures* features = nullptr;
+    if (m_pDenoiser != nullptr) {
+        m_features.resize(m_settings.GetPixelCount());
+        features = m_features.data();
+        if (linearPixels == nullptr) {
+            m_denoiseBuffer.resize(m_settings.GetPixelCount() * 3);
+            linearPixels = m_denoiseBuffer.data();
+        }
+    }
+
+#ifdef STATS_PIXEL_COST
+    m_pixelCostSamples = m_pAdaptiveSampler != nullptr ? 0 : m_settings.samplesPerPixel;
+#endif
+
+    if (m_pAdaptiveSampler != nullptr) {
+        RenderAdaptive(pixels, linearPixels, features);
+    }
+    else {
+        RenderSamples(0, m_settings.samplesPerPixel, [&](int x, int y, const Color& sum) {
+            Color color = sum;
+            color *= 1.0f / m_settings.samplesPerPixel;
+            WriteColor(pixels, m_settings.width, x, y, color);
+            if (linearPixels != nullptr) {
+                WriteColor(linearPixels, m_settings.width, x, y, color);
+            }
+        }, features);
+
+        int threadCount = m_pTileScheduler->GetThreadCount();
+        string utilization;
+        for (int i = 0; i < threadCount; i++) {
+            utilization += fmt::format(" {:.1f}%", 100.0 * m_pTileScheduler->GetUtilization(i));
+        }
+        spdlog::info("Timer | GetPixels: {} | Threads: {} | Utilization:{}", m_pTileScheduler->GetWallTime(), threadCount, utilization);
+        m_lastSampleCount = (long long)m_settings.GetPixelCount() * m_settings.samplesPerPixel;
+    }
+
+    if (m_pDenoiser != nullptr) {
+        auto start = std::chrono::steady_clock::now();
+        m_pDenoiser->Denoise(linearPixels, features, *m_pTileScheduler);
+        for (int y = 0; y < m_settings.height; y++) {
+            for (int x = 0; x < m_settings.width; x++) {
+                const float* rgb = &linearPixels[(y * m_settings.width + x) * 3];
+                WriteColor(pixels, m_settings.width, x, y, Color(rgb[0], rgb[1], rgb[2], 1.0f));
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        spdlog::info("Timer | Denoise: {} | Iterations: {}", std::chrono::duration<double>(end - start).count(), m_settings.denoiseIterations);
+    }
+
+    m_frameIndex++;
+    LogStats();
+}
+
+bool Core::RenderPass(uchar* pixels, float* hdrPixels) {
+    PROFILE_SCOPE("Render pass");
+    if (IsAccumulationDone()) {
+        return false;
+    }
+
+    // Not ResetAccumulation, a cancel still holds
+    if (m_accumulation.empty()) {
+        ClearAccumulation();
+    }
+
+    // Same sample indices as a full render, so the finished accumulation matches GetPixels
+    int sampleCount = std::min(m_settings.samplesPerPass, m_settings.samplesPerPixel - m_accumulatedSamples);
+    float scale = 1.0f / (m_accumulatedSamples + sampleCount);
+
+    RenderSamples(m_accumulatedSamples, sampleCount, [&](int x, int y, const Color& sum) {
+        float* accumulated = &m_accumulation[(y * m_settings.width + x) * 3];
+        accumulated[0] += sum.r;
+        accumulated[1] += sum.g;
+        accumulated[2] += sum.b;
+
+        Color color = Color(accumulated[0] * scale, accumulated[1] * scale, accumulated[2] * scale, 1.0f);
+        WriteColor(pixels, m_settings.width, x, y, color);
+        if (hdrPixels != nullptr) {
+            WriteColor(hdrPixels, m_settings.width, x, y, color);
+        }
+    });
+
+    // Part of the image has this pass' samples and part has not, the next pass starts over
+    if (m_pTileScheduler->WasCancelled()) {
+        m_accumulation.clear();
+        return false;
+    }
+
+    m_accumulatedSamples += sampleCount;
+#ifdef STATS_PIXEL_COST
+    m_pixelCostSamples = m_accumulatedSamples;
+#endif
+    m_accumulationTime += m_pTileScheduler->GetWallTime();
+
+    if (IsAccumulationDone()) {
+        spdlog::info("Timer | Progressive: {} | Samples: {} | Threads: {}", m_accumulationTime, m_accumulatedSamples, m_pTileScheduler->GetThreadCount());
+        LogStats();
+    }
+    return true;
+}
+
+void Core::ResetAccumulation() {
+    ClearAccumulation();
+    m_pTileScheduler->Reset();
+}
+
+void Core::ClearAccumulation() {
+    m_accumulation.assign(m_settings.GetPixelCount() * 3, 0.0f);
+    m_accumulatedSamples = 0;
+    m_accumulationTime = 0.0;
+#ifdef STATS
+    m_stats = Stats();
+    m_statsTime = 0.0;
+#endif
+#ifdef STATS_PIXEL_COST
+    m_pixelCost.assign(m_settings.GetPixelCount(), 0.0f);
+    m_pixelCostSamples = 0;
 #endif
 }
 
-void Core::GetPixels(uchar* pixels) {
+void Core::Cancel() {
+    m_pTileScheduler->Cancel();
+}
+
+bool Core::IsAccumulationDone() const {
+    if (m_accumulatedSamples >= m_settings.samplesPerPixel) {
+        return true;
+    }
+    return m_settings.timeBudget > 0.0f && m_accumulationTime >= m_settings.timeBudget;
+}
+
+void Core::RenderSamples(int firstSample, int sampleCount, const std::function<void(int, int, const Color&)>& writePixel, PixelFeatures* features) {
+#ifdef STATS
+    vector<Stats> threadStats(m_pTileScheduler->GetThreadCount());
+#endif
+
+    m_pTileScheduler->Run(m_settings.width, m_settings.height, [&](const Tile& tile, [[maybe_unused]] int threadIndex) {
+#ifdef STATS
+        stats = &threadStats[threadIndex];
+#endif
+        if (m_settings.rayPacketSize > 0) {
+            RenderTilePackets(tile, firstSample, sampleCount, writePixel, features);
+            return;
+        }
+
+        for (int y = tile.y0; y < tile.y1; y++) {
+            for (int x = tile.x0; x < tile.x1; x++) {
+                PixelFeatures* pixelFeatures = features != nullptr ? &features[y * m_settings.width + x] : nullptr;
+#ifdef STATS_PIXEL_COST
+                long long costBefore = stats->GetTraversalCost();
+#endif
+                Color sum = m_pRayTracer->GetPixelSamples(x, y, firstSample, sampleCount, *m_pMainCamera, *m_pScene, m_frameIndex, pixelFeatures);
+#ifdef STATS_PIXEL_COST
+                m_pixelCost[y * m_settings.width + x] += (float)(stats->GetTraversalCost() - costBefore);
+#endif
+                writePixel(x, y, sum);
+            }
+        }
+    });
+
+#ifdef STATS
+    stats = nullptr;
+    for (const Stats& threadStat : threadStats) {
+        m_stats += threadStat;
+    }
+    m_statsTime += m_pTileScheduler->GetWallTime();
+#endif
+}
+
+void Core::RenderAdaptive(uchar* pixels, float* hdrPixels, PixelFeatures* features) {
+    PROFILE_SCOPE("Adaptive sampling");
+    AdaptiveSampler& sampler = *m_pAdaptiveSampler;
+    sampler.Reset();
+
+    long long budget = (long long)m_settings.GetPixelCount() * m_settings.samplesPerPixel;
+    long long spent = 0;
+    double renderTime = 0.0;
+    int rounds = 0;
+
+    // Every round doubles the sample count of each unconverged pixel, until all pixels converged or the budget runs out.
+    // A round never takes more than its share of what is left of the budget, so the last one spreads it evenly
+    int activePixels = m_settings.GetPixelCount();
+    while (activePixels > 0 && spent < budget) {
+        int roundLimit = (int)std::min<long long>(sampler.GetMaxSamples(), std::max<long long>(1, (budget - spent) / activePixels));
+
+#ifdef STATS
+        vector<Stats> threadStats(m_pTileScheduler->GetThreadCount());
+#endif
+        vector<long long> threadSamples(m_pTileScheduler->GetThreadCount(), 0);
+        m_pTileScheduler->Run(m_settings.width, m_settings.height, [&](const Tile& tile, int threadIndex) {
+#ifdef STATS
+            stats = &threadStats[threadIndex];
+#endif
+            long long tileSamples = 0;
+            for (int y = tile.y0; y < tile.y1; y++) {
+                for (int x = tile.x0; x < tile.x1; x++) {
+                    int pixelIndex = y * m_settings.width + x;
+                    if (sampler.IsConverged(pixelIndex)) {
+                        continue;
+                    }
+
+                    // Sample indices continue where the pixel left off, so a pixel that takes samplesPerPixel samples matches GetPixels without adaptive sampling
+                    int firstSample = sampler.GetSampleCount(pixelIndex);
+                    int sampleCount = std::min({ std::max(sampler.GetMinSamples(), firstSample), roundLimit, sampler.GetMaxSamples() - firstSample });
+#ifdef STATS_PIXEL_COST
+                    long long costBefore = stats->GetTraversalCost();
+#endif
+                    for (int i = firstSample; i < firstSample + sampleCount; i++) {
+                        // The denoiser features come from the first sample only
+                        PixelFeatures* pixelFeatures = features != nullptr && i == 0 ? &features[pixelIndex] : nullptr;
+                        sampler.AddSample(pixelIndex, m_pRayTracer->GetPixelSamples(x, y, i, 1, *m_pMainCamera, *m_pScene, m_frameIndex, pixelFeatures));
+                    }
+#ifdef STATS_PIXEL_COST
+                    m_pixelCost[pixelIndex] += (float)(stats->GetTraversalCost() - costBefore);
+#endif
+                    sampler.UpdateNoise(pixelIndex);
+                    tileSamples += sampleCount;
+                }
+            }
+            threadSamples[threadIndex] += tileSamples;
+        });
+
 #ifdef STATS
-    stats = new Stats();
+        stats = nullptr;
+        for (const Stats& threadStat : threadStats) {
+            m_stats += threadStat;
+        }
+        m_statsTime += m_pTileScheduler->GetWallTime();
 #endif
+        renderTime += m_pTileScheduler->GetWallTime();
+        rounds++;
+        for (long long samples : threadSamples) {
+            spent += samples;
+        }
+        if (m_pTileScheduler->WasCancelled()) {
+            break;
+        }
+
+        // Convergence looks at neighbouring pixels, so it waits until every tile of the round is sampled
+        vector<int> threadActivePixels(m_pTileScheduler->GetThreadCount(), 0);
+        m_pTileScheduler->Run(m_settings.width, m_settings.height, [&](const Tile& tile, int threadIndex) {
+            threadActivePixels[threadIndex] += sampler.UpdateConvergence(tile);
+        });
+        activePixels = 0;
+        for (int active : threadActivePixels) {
+            activePixels += active;
+        }
+        if (m_pTileScheduler->WasCancelled()) {
+            break;
+        }
+    }
 
-    auto start = std::chrono::steady_clock::now();
-    
-    for (int y = 0; y < IMAGE_HEIGHT; y++) {
-        for (int x = 0; x < IMAGE_WIDTH; x++) {
-            Color color = m_pRayTracer->GetPixelColor(x, y, *m_pMainCamera, *m_pScene);            
-            WriteColor(pixels, x, y, color);
+    for (int y = 0; y < m_settings.height; y++) {
+        for (int x = 0; x < m_settings.width; x++) {
+            Color color = sampler.GetMean(y * m_settings.width + x);
+            WriteColor(pixels, m_settings.width, x, y, color);
+            if (hdrPixels != nullptr) {
+                WriteColor(hdrPixels, m_settings.width, x, y, color);
+            }
         }
     }
 
-    auto end = std::chrono::steady_clock::now();
-    std::chrono::duration<double> duration = end - start;
-    spdlog::info("Timer | GetPixels: {}", duration.count());
+    m_lastSampleCount = spent;
+    int pixelCount = m_settings.GetPixelCount();
+    spdlog::info("Timer | Adaptive: {} | Rounds: {} | Samples per pixel: {:.2f} | Converged: {:.1f}%", renderTime, rounds,
+        (double)m_lastSampleCount / pixelCount, 100.0 * (pixelCount - activePixels) / pixelCount);
+}
+
+bool Core::GetSampleCountHeatmap(uchar* pixels) const {
+    if (m_pAdaptiveSampler == nullptr) {
+        return false;
+    }
+    m_pAdaptiveSampler->WriteHeatmap(pixels);
+    return true;
+}
+
+void Core::RenderTilePackets(const Tile& tile, int firstSample, int sampleCount, const std::function<void(int, int, const Color&)>& writePixel, PixelFeatures* features) {
+    int2 blockSize = RayPacket::GetBlockSize(m_settings.rayPacketSize);
+    Color colors[RayPacket::MAX_SIZE];
+    PixelFeatures blockFeatures[RayPacket::MAX_SIZE];
+
+    for (int blockY = tile.y0; blockY < tile.y1; blockY += blockSize.y) {
+        for (int blockX = tile.x0; blockX < tile.x1; blockX += blockSize.x) {
+            int width = std::min(blockSize.x, tile.x1 - blockX);
+            int height = std::min(blockSize.y, tile.y1 - blockY);
+#ifdef STATS_PIXEL_COST
+            long long costBefore = stats->GetTraversalCost();
+#endif
+            m_pRayTracer->GetBlockSamples(blockX, blockY, width, height, firstSample, sampleCount, *m_pMainCamera, *m_pScene, m_frameIndex, colors,
+                features != nullptr ? blockFeatures : nullptr);
+#ifdef STATS_PIXEL_COST
+            // A packet's work cannot be told apart per ray, every pixel of the block gets an equal share
+            float blockCost = (float)(stats->GetTraversalCost() - costBefore) / (width * height);
+#endif
 
+            for (int i = 0; i < width * height; i++) {
+                int x = blockX + i % width;
+                int y = blockY + i / width;
+                writePixel(x, y, colors[i]);
+#ifdef STATS_PIXEL_COST
+                m_pixelCost[y * m_settings.width + x] += blockCost;
+#endif
+                if (features != nullptr) {
+                    features[y * m_settings.width + x] = blockFeatures[i];
+                }
+            }
+        }
+    }
+}
+
+bool Core::GetTraversalCostHeatmap([[maybe_unused]] uchar* pixels) const {
+#ifdef STATS_PIXEL_COST
+    if (m_pixelCost.empty()) {
+        return false;
+    }
+
+    // Cost per sample, adaptive sampling gave pixels different sample counts
+    bool adaptive = m_pixelCostSamples == 0 && m_pAdaptiveSampler != nullptr;
+    vector<float> cost(m_pixelCost.size());
+    for (int i = 0; i < (int)cost.size(); i++) {
+        int samples = adaptive ? m_pAdaptiveSampler->GetSampleCount(i) : m_pixelCostSamples;
+        cost[i] = m_pixelCost[i] / std::max(1, samples);
+    }
+
+    // Scaled to the 99th percentile, a few pathological pixels would otherwise leave the rest of the image blue
+    vector<float> sorted = cost;
+    auto percentile = sorted.begin() + (sorted.size() - 1) * 99 / 100;
+    std::nth_element(sorted.begin(), percentile, sorted.end());
+    float scale = 1.0f / std::max(*percentile, 1.0f);
+
+    for (int i = 0; i < (int)cost.size(); i++) {
+        WriteColor(pixels, m_settings.width, i % m_settings.width, i / m_settings.width, HeatmapColor(Saturate(cost[i] * scale)));
+    }
+    spdlog::info("Traversal cost heatmap | Full red at: {} tests", *percentile);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Core::LogStats() {
 #ifdef STATS
-    spdlog::info("---------- Stats ----------", stats->sphereRayIntersectionCounter);
-    spdlog::info("Primary rays generated: {}", stats->primaryRayCounter);
-    spdlog::info("Sphere/Box intersection tests: {}", stats->aabbRayIntersectionCounter);
-    spdlog::info("Sphere/Ray intersection tests: {}", stats->sphereRayIntersectionCounter);
-    spdlog::info("---------------------------", stats->sphereRayIntersectionCounter);
-    delete stats;
+    long long rays = m_stats.primaryRayCounter + m_stats.shadowRayCounter;
+    double perRay = 1.0 / std::max(1ll, rays);
+    spdlog::info("---------- Stats ----------");
+    spdlog::info("Primary rays generated: {}", m_stats.primaryRayCounter);
+    spdlog::info("Shadow rays traced: {}", m_stats.shadowRayCounter);
+    spdlog::info("Rays per second: {:.0f}", rays / std::max(m_statsTime, 1e-9));
+    spdlog::info("Sphere/Box intersection tests: {}", m_stats.aabbRayIntersectionCounter);
+    spdlog::info("Sphere/Ray intersection tests: {}", m_stats.sphereRayIntersectionCounter);
+    spdlog::info("Triangle/Ray intersection tests: {}", m_stats.triangleRayIntersectionCounter);
+    spdlog::info("Ray packets traced: {}", m_stats.rayPacketCounter);
+    spdlog::info("Traversal steps: {} | Leaf visits: {}", m_stats.traversalStepCounter, m_stats.leafVisitCounter);
+    spdlog::info("Per ray | Traversal steps: {:.2f} | Leaf visits: {:.2f} | Box tests: {:.2f} | Sphere tests: {:.2f} | Triangle tests: {:.2f}",
+        m_stats.traversalStepCounter * perRay, m_stats.leafVisitCounter * perRay, m_stats.aabbRayIntersectionCounter * perRay,
+        m_stats.sphereRayIntersectionCounter * perRay, m_stats.triangleRayIntersectionCounter * perRay);
+    spdlog::info("---------------------------");
 #endif
-}
\ No newline at end of file
+}
@@ -2,18 +2,84 @@
 
 #include "../scene/camera.hpp"
 #include "../scene/scene.hpp"
+#include "adaptive_sampler.hpp"
+#include "denoiser.hpp"
 #include "raytracer.hpp"
+#include "render_settings.hpp"
+#include "tile_scheduler.hpp"
 
 class Core {
 public: 
-	Core();
+	Core(const RenderSettings& settings = RenderSettings());
+	// Renders the given scene instead of the default one, Core takes ownership of it
+	Core(const RenderSettings& settings, Scene* scene);
 	~Core();
-	void GetPixels(uchar* pixels);
+	const RenderSettings& GetSettings() const { return m_settings; }
+
+	// For animation and editing: move primitives of GetScene() between frames (Scene::SetSphereCenter, Instance::SetTransform), then
+	// UpdateScene has the BVH follow them without a full build and restarts the accumulation
+	Scene& GetScene() { return *m_pScene; }
+	void UpdateScene();
+
+	// Renders one frame of GetSettings().width x height into 8-bit RGBA pixels, and into linear float RGB as well when hdrPixels is given.
+	// With adaptiveSampling every pixel takes as many samples as its variance asks for, within the same total budget.
+	// With denoise the image (hdrPixels too) is filtered before it is returned
+	void GetPixels(uchar* pixels, float* hdrPixels = nullptr);
+	// Samples taken by the last GetPixels, and the per-pixel sample counts as a heatmap (adaptive sampling only, returns false otherwise)
+	long long GetLastSampleCount() const { return m_lastSampleCount; }
+	bool GetSampleCountHeatmap(uchar* pixels) const;
+	// Box and primitive tests per sample of every pixel, from blue (none) to red (the costliest 1%), for finding the hot spots of the BVH.
+	// Covers the last GetPixels or the accumulated passes. Needs STATS_LEVEL 2, returns false otherwise
+	bool GetTraversalCostHeatmap(uchar* pixels) const;
+
+	// Progressive rendering: every pass adds samplesPerPass samples per pixel to a float accumulation buffer and writes the running average.
+	// Returns false without rendering once samplesPerPixel samples are accumulated or the time budget is used up
+	bool RenderPass(uchar* pixels, float* hdrPixels = nullptr);
+	// Also lifts a Cancel
+	void ResetAccumulation();
+	bool IsAccumulationDone() const;
+	int GetAccumulatedSamples() const { return m_accumulatedSamples; }
+
+	// Can be called from another thread: the pass in flight stops early, is not counted and leaves its pixels partly written.
+	// Passes and GetPixels return right away until the next ResetAccumulation, so a cancel that comes between passes is not lost
+	void Cancel();
 
 private:
+	RenderSettings m_settings;
 	Camera* m_pMainCamera = nullptr;
 	Scene* m_pScene = nullptr;
 	RayTracer* m_pRayTracer = nullptr;
+	TileScheduler* m_pTileScheduler = nullptr;
+	AdaptiveSampler* m_pAdaptiveSampler = nullptr;
+	Denoiser* m_pDenoiser = nullptr;
+	uint m_frameIndex;
+	long long m_lastSampleCount = 0;
+
+	vector<PixelFeatures> m_features;
+	vector<float> m_denoiseBuffer;
+
+	vector<float> m_accumulation;
+	int m_accumulatedSamples = 0;
+	double m_accumulationTime = 0.0;
+
+#ifdef STATS
+	Stats m_stats;
+	// Seconds spent tracing the rays m_stats counted
+	double m_statsTime = 0.0;
+#endif
+#ifdef STATS_PIXEL_COST
+	vector<float> m_pixelCost;
+	// Samples every pixel took for m_pixelCost, 0 when adaptive sampling gave each pixel its own count
+	int m_pixelCostSamples = 0;
+#endif
 
-	void InitializeCore();
-};
\ No newline at end of file
+	// Builds the BVH unless one is given, which the ray tracer then owns
+	void InitializeCore(Scene* scene, LinearBVH* bvh = nullptr);
+	// Traces samples [firstSample, firstSample + sampleCount) of every pixel, writePixel(x, y, sum) receives the sum of those samples.
+	// features (one per pixel) is filled for the denoiser when given
+	void RenderSamples(int firstSample, int sampleCount, const std::function<void(int, int, const Color&)>& writePixel, PixelFeatures* features = nullptr);
+	void RenderAdaptive(uchar* pixels, float* hdrPixels, PixelFeatures* features);
+	void RenderTilePackets(const Tile& tile, int firstSample, int sampleCount, const std::function<void(int, int, const Color&)>& writePixel, PixelFeatures* features);
+	void ClearAccumulation();
+	void LogStats();
+};
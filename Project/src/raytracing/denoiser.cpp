@@ -0,0 +1,263 @@
+#include "denoiser.hpp"
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// 1D B3-spline, the 5x5 kernel is its outer product
+static constexpr float KERNEL[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+// Edge-stopping strengths, as 1 / sigma^2. Depth is compared relative to the center pixel's depth
+static constexpr float NORMAL_WEIGHT = 1.0f / (0.3f * 0.3f);
+static constexpr float ALBEDO_WEIGHT = 1.0f / (0.1f * 0.1f);
+static constexpr float DEPTH_SIGMA = 0.05f;
+static constexpr float MIN_DEPTH = 1e-3f;
+
+// e^-x for x >= 0 as 2^-y with y = x * log2(e): the integer part of y goes straight into the exponent bits and a cubic
+// through 2^0 and 2^-1 covers the fraction. Within 0.2%, which is plenty for filter weights, and cheap to do 4-wide
+static constexpr float LOG2E = 1.44269504f;
+static constexpr float EXP_C1 = -0.693147f;
+static constexpr float EXP_C2 = 0.240227f;
+static constexpr float EXP_C3 = -0.04708f;
+static constexpr float MAX_EXPONENT = 126.0f;
+
+static inline float ExpNegative(float x) {
+	float y = std::min(x * LOG2E, MAX_EXPONENT);
+	int whole = (int)y;
+	float fraction = y - (float)whole;
+	float power = 1.0f + fraction * (EXP_C1 + fraction * (EXP_C2 + fraction * EXP_C3));
+
+	int bits = (127 - whole) << 23;
+	float scale;
+	std::memcpy(&scale, &bits, sizeof(float));
+	return power * scale;
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+static inline __m128 ExpNegative(__m128 x) {
+	__m128 y = _mm_min_ps(_mm_mul_ps(x, _mm_set1_ps(LOG2E)), _mm_set1_ps(MAX_EXPONENT));
+	__m128i whole = _mm_cvttps_epi32(y);
+	__m128 fraction = _mm_sub_ps(y, _mm_cvtepi32_ps(whole));
+	__m128 power = _mm_add_ps(_mm_set1_ps(EXP_C2), _mm_mul_ps(fraction, _mm_set1_ps(EXP_C3)));
+	power = _mm_add_ps(_mm_set1_ps(EXP_C1), _mm_mul_ps(fraction, power));
+	power = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(fraction, power));
+
+	__m128i bits = _mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(127), whole), 23);
+	return _mm_mul_ps(power, _mm_castsi128_ps(bits));
+}
+
+static inline __m128 Square(__m128 x) {
+	return _mm_mul_ps(x, x);
+}
+#endif
+
+Denoiser::Denoiser(const RenderSettings& settings) :
+	m_width(settings.width), m_height(settings.height), m_iterations(settings.denoiseIterations), m_colorSigma(settings.denoiseColorSigma) {
+	m_border = m_iterations > 0 ? 2 << (m_iterations - 1) : 0;
+	m_stride = m_width + 2 * m_border;
+
+	size_t planeSize = (size_t)m_stride * (m_height + 2 * m_border);
+	for (int i = 0; i < 2; i++) {
+		for (vector<float>& plane : m_color[i]) {
+			plane.resize(planeSize, 0.0f);
+		}
+	}
+	for (vector<float>& plane : m_features) {
+		plane.resize(planeSize, 0.0f);
+	}
+}
+
+void Denoiser::Denoise(float* color, const PixelFeatures* features, TileScheduler& scheduler) {
+	PROFILE_SCOPE("Denoise");
+
+	if (m_iterations <= 0) {
+		return;
+	}
+
+	for (int y = 0; y < m_height; y++) {
+		for (int x = 0; x < m_width; x++) {
+			int pixel = y * m_width + x;
+			int index = GetPaddedIndex(x, y);
+			for (int c = 0; c < 3; c++) {
+				m_color[0][c][index] = color[pixel * 3 + c];
+			}
+
+			const PixelFeatures& feature = features[pixel];
+			m_features[ALBEDO_R][index] = feature.albedo.x;
+			m_features[ALBEDO_G][index] = feature.albedo.y;
+			m_features[ALBEDO_B][index] = feature.albedo.z;
+			m_features[NORMAL_X][index] = feature.normal.x;
+			m_features[NORMAL_Y][index] = feature.normal.y;
+			m_features[NORMAL_Z][index] = feature.normal.z;
+			m_features[DEPTH][index] = feature.depth;
+		}
+	}
+
+	for (vector<float>& plane : m_color[0]) {
+		FillBorder(plane);
+	}
+	for (vector<float>& plane : m_features) {
+		FillBorder(plane);
+	}
+
+	int source = 0;
+	for (int i = 0; i < m_iterations; i++) {
+		// The color sigma halves every iteration, wider taps have to be more alike to be mixed in
+		int step = 1 << i;
+		float colorWeight = (float)(1 << (2 * i)) / (m_colorSigma * m_colorSigma);
+		scheduler.Run(m_width, m_height, [&](const Tile& tile, int /*threadIndex*/) {
+			FilterTile(tile, step, colorWeight, source);
+		});
+
+		source = 1 - source;
+		for (vector<float>& plane : m_color[source]) {
+			FillBorder(plane);
+		}
+	}
+
+	for (int y = 0; y < m_height; y++) {
+		for (int x = 0; x < m_width; x++) {
+			int pixel = y * m_width + x;
+			int index = GetPaddedIndex(x, y);
+			for (int c = 0; c < 3; c++) {
+				color[pixel * 3 + c] = m_color[source][c][index];
+			}
+		}
+	}
+}
+
+void Denoiser::FillBorder(vector<float>& plane) {
+	for (int y = 0; y < m_height; y++) {
+		float* row = &plane[GetPaddedIndex(0, y)];
+		std::fill(row - m_border, row, row[0]);
+		std::fill(row + m_width, row + m_width + m_border, row[m_width - 1]);
+	}
+
+	const float* firstRow = &plane[GetPaddedIndex(-m_border, 0)];
+	const float* lastRow = &plane[GetPaddedIndex(-m_border, m_height - 1)];
+	for (int y = 1; y <= m_border; y++) {
+		std::copy(firstRow, firstRow + m_stride, &plane[GetPaddedIndex(-m_border, -y)]);
+		std::copy(lastRow, lastRow + m_stride, &plane[GetPaddedIndex(-m_border, m_height - 1 + y)]);
+	}
+}
+
+void Denoiser::FilterTile(const Tile& tile, int step, float colorWeight, int source) {
+#if defined(__SSE2__) || defined(_M_X64)
+	const float* color[3] = { m_color[source][0].data(), m_color[source][1].data(), m_color[source][2].data() };
+	float* colorOut[3] = { m_color[1 - source][0].data(), m_color[1 - source][1].data(), m_color[1 - source][2].data() };
+	const float* feature[CHANNEL_COUNT];
+	for (int c = 0; c < CHANNEL_COUNT; c++) {
+		feature[c] = m_features[c].data();
+	}
+#endif
+
+	for (int y = tile.y0; y < tile.y1; y++) {
+		int x = tile.x0;
+#if defined(__SSE2__) || defined(_M_X64)
+		for (; x + 4 <= tile.x1; x += 4) {
+			int center = GetPaddedIndex(x, y);
+			__m128 centerColor[3];
+			for (int c = 0; c < 3; c++) {
+				centerColor[c] = _mm_loadu_ps(color[c] + center);
+			}
+			__m128 centerFeature[DEPTH];
+			for (int c = 0; c < DEPTH; c++) {
+				centerFeature[c] = _mm_loadu_ps(feature[c] + center);
+			}
+			__m128 centerDepth = _mm_loadu_ps(feature[DEPTH] + center);
+			__m128 inverseDepth = _mm_div_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(DEPTH_SIGMA), _mm_max_ps(centerDepth, _mm_set1_ps(MIN_DEPTH))));
+
+			__m128 sum[3] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+			__m128 weightSum = _mm_setzero_ps();
+			for (int ky = 0; ky < 5; ky++) {
+				for (int kx = 0; kx < 5; kx++) {
+					int tap = center + ((ky - 2) * m_stride + (kx - 2)) * step;
+
+					__m128 tapColor[3];
+					__m128 colorDistance = _mm_setzero_ps();
+					for (int c = 0; c < 3; c++) {
+						tapColor[c] = _mm_loadu_ps(color[c] + tap);
+						colorDistance = _mm_add_ps(colorDistance, Square(_mm_sub_ps(tapColor[c], centerColor[c])));
+					}
+
+					__m128 albedoDistance = _mm_setzero_ps();
+					for (int c = ALBEDO_R; c <= ALBEDO_B; c++) {
+						albedoDistance = _mm_add_ps(albedoDistance, Square(_mm_sub_ps(_mm_loadu_ps(feature[c] + tap), centerFeature[c])));
+					}
+
+					__m128 normalDistance = _mm_setzero_ps();
+					for (int c = NORMAL_X; c <= NORMAL_Z; c++) {
+						normalDistance = _mm_add_ps(normalDistance, Square(_mm_sub_ps(_mm_loadu_ps(feature[c] + tap), centerFeature[c])));
+					}
+
+					__m128 depthDistance = Square(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(feature[DEPTH] + tap), centerDepth), inverseDepth));
+
+					__m128 exponent = _mm_mul_ps(colorDistance, _mm_set1_ps(colorWeight));
+					exponent = _mm_add_ps(exponent, _mm_mul_ps(albedoDistance, _mm_set1_ps(ALBEDO_WEIGHT)));
+					exponent = _mm_add_ps(exponent, _mm_mul_ps(normalDistance, _mm_set1_ps(NORMAL_WEIGHT)));
+					exponent = _mm_add_ps(exponent, depthDistance);
+
+					__m128 weight = _mm_mul_ps(_mm_set1_ps(KERNEL[kx] * KERNEL[ky]), ExpNegative(exponent));
+					for (int c = 0; c < 3; c++) {
+						sum[c] = _mm_add_ps(sum[c], _mm_mul_ps(weight, tapColor[c]));
+					}
+					weightSum = _mm_add_ps(weightSum, weight);
+				}
+			}
+
+			// The center tap always has weight, so the sum is never zero
+			for (int c = 0; c < 3; c++) {
+				_mm_storeu_ps(colorOut[c] + center, _mm_div_ps(sum[c], weightSum));
+			}
+		}
+#endif
+		for (; x < tile.x1; x++) {
+			FilterPixel(x, y, step, colorWeight, source);
+		}
+	}
+}
+
+void Denoiser::FilterPixel(int x, int y, int step, float colorWeight, int source) {
+	const vector<float>* color = m_color[source];
+	int center = GetPaddedIndex(x, y);
+	float centerDepth = m_features[DEPTH][center];
+	float inverseDepth = 1.0f / (DEPTH_SIGMA * std::max(centerDepth, MIN_DEPTH));
+
+	float sum[3] = { 0.0f, 0.0f, 0.0f };
+	float weightSum = 0.0f;
+	for (int ky = 0; ky < 5; ky++) {
+		for (int kx = 0; kx < 5; kx++) {
+			int tap = center + ((ky - 2) * m_stride + (kx - 2)) * step;
+
+			float colorDistance = 0.0f;
+			for (int c = 0; c < 3; c++) {
+				float difference = color[c][tap] - color[c][center];
+				colorDistance += difference * difference;
+			}
+
+			float albedoDistance = 0.0f;
+			for (int c = ALBEDO_R; c <= ALBEDO_B; c++) {
+				float difference = m_features[c][tap] - m_features[c][center];
+				albedoDistance += difference * difference;
+			}
+
+			float normalDistance = 0.0f;
+			for (int c = NORMAL_X; c <= NORMAL_Z; c++) {
+				float difference = m_features[c][tap] - m_features[c][center];
+				normalDistance += difference * difference;
+			}
+
+			float depthDifference = (m_features[DEPTH][tap] - centerDepth) * inverseDepth;
+
+			float exponent = colorDistance * colorWeight + albedoDistance * ALBEDO_WEIGHT + normalDistance * NORMAL_WEIGHT + depthDifference * depthDifference;
+			float weight = KERNEL[kx] * KERNEL[ky] * ExpNegative(exponent);
+			for (int c = 0; c < 3; c++) {
+				sum[c] += weight * color[c][tap];
+			}
+			weightSum += weight;
+		}
+	}
+
+	for (int c = 0; c < 3; c++) {
+		m_color[1 - source][c][center] = sum[c] / weightSum;
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "pixel_features.hpp"
+#include "render_settings.hpp"
+#include "tile_scheduler.hpp"
+
+// Edge-avoiding a-trous wavelet filter (Dammertz et al. 2010). Every iteration blurs with a 5x5 B3-spline kernel whose taps
+// are twice as far apart as in the previous one, and drops taps whose color, normal, albedo or depth differ from the center pixel.
+// The image is kept per channel (SoA) with a replicated border, so 4 neighbouring pixels are filtered with one SSE instruction
+class Denoiser {
+public:
+	Denoiser(const RenderSettings& settings);
+
+	// Filters linear RGB (3 floats per pixel, as written by WriteColor) in place, the tiles are spread over the scheduler's workers
+	void Denoise(float* color, const PixelFeatures* features, TileScheduler& scheduler);
+
+private:
+	// Channels of a padded plane: color (ping-pong), albedo, normal and depth
+	enum Channel { ALBEDO_R, ALBEDO_G, ALBEDO_B, NORMAL_X, NORMAL_Y, NORMAL_Z, DEPTH, CHANNEL_COUNT };
+
+	int m_width;
+	int m_height;
+	int m_iterations;
+	float m_colorSigma;
+
+	// Taps reach 2 * 2^(iterations - 1) pixels away, the border holds copies of the edge pixels so they never need bounds checks
+	int m_border;
+	int m_stride;
+	vector<float> m_color[2][3];
+	vector<float> m_features[CHANNEL_COUNT];
+
+	int GetPaddedIndex(int x, int y) const { return (y + m_border) * m_stride + x + m_border; }
+	void FillBorder(vector<float>& plane);
+	void FilterTile(const Tile& tile, int step, float colorWeight, int source);
+	void FilterPixel(int x, int y, int step, float colorWeight, int source);
+};
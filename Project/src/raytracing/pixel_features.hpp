@@ -0,0 +1,9 @@
+#pragma once
+
+// Noise-free surface data of a pixel, averaged over its samples, that guides the denoiser. Rays that miss the scene
+// get the background color as albedo, a zero normal and depth 0
+struct PixelFeatures {
+	float3 albedo = float3(0.0f);
+	float3 normal = float3(0.0f);
+	float depth = 0.0f;
+};
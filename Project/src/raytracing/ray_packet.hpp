@@ -0,0 +1,80 @@
+#pragma once
+#include "ray.hpp"
+
+// Up to 16 coherent rays stored per component (SoA), so 4 lanes at a time fit an SSE register.
+// Lanes beyond size are padding and never set in activeMask.
+struct alignas(32) RayPacket {
+	static constexpr int MAX_SIZE = 16;
+
+	float originX[MAX_SIZE], originY[MAX_SIZE], originZ[MAX_SIZE];
+	float directionX[MAX_SIZE], directionY[MAX_SIZE], directionZ[MAX_SIZE];
+	float inverseDirectionX[MAX_SIZE], inverseDirectionY[MAX_SIZE], inverseDirectionZ[MAX_SIZE];
+	float tMax[MAX_SIZE]; // closest hit found so far per lane
+	float tMin = 0.0f;
+
+	int size = 0;
+	int activeMask = 0;
+
+	void Reset(int raySize, float rayMin = 0.0f, float rayMax = INFINITY);
+	void SetRay(int lane, const Ray& ray);
+	Ray GetRay(int lane) const;
+
+	// True if all active rays have the same direction signs, so they agree on the near-to-far child order
+	bool HasCoherentDirections() const;
+
+	// Pixel block traced as one packet, 2x2 for 4 rays, 4x2 for 8 rays and 4x4 for 16 rays
+	static int2 GetBlockSize(int packetSize);
+};
+
+inline void RayPacket::Reset(int raySize, float rayMin, float rayMax) {
+	size = raySize;
+	activeMask = (1 << raySize) - 1;
+	tMin = rayMin;
+	for (int lane = 0; lane < MAX_SIZE; lane++) {
+		originX[lane] = originY[lane] = originZ[lane] = 0.0f;
+		directionX[lane] = directionY[lane] = directionZ[lane] = 1.0f;
+		inverseDirectionX[lane] = inverseDirectionY[lane] = inverseDirectionZ[lane] = 1.0f;
+		tMax[lane] = lane < raySize ? rayMax : -INFINITY;
+	}
+}
+
+inline void RayPacket::SetRay(int lane, const Ray& ray) {
+	originX[lane] = ray.origin.x;
+	originY[lane] = ray.origin.y;
+	originZ[lane] = ray.origin.z;
+	directionX[lane] = ray.direction.x;
+	directionY[lane] = ray.direction.y;
+	directionZ[lane] = ray.direction.z;
+	inverseDirectionX[lane] = 1.0f / ray.direction.x;
+	inverseDirectionY[lane] = 1.0f / ray.direction.y;
+	inverseDirectionZ[lane] = 1.0f / ray.direction.z;
+}
+
+inline Ray RayPacket::GetRay(int lane) const {
+	return Ray(float3(originX[lane], originY[lane], originZ[lane]), float3(directionX[lane], directionY[lane], directionZ[lane]));
+}
+
+inline bool RayPacket::HasCoherentDirections() const {
+	int first = -1;
+	for (int lane = 0; lane < size; lane++) {
+		if ((activeMask & (1 << lane)) == 0) {
+			continue;
+		}
+
+		if (first == -1) {
+			first = lane;
+		}
+		else if ((inverseDirectionX[lane] < 0) != (inverseDirectionX[first] < 0) ||
+			(inverseDirectionY[lane] < 0) != (inverseDirectionY[first] < 0) ||
+			(inverseDirectionZ[lane] < 0) != (inverseDirectionZ[first] < 0)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+inline int2 RayPacket::GetBlockSize(int packetSize) {
+	if (packetSize >= 16) return int2(4, 4);
+	if (packetSize >= 8) return int2(4, 2);
+	return int2(2, 2);
+}
@@ -1,54 +1,258 @@
 #include "raytracer.hpp"
+#include "../utils/parallel.hpp"
 
-RayTracer::RayTracer(int spp) : m_samplesPerPixel(spp) { 
-    m_samplesPerPixelScale = 1.0f / spp;
+RayTracer::RayTracer(const RenderSettings& settings) :
+    m_samplesPerPixel(settings.samplesPerPixel), m_maxRayDepth(settings.maxRayDepth) {
+    m_samplesPerPixelScale = 1.0f / m_samplesPerPixel;
+    m_pSampler = Sampler::Create(settings.sampler, settings.width, settings.samplesPerPixel);
 }
 
 RayTracer::~RayTracer() {
-    delete m_pBVHTree;
+    delete m_pSampler;
+    delete m_pBVH;
+#if BVH_WIDTH == 4 || BVH_WIDTH == 8
+    delete m_pWideBVH;
+#endif
 }
 
-Color RayTracer::GetPixelColor(int x, int y, Camera& camera, const Scene& scene) {
+Color RayTracer::GetPixelColor(int x, int y, Camera& camera, const Scene& scene, uint frame) {
+    Color color = GetPixelSamples(x, y, 0, m_samplesPerPixel, camera, scene, frame);
+    color *= m_samplesPerPixelScale;
+    return color;
+}
+
+Color RayTracer::GetPixelSamples(int x, int y, int firstSample, int sampleCount, Camera& camera, const Scene& scene, uint frame, PixelFeatures* features) {
     Color color = COLOR_BLACK;
+    if (features != nullptr) {
+        *features = PixelFeatures();
+    }
     
-    for (int i = 0; i < m_samplesPerPixel; i++) 
+    for (int i = firstSample; i < firstSample + sampleCount; i++) 
     {
-        float offsetX = GetRandomFloat() - 0.5f;
-        float offsetY = GetRandomFloat() - 0.5f;
+        float2 jitter = m_pSampler->Get2D(x, y, i, Sampler::PIXEL_JITTER, frame);
+        float offsetX = jitter.x - 0.5f;
+        float offsetY = jitter.y - 0.5f;
         Ray primaryRay = camera.GeneratePrimaryRay(x + offsetX, y + offsetY);
-        color += TraceRay(primaryRay, scene);
+        color += TraceRay(primaryRay, scene, features);
+    }
+
+    if (features != nullptr) {
+        float scale = 1.0f / sampleCount;
+        features->albedo *= scale;
+        features->normal *= scale;
+        features->depth *= scale;
     }
 
-    color *= m_samplesPerPixelScale;
     return color;
 }
 
-void RayTracer::BuildBVH(const Scene& scene)
+void RayTracer::BuildBVH(const Scene& scene, const BVHBuildSettings& settings)
 {
+    PROFILE_SCOPE("Build BVH");
     auto start = std::chrono::steady_clock::now();
     auto objectsCopy = scene.GetObjectsCopy();
-    m_pBVHTree = new BVHNode(objectsCopy, 0, objectsCopy.size());
+
+    delete m_pBVH;
+#if BVH_WIDTH == 4 || BVH_WIDTH == 8
+    delete m_pWideBVH;
+#endif
+
+    string builderName = fmt::format("SAH ({} threads)", ResolveThreadCount(settings.threadCount));
+    if (settings.builder == BVHBuilder::SAH) {
+        SAHBuilder builder(settings);
+        m_pBVH = builder.Build(objectsCopy);
+    }
+    else {
+        // The BVHNode tree is only the build front end, traversal uses the flattened copy
+        builderName = "Median";
+        BVHNode root(objectsCopy, 0, objectsCopy.size());
+        m_pBVH = new LinearBVH(root);
+    }
+    m_pBVH->GatherSphereData(scene.GetSphereData());
+    m_pBVH->GatherTriangleData();
+
+#if BVH_WIDTH == 4 || BVH_WIDTH == 8
+    // Traversal uses the wide tree, collapsed from the binary one
+    m_pWideBVH = new WideBVH<BVH_WIDTH>(*m_pBVH);
+#endif
+
     auto end = std::chrono::steady_clock::now();
     std::chrono::duration<double> duration = end - start;
-    spdlog::info("Timer | Build BVH: {}", duration.count());
+    float sahCost = m_pBVH->ComputeSAHCost(settings.traversalCost, settings.intersectionCost);
+    spdlog::info("Timer | Build BVH: {} | Builder: {} | Nodes: {} | SAH cost: {}", duration.count(), builderName, m_pBVH->GetNodeCount(), sahCost);
+
+    m_builtCost = sahCost;
+    m_builtSubtreeCosts.clear();
+    for (int subtreeRoot : m_pBVH->GetSubtreeRoots(REFIT_SUBTREE_DEPTH)) {
+        m_builtSubtreeCosts.push_back(m_pBVH->ComputeSAHCost(settings.traversalCost, settings.intersectionCost, subtreeRoot));
+    }
 }
 
-Color RayTracer::TraceRay(Ray& primaryRay, const Scene& scene) {
-    Color color = COLOR_BLACK;
+void RayTracer::UpdateBVH(const Scene& scene, const BVHBuildSettings& settings)
+{
+    if (m_pBVH == nullptr) {
+        BuildBVH(scene, settings);
+        return;
+    }
+    if (m_pBVH->IsMapped()) {
+        spdlog::error("A BVH loaded from a scene cache cannot be updated");
+        return;
+    }
+
+    PROFILE_SCOPE("Update BVH");
+    auto start = std::chrono::steady_clock::now();
+    m_pBVH->Refit(settings.threadCount);
+
+    // The levels above the subtrees are only refit, they are few and the total cost catches them degrading
+    vector<int> subtreeRoots = m_pBVH->GetSubtreeRoots(REFIT_SUBTREE_DEPTH);
+    vector<int> degraded;
+    for (int i = 0; i < (int)subtreeRoots.size(); i++) {
+        float cost = m_pBVH->ComputeSAHCost(settings.traversalCost, settings.intersectionCost, subtreeRoots[i]);
+        if (cost > settings.rebuildCostGrowth * m_builtSubtreeCosts[i]) {
+            degraded.push_back(i);
+        }
+    }
+
+    // Rebuilding most of the tree in pieces costs about as much as a full build, which also gets a new top
+    if (2 * degraded.size() > subtreeRoots.size()) {
+        spdlog::info("Update BVH | Subtrees degraded: {} of {} | Full rebuild", degraded.size(), subtreeRoots.size());
+        BuildBVH(scene, settings);
+        return;
+    }
+
+    // Back to front, so replacing a subtree leaves the node indices of the ones before it as they were
+    SAHBuilder builder(settings);
+    for (auto it = degraded.rbegin(); it != degraded.rend(); ++it) {
+        LinearBVH* subtree = builder.Build(m_pBVH->GetSubtreePrimitives(subtreeRoots[*it]), REFIT_SUBTREE_DEPTH);
+        m_pBVH->ReplaceSubtree(subtreeRoots[*it], *subtree);
+        delete subtree;
+    }
+
+    if (!degraded.empty()) {
+        m_pBVH->GatherSphereData(scene.GetSphereData());
+        m_pBVH->GatherTriangleData();
+        subtreeRoots = m_pBVH->GetSubtreeRoots(REFIT_SUBTREE_DEPTH);
+        for (int i : degraded) {
+            m_builtSubtreeCosts[i] = m_pBVH->ComputeSAHCost(settings.traversalCost, settings.intersectionCost, subtreeRoots[i]);
+        }
+    }
+
+    float sahCost = m_pBVH->ComputeSAHCost(settings.traversalCost, settings.intersectionCost);
+    if (sahCost > settings.rebuildCostGrowth * m_builtCost) {
+        spdlog::info("Update BVH | SAH cost: {} of {} when built | Full rebuild", sahCost, m_builtCost);
+        BuildBVH(scene, settings);
+        return;
+    }
+
+#if BVH_WIDTH == 4 || BVH_WIDTH == 8
+    delete m_pWideBVH;
+    m_pWideBVH = new WideBVH<BVH_WIDTH>(*m_pBVH);
+#endif
+
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> duration = end - start;
+    spdlog::info("Timer | Update BVH: {} | Rebuilt subtrees: {} of {} | SAH cost: {}", duration.count(), degraded.size(), subtreeRoots.size(), sahCost);
+}
+
+void RayTracer::SetBVH(LinearBVH* bvh)
+{
+    delete m_pBVH;
+    m_pBVH = bvh;
+    m_builtCost = 0.0f;
+    m_builtSubtreeCosts.clear();
+#if BVH_WIDTH == 4 || BVH_WIDTH == 8
+    delete m_pWideBVH;
+    m_pWideBVH = new WideBVH<BVH_WIDTH>(*m_pBVH);
+#endif
+}
+
+void RayTracer::GetBlockColors(int x0, int y0, int width, int height, Camera& camera, const Scene& scene, uint frame, Color* colors) {
+    GetBlockSamples(x0, y0, width, height, 0, m_samplesPerPixel, camera, scene, frame, colors);
+    for (int lane = 0; lane < width * height; lane++) {
+        colors[lane] *= m_samplesPerPixelScale;
+    }
+}
+
+void RayTracer::GetBlockSamples(int x0, int y0, int width, int height, int firstSample, int sampleCount, Camera& camera, const Scene& scene, uint frame, Color* colors,
+    PixelFeatures* features) {
+    int rayCount = width * height;
+    for (int lane = 0; lane < rayCount; lane++) {
+        colors[lane] = COLOR_BLACK;
+        if (features != nullptr) {
+            features[lane] = PixelFeatures();
+        }
+    }
+
+    // Same jitter as GetPixelSamples, only the primary rays of a sample are traced together
+    for (int i = firstSample; i < firstSample + sampleCount; i++) {
+        RayPacket packet;
+        packet.Reset(rayCount);
+
+        for (int lane = 0; lane < rayCount; lane++) {
+            int x = x0 + lane % width;
+            int y = y0 + lane / width;
+            float2 jitter = m_pSampler->Get2D(x, y, i, Sampler::PIXEL_JITTER, frame);
+            float offsetX = jitter.x - 0.5f;
+            float offsetY = jitter.y - 0.5f;
+            packet.SetRay(lane, camera.GeneratePrimaryRay(x + offsetX, y + offsetY));
+        }
+
+        IntersectionPoint intersectionPoints[RayPacket::MAX_SIZE];
+#if BVH
+        m_pBVH->HitPacket(packet, intersectionPoints);
+#else
+        for (const std::shared_ptr<Primitive>& object : scene.GetObjects()) {
+            object->HitPacket(packet, packet.activeMask, intersectionPoints);
+        }
+#endif
+
+        for (int lane = 0; lane < rayCount; lane++) {
+            colors[lane] += Shade(packet.GetRay(lane), intersectionPoints[lane], scene);
+            if (features != nullptr) {
+                AddFeatures(packet.GetRay(lane), intersectionPoints[lane], scene, features[lane]);
+            }
+        }
+    }
+
+    for (int lane = 0; lane < rayCount && features != nullptr; lane++) {
+        float scale = 1.0f / sampleCount;
+        features[lane].albedo *= scale;
+        features[lane].normal *= scale;
+        features[lane].depth *= scale;
+    }
+}
+
+Color RayTracer::TraceRay(Ray& primaryRay, const Scene& scene, PixelFeatures* features) {
     Interval defaultRayLength = Interval(0, INFINITY);
 
     // Find the closest object
     IntersectionPoint nearestIntersectionPoint; 
     
     IntersectionPoint tmpIntersectionPoint;
-    auto& objects = scene.GetObjects();
 
 #if BVH
-    bool hit = m_pBVHTree->Hit(primaryRay, defaultRayLength, tmpIntersectionPoint);
+    bool hit = HitBVH(primaryRay, defaultRayLength, tmpIntersectionPoint);
     if (hit && tmpIntersectionPoint.t < nearestIntersectionPoint.t) {
         nearestIntersectionPoint = tmpIntersectionPoint;
     }
 #else
+    auto& objects = scene.GetObjects();
+
+    // Scenes of only spheres are tested with the SIMD kernel, anything else goes through the objects
+    const SphereSoA& spheres = scene.GetSphereData();
+    if (spheres.Size() == (int)objects.size()) {
+        float closest = defaultRayLength.max;
+        int sphere = spheres.IntersectClosest(0, spheres.Size(), primaryRay, defaultRayLength.min, closest);
+        if (sphere >= 0) {
+            nearestIntersectionPoint.t = closest;
+            spheres.SetHit(sphere, primaryRay, nearestIntersectionPoint);
+        }
+        if (features != nullptr) {
+            AddFeatures(primaryRay, nearestIntersectionPoint, scene, *features);
+        }
+        return Shade(primaryRay, nearestIntersectionPoint, scene);
+    }
+
     for (int i = 0; i < objects.size(); i++) {
         std::shared_ptr<GeometricObject> object = objects[i];
         bool hit = object->Hit(primaryRay, defaultRayLength, tmpIntersectionPoint);
@@ -58,31 +262,57 @@ Color RayTracer::TraceRay(Ray& primaryRay, const Scene& scene) {
     }
 #endif 
 
+    if (features != nullptr) {
+        AddFeatures(primaryRay, nearestIntersectionPoint, scene, *features);
+    }
+    return Shade(primaryRay, nearestIntersectionPoint, scene);
+}
+
+void RayTracer::AddFeatures(const Ray& primaryRay, const IntersectionPoint& nearestIntersectionPoint, const Scene& scene, PixelFeatures& features) {
+    if (nearestIntersectionPoint.objectID == -1) {
+        features.albedo += GetBackgroundColor(primaryRay).rgb;
+        return;
+    }
+
+    features.albedo += scene.GetAlbedo(nearestIntersectionPoint.objectID).rgb;
+    features.normal += nearestIntersectionPoint.normal;
+    features.depth += nearestIntersectionPoint.t;
+}
+
+Color RayTracer::Shade(const Ray& primaryRay, const IntersectionPoint& nearestIntersectionPoint, const Scene& scene) {
+    Color color = COLOR_BLACK;
+
     // Cast the shadow rays
     if (nearestIntersectionPoint.objectID != -1) {
-       
-        // Reset
-        tmpIntersectionPoint.t = INFINITY;
-        
         auto& lights = scene.GetLights();
         for (Light* light : lights) {
-            Ray shadowRay(nearestIntersectionPoint.point + OFFSET * nearestIntersectionPoint.normal, normalize(light->position - nearestIntersectionPoint.point));
+            float3 toLight = light->position - nearestIntersectionPoint.point;
+            float distanceToLight = length(toLight);
+            float3 L = toLight / distanceToLight;
+            float clampedCosTheta = std::max(dot(nearestIntersectionPoint.normal, L), 0.f);
+
+            // Lights behind the surface contribute nothing, so there is no need to trace towards them
+            if (clampedCosTheta <= 0.f) {
+                continue;
+            }
+
+            // Any occluder closer than the light will do, so use the any-hit query instead of the closest hit
+            Ray shadowRay(nearestIntersectionPoint.point + OFFSET * nearestIntersectionPoint.normal, L);
+            Interval shadowRayLength = Interval(0, distanceToLight);
             bool occluded = false;
-            float distanceToLight = length(light->position - nearestIntersectionPoint.point);
+#ifdef STATS
+            stats->shadowRayCounter += m_maxRayDepth > 0 ? 1 : 0;
+#endif
 #if BVH
-            bool hit = m_pBVHTree->Hit(shadowRay, defaultRayLength, tmpIntersectionPoint);
-            if (hit && nearestIntersectionPoint.objectID != tmpIntersectionPoint.objectID && tmpIntersectionPoint.t < distanceToLight) {
-                nearestIntersectionPoint = tmpIntersectionPoint;
-            }
+            occluded = m_maxRayDepth > 0 && OccludedBVH(shadowRay, shadowRayLength);
 #else
-            for (int i = 0; i < objects.size(); i++) {
+            auto& objects = scene.GetObjects();
+            for (int i = 0; i < objects.size() && m_maxRayDepth > 0; i++) {
                 if (i == nearestIntersectionPoint.objectID) {
                     continue;
                 }
 
-                std::shared_ptr<GeometricObject> object = objects[i];
-                bool hit = object->Hit(shadowRay, defaultRayLength, tmpIntersectionPoint);
-                if (hit && tmpIntersectionPoint.t < distanceToLight) {
+                if (objects[i]->Occluded(shadowRay, shadowRayLength)) {
                     occluded = true;
                     break;
                 }
@@ -90,10 +320,8 @@ Color RayTracer::TraceRay(Ray& primaryRay, const Scene& scene) {
 #endif
 
             if (!occluded) {
-                float3 L = normalize(light->position - nearestIntersectionPoint.point);
-                float clampedCosTheta = std::max(dot(nearestIntersectionPoint.normal, L), 0.f);
                 float attenuation = 1.0f / (distanceToLight * distanceToLight);
-                float3 diffuseColor = light->color * objects[nearestIntersectionPoint.objectID]->GetAlbedo().rgb * clampedCosTheta * attenuation;
+                float3 diffuseColor = light->color * scene.GetAlbedo(nearestIntersectionPoint.objectID).rgb * clampedCosTheta * attenuation;
                 color.rgb += diffuseColor;
             }
         }
@@ -105,6 +333,22 @@ Color RayTracer::TraceRay(Ray& primaryRay, const Scene& scene) {
     return color;
 }
 
+bool RayTracer::HitBVH(const Ray& ray, const Interval& ray_t, IntersectionPoint& intersectionPoint) const {
+#if BVH_WIDTH == 4 || BVH_WIDTH == 8
+    return m_pWideBVH->Hit(ray, ray_t, intersectionPoint);
+#else
+    return m_pBVH->Hit(ray, ray_t, intersectionPoint);
+#endif
+}
+
+bool RayTracer::OccludedBVH(const Ray& ray, const Interval& ray_t) const {
+#if BVH_WIDTH == 4 || BVH_WIDTH == 8
+    return m_pWideBVH->Occluded(ray, ray_t);
+#else
+    return m_pBVH->Occluded(ray, ray_t);
+#endif
+}
+
 Color RayTracer::GetBackgroundColor(const Ray& primaryRay) {
     float a = 0.5f * (primaryRay.direction.y + 1.0f); 
     return Lerp(COLOR_WHITE, COLOR_LIGHTBLUE, 1.0f - a);
@@ -2,23 +2,55 @@
 #include "../scene/scene.hpp"
 #include "../scene/camera.hpp"
 #include "ray.hpp"
-#include "acceleration_structures/bvh.hpp"
+#include "pixel_features.hpp"
+#include "ray_packet.hpp"
+#include "render_settings.hpp"
+#include "acceleration_structures/wide_bvh.hpp"
 
 class RayTracer {
 public:
-	RayTracer(int spp = 1);
+	RayTracer(const RenderSettings& settings);
 	~RayTracer();
-	void BuildBVH(const Scene& scene);
-	Color GetPixelColor(int x, int y, Camera& camera, const Scene& scene);
+	void BuildBVH(const Scene& scene, const BVHBuildSettings& settings = BVHBuildSettings());
+	// Makes the BVH follow primitives that moved since it was built (Scene::SetSphereCenter, Instance::SetTransform) in one pass over the
+	// nodes: the boxes are refit in place and only the subtrees the moves degraded past settings.rebuildCostGrowth are built again,
+	// or the whole tree when that is most of it or the top levels degraded
+	void UpdateBVH(const Scene& scene, const BVHBuildSettings& settings = BVHBuildSettings());
+	// Takes a tree built before instead of building one (SceneCache), wide builds collapse it in one pass over the nodes
+	void SetBVH(LinearBVH* bvh);
+	const LinearBVH* GetBVH() const { return m_pBVH; }
+	Color GetPixelColor(int x, int y, Camera& camera, const Scene& scene, uint frame = 0);
+	// Packet mode: traces the primary rays of a block of at most RayPacket::MAX_SIZE pixels together, colors are row-major
+	void GetBlockColors(int x0, int y0, int width, int height, Camera& camera, const Scene& scene, uint frame, Color* colors);
+
+	// Sums (not averages) of the samples [firstSample, firstSample + sampleCount) only. A sample is jittered the same way whichever
+	// call traces it, so progressive passes add up to the same image as a single full render.
+	// When features is given it receives the average denoiser features of those samples (one per pixel of the block, row-major)
+	Color GetPixelSamples(int x, int y, int firstSample, int sampleCount, Camera& camera, const Scene& scene, uint frame, PixelFeatures* features = nullptr);
+	void GetBlockSamples(int x0, int y0, int width, int height, int firstSample, int sampleCount, Camera& camera, const Scene& scene, uint frame, Color* colors,
+		PixelFeatures* features = nullptr);
 
 private:
 	int m_samplesPerPixel;
 	float m_samplesPerPixelScale;
+	int m_maxRayDepth;
+	Sampler* m_pSampler = nullptr;
 
-	BVHNode* m_pBVHTree = nullptr;
+	LinearBVH* m_pBVH = nullptr;
+#if BVH_WIDTH == 4 || BVH_WIDTH == 8
+	WideBVH<BVH_WIDTH>* m_pWideBVH = nullptr;
+#endif
+	// SAH cost of the whole tree and of its subtrees REFIT_SUBTREE_DEPTH levels down when they were last built, UpdateBVH compares against them
+	static constexpr int REFIT_SUBTREE_DEPTH = 6;
+	float m_builtCost = 0.0f;
+	vector<float> m_builtSubtreeCosts;
 
 	Color GetBackgroundColor(const Ray& ray);
-	Color TraceRay(Ray& primaryRay, const Scene& scene);
+	Color TraceRay(Ray& primaryRay, const Scene& scene, PixelFeatures* features = nullptr);
+	Color Shade(const Ray& primaryRay, const IntersectionPoint& nearestIntersectionPoint, const Scene& scene);
+	void AddFeatures(const Ray& primaryRay, const IntersectionPoint& nearestIntersectionPoint, const Scene& scene, PixelFeatures& features);
+	bool HitBVH(const Ray& ray, const Interval& ray_t, IntersectionPoint& intersectionPoint) const;
+	bool OccludedBVH(const Ray& ray, const Interval& ray_t) const;
 
 	Interval m_rayLength = Interval(0, INFINITY);
 };
\ No newline at end of file
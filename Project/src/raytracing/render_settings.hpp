@@ -0,0 +1,54 @@
+#pragma once
+#include <filesystem>
+#include "acceleration_structures/sah_builder.hpp"
+#include "sampler.hpp"
+#include "../scene/scene_generator.hpp"
+
+// Everything about a render that can change between runs without recompiling
+struct RenderSettings {
+	int width = 800;
+	int height = 600;
+	int samplesPerPixel = 8;
+
+	// Progressive rendering adds samplesPerPass samples per pass until samplesPerPixel is reached, or until timeBudget seconds
+	// of rendering have passed (0 is no budget)
+	int samplesPerPass = 1;
+	float timeBudget = 0.0f;
+
+	// Rendering is split into square tiles that are spread over the worker threads, 0 threads uses all hardware threads
+	int threadCount = 0;
+	int tileSize = 32;
+
+	// Point set the pixel jitter comes from. Renders with different seeds have independent noise
+	SamplerType sampler = SamplerType::Independent;
+	uint seed = 0;
+
+	// Ray generations traced after the primary rays. Only shadow rays exist for now, so 0 gives a quick unshadowed preview
+	int maxRayDepth = 1;
+
+	// Primary rays are traced in packets of 4 (2x2 pixels), 8 (4x2) or 16 (4x4) rays, 0 traces every ray on its own
+	int rayPacketSize = 0;
+
+	// Adaptive sampling (GetPixels only): every pixel takes adaptiveMinSamples samples per round until the 95% confidence interval of its
+	// luminance is within adaptiveThreshold of the mean, or it reaches adaptiveMaxSamples (0 is 4x samplesPerPixel).
+	// The image as a whole still spends at most samplesPerPixel samples per pixel on average, converged pixels leave theirs to noisy ones
+	bool adaptiveSampling = false;
+	float adaptiveThreshold = 0.05f;
+	int adaptiveMinSamples = 4;
+	int adaptiveMaxSamples = 0;
+
+	// Edge-avoiding a-trous filter after GetPixels, guided by the albedo, normal and depth of the primary hits. Every iteration doubles
+	// the filter radius (5 iterations reach 32 pixels away), denoiseColorSigma is how far apart colors can be and still be averaged
+	bool denoise = false;
+	int denoiseIterations = 5;
+	float denoiseColorSigma = 0.5f;
+
+	SceneSettings scene;
+	BVHBuildSettings bvhSettings;
+	// Generated sphere scenes are loaded from this file with their BVH when it was written for the same scene and BVH settings, and
+	// written to it after they are built otherwise. Empty generates and builds every time
+	std::filesystem::path sceneCache;
+
+	int GetPixelCount() const { return width * height; }
+	float GetAspectRatio() const { return (float)width / (float)height; }
+};
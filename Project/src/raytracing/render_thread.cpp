@@ -0,0 +1,184 @@
+#include "render_thread.hpp"
+
+RenderThread::RenderThread(const RenderSettings& settings) {
+	m_pendingSettings = settings;
+	m_hasPendingSettings = true;
+	m_restartRequested = true;
+	m_thread = std::thread(&RenderThread::RenderLoop, this);
+}
+
+RenderThread::~RenderThread() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopRequested = true;
+		CancelPass();
+	}
+	m_wakeUp.notify_one();
+	m_thread.join();
+
+	delete m_pCore;
+}
+
+const uchar* RenderThread::AcquireLatestPixels() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_hasNewPixels) {
+		return nullptr;
+	}
+
+	std::swap(m_readIndex, m_readyIndex);
+	m_hasNewPixels = false;
+	// The buffer the UI thread just gave back may still have the size from before a resolution change, the render thread only
+	// resizes the two it owns
+	m_buffers[m_readyIndex].resize(m_buffers[m_readIndex].size());
+	return m_buffers[m_readIndex].data();
+}
+
+int2 RenderThread::GetImageSize() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_imageSize;
+}
+
+void RenderThread::Restart() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_restartRequested = true;
+		CancelPass();
+	}
+	m_wakeUp.notify_one();
+}
+
+void RenderThread::Restart(const RenderSettings& settings) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pendingSettings = settings;
+		m_hasPendingSettings = true;
+		m_restartRequested = true;
+		CancelPass();
+	}
+	m_wakeUp.notify_one();
+}
+
+void RenderThread::Cancel() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_idle = true;
+	CancelPass();
+}
+
+bool RenderThread::IsIdle() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_idle && !m_restartRequested;
+}
+
+void RenderThread::SetAnimating(bool animating) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_animating = animating;
+		if (animating) {
+			m_idle = false;
+		}
+	}
+	m_wakeUp.notify_one();
+}
+
+bool RenderThread::IsAnimating() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_animating;
+}
+
+// Expects the mutex to be held
+void RenderThread::CancelPass() {
+	if (m_pCore != nullptr) {
+		m_pCore->Cancel();
+	}
+}
+
+void RenderThread::RenderLoop() {
+	PROFILE_THREAD_NAME("Render thread");
+
+	while (true) {
+		RenderSettings settings;
+		bool rebuild = false;
+		bool restart = false;
+		bool animating = false;
+		{
+			// Sleep while the image is done or cancelled, until a restart or shutdown
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeUp.wait(lock, [this] { return m_stopRequested || m_restartRequested || !m_idle; });
+			if (m_stopRequested) {
+				return;
+			}
+
+			if (m_restartRequested) {
+				restart = true;
+				rebuild = m_hasPendingSettings;
+				settings = m_pendingSettings;
+				m_restartRequested = false;
+				m_hasPendingSettings = false;
+				m_idle = false;
+			}
+			animating = m_animating;
+		}
+
+		if (rebuild) {
+			// Build outside the lock, the UI thread keeps presenting the old image meanwhile
+			Core* core = new Core(settings);
+			Core* oldCore = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				oldCore = m_pCore;
+				m_pCore = core;
+				// The read buffer is still the UI thread's until its next AcquireLatestPixels
+				m_buffers[m_writeIndex].assign(settings.GetPixelCount() * 4, 0);
+				m_buffers[m_readyIndex].assign(settings.GetPixelCount() * 4, 0);
+				m_imageSize = int2(settings.width, settings.height);
+				m_hasNewPixels = false;
+			}
+			delete oldCore;
+			m_restCenters.clear();
+			m_animationFrame = 0;
+		}
+		else if (restart) {
+			m_pCore->ResetAccumulation();
+		}
+
+		bool moved = animating && Animate();
+		bool rendered = m_pCore->RenderPass(m_buffers[m_writeIndex].data());
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			// A restart that came in too late to cancel this pass makes its pixels stale
+			if (rendered && !m_restartRequested) {
+				std::swap(m_writeIndex, m_readyIndex);
+				m_hasNewPixels = true;
+			}
+
+			// The next pass moves the spheres again and starts over
+			if (m_pCore->IsAccumulationDone() && !moved) {
+				m_idle = true;
+			}
+		}
+	}
+}
+
+// Moves every sphere along y by up to its radius, each with its own phase. Returns false when the scene has nothing that can move
+bool RenderThread::Animate() {
+	Scene& scene = m_pCore->GetScene();
+	const SphereSoA& spheres = scene.GetSphereData();
+	if (spheres.Size() == 0 || spheres.Size() != scene.GetObjectsCount() || spheres.IsMapped()) {
+		return false;
+	}
+
+	if (m_restCenters.empty()) {
+		for (int i = 0; i < spheres.Size(); i++) {
+			m_restCenters.push_back(spheres.GetCenter(i));
+		}
+	}
+
+	m_animationFrame++;
+	for (int i = 0; i < spheres.Size(); i++) {
+		float phase = 0.1f * m_animationFrame + 0.7f * i;
+		scene.SetSphereCenter(spheres.GetObjectID(i), m_restCenters[i] + float3(0.0f, spheres.GetRadius(i) * std::sin(phase), 0.0f));
+	}
+	m_pCore->UpdateScene();
+	return true;
+}
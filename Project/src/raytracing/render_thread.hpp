@@ -0,0 +1,61 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "core.hpp"
+
+// Runs Core's progressive passes on a background thread, so the UI thread only polls events and presents.
+// Finished passes are handed over through three pixel buffers: the render thread writes one, the newest finished pass waits in
+// the second, and the UI thread reads the third, so neither side ever waits for the other.
+class RenderThread {
+public:
+	// Building the scene and its BVH already happens on the render thread
+	RenderThread(const RenderSettings& settings);
+	~RenderThread();
+
+	// Newest pass the UI thread has not seen yet, or nullptr. The pixels stay valid until the next call, a Restart included
+	const uchar* AcquireLatestPixels();
+	int2 GetImageSize() const;
+
+	// Stops the pass in flight and starts accumulating from scratch. New settings rebuild the Core, the same settings keep the scene and BVH
+	void Restart();
+	void Restart(const RenderSettings& settings);
+	// Stops the pass in flight and keeps the last finished image, until the next Restart
+	void Cancel();
+	bool IsIdle() const;
+
+	// Keeps the spheres of the scene bobbing up and down: before every pass they move, the BVH follows (Core::UpdateScene) and the image
+	// starts over. Scenes of other primitives stay still
+	void SetAnimating(bool animating);
+	bool IsAnimating() const;
+
+private:
+	std::thread m_thread;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_wakeUp;
+
+	// Owned by the render thread, the pointer itself is swapped under the mutex so Cancel can reach the current Core
+	Core* m_pCore = nullptr;
+
+	vector<uchar> m_buffers[3];
+	int m_writeIndex = 0;
+	int m_readyIndex = 1;
+	int m_readIndex = 2;
+	bool m_hasNewPixels = false;
+	int2 m_imageSize = int2(0, 0);
+
+	RenderSettings m_pendingSettings;
+	bool m_hasPendingSettings = false;
+	bool m_restartRequested = false;
+	bool m_idle = false;
+	bool m_stopRequested = false;
+	bool m_animating = false;
+
+	// Render thread only: where the spheres of the current Core started, and how many passes they moved for
+	vector<float3> m_restCenters;
+	int m_animationFrame = 0;
+
+	void RenderLoop();
+	void CancelPass();
+	bool Animate();
+};
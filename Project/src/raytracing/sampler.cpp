@@ -0,0 +1,291 @@
+#include "sampler.hpp"
+
+// Integer hash (lowbias32), used to derive independent seeds per pixel, dimension and frame
+static uint Hash(uint x) {
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+static uint Hash(uint a, uint b) {
+	return Hash(a ^ (Hash(b) + 0x9e3779b9u + (a << 6) + (a >> 2)));
+}
+
+// Top 24 bits, so the result never rounds up to 1
+static float ToUnitFloat(uint x) {
+	return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+static uint ReverseBits(uint x) {
+	x = (x << 16) | (x >> 16);
+	x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+	x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+	x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+	x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+	return x;
+}
+
+Sampler* Sampler::Create(SamplerType type, int imageWidth, int samplesPerPixel) {
+	switch (type) {
+	case SamplerType::Stratified:
+		return new StratifiedSampler(imageWidth, samplesPerPixel);
+	case SamplerType::Sobol:
+		return new SobolSampler(imageWidth);
+	case SamplerType::BlueNoise:
+		return new BlueNoiseSampler();
+	default:
+		return new IndependentSampler(imageWidth);
+	}
+}
+
+cstring Sampler::GetName(SamplerType type) {
+	switch (type) {
+	case SamplerType::Stratified:
+		return "stratified";
+	case SamplerType::Sobol:
+		return "sobol";
+	case SamplerType::BlueNoise:
+		return "bluenoise";
+	default:
+		return "independent";
+	}
+}
+
+#pragma region Independent
+
+float2 IndependentSampler::Get2D(int x, int y, int sample, int dimension, uint frame) const {
+	// Dimension 0 takes the first two numbers of the sample's generator, as the pixel jitter always has
+	RandomGenerator random(y * m_imageWidth + x, sample, frame);
+	for (int i = 0; i < 2 * dimension; i++) {
+		random.NextUint();
+	}
+	float u = random.NextFloat();
+	float v = random.NextFloat();
+	return float2(u, v);
+}
+
+#pragma endregion
+
+#pragma region Stratified
+
+// Kensler's hash-based permutation of [0, length), different for every seed and cheap to evaluate for one index
+static uint Permute(uint index, uint length, uint seed) {
+	uint mask = length - 1;
+	mask |= mask >> 1;
+	mask |= mask >> 2;
+	mask |= mask >> 4;
+	mask |= mask >> 8;
+	mask |= mask >> 16;
+
+	// Cycle walking: values outside [0, length) are permuted again until they land inside
+	do {
+		index ^= seed;
+		index *= 0xe170893du;
+		index ^= seed >> 16;
+		index ^= (index & mask) >> 4;
+		index ^= seed >> 8;
+		index *= 0x0929eb3fu;
+		index ^= seed >> 23;
+		index ^= (index & mask) >> 1;
+		index *= 1 | seed >> 27;
+		index *= 0x6935fa69u;
+		index ^= (index & mask) >> 11;
+		index *= 0x74dcb303u;
+		index ^= (index & mask) >> 2;
+		index *= 0x9e501cc3u;
+		index ^= (index & mask) >> 2;
+		index *= 0xc860a3dfu;
+		index &= mask;
+		index ^= index >> 5;
+	} while (index >= length);
+	return (index + seed) % length;
+}
+
+StratifiedSampler::StratifiedSampler(int imageWidth, int samplesPerPixel) : m_imageWidth(imageWidth) {
+	// The most square grid with exactly samplesPerPixel cells, a prime count ends up as strips
+	int count = std::max(1, samplesPerPixel);
+	m_strataX = 1;
+	for (int i = 1; i * i <= count; i++) {
+		if (count % i == 0) {
+			m_strataX = i;
+		}
+	}
+	m_strataY = count / m_strataX;
+}
+
+float2 StratifiedSampler::Get2D(int x, int y, int sample, int dimension, uint frame) const {
+	uint pixel = y * m_imageWidth + x;
+	uint count = m_strataX * m_strataY;
+	uint grid = sample / count;
+
+	uint seed = Hash(Hash(pixel, dimension), Hash(frame, grid));
+	uint stratum = Permute(sample % count, count, seed);
+
+	RandomGenerator random(pixel, sample, frame);
+	for (int i = 0; i < 2 * dimension; i++) {
+		random.NextUint();
+	}
+	float jitterX = random.NextFloat();
+	float jitterY = random.NextFloat();
+	return float2((stratum % m_strataX + jitterX) / m_strataX, (stratum / m_strataX + jitterY) / m_strataY);
+}
+
+#pragma endregion
+
+#pragma region Sobol
+
+// Laine-Karras style permutation: every bit is flipped depending on the seed and the bits below it
+static uint LaineKarrasPermutation(uint x, uint seed) {
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return x;
+}
+
+// Owen scrambling: every bit is flipped depending on the seed and the bits above it, which keeps the net properties of the points
+static uint NestedUniformScramble(uint x, uint seed) {
+	return ReverseBits(LaineKarrasPermutation(ReverseBits(x), seed));
+}
+
+// Dimension 0 is the van der Corput sequence, dimension 1 uses the direction numbers of x + 1: v[k] = v[k - 1] ^ (v[k - 1] >> 1)
+static uint Sobol(uint index, int dimension) {
+	if (dimension == 0) {
+		return ReverseBits(index);
+	}
+
+	uint result = 0;
+	uint direction = 1u << 31;
+	for (; index != 0; index >>= 1) {
+		if (index & 1) {
+			result ^= direction;
+		}
+		direction ^= direction >> 1;
+	}
+	return result;
+}
+
+float2 SobolSampler::Get2D(int x, int y, int sample, int dimension, uint frame) const {
+	uint seed = Hash(Hash(y * m_imageWidth + x, dimension), frame);
+	uint index = NestedUniformScramble(sample, seed);
+	uint u = NestedUniformScramble(Sobol(index, 0), Hash(seed, 0x68bc21ebu));
+	uint v = NestedUniformScramble(Sobol(index, 1), Hash(seed, 0x02e5be93u));
+	return float2(ToUnitFloat(u), ToUnitFloat(v));
+}
+
+#pragma endregion
+
+#pragma region Blue noise
+
+// R2 sequence (Roberts 2018): 2^32 / g and 2^32 / g^2 for the plastic number g, added in fixed point so it wraps around exactly
+static constexpr uint R2_STEP_X = 0xc13fa9a9u;
+static constexpr uint R2_STEP_Y = 0x91e10da5u;
+
+BlueNoiseSampler::BlueNoiseSampler() {
+	GenerateMask();
+}
+
+float2 BlueNoiseSampler::Get2D(int x, int y, int sample, int dimension, uint frame) const {
+	// Every dimension and frame reads the mask at other offsets, the two coordinates as well
+	uint offsets = Hash(dimension, frame);
+	int mask = MASK_SIZE - 1;
+	uint u = m_mask[((y + (offsets >> 6)) & mask) * MASK_SIZE + ((x + offsets) & mask)];
+	uint v = m_mask[((y + (offsets >> 18)) & mask) * MASK_SIZE + ((x + (offsets >> 12)) & mask)];
+	return float2(ToUnitFloat(u + sample * R2_STEP_X), ToUnitFloat(v + sample * R2_STEP_Y));
+}
+
+// Void-and-cluster (Ulichney 1993): the rank of every cell is the order in which it gets filled when new points always go to the
+// largest gap, measured by a Gaussian energy on the torus so the mask tiles without seams
+void BlueNoiseSampler::GenerateMask() {
+	constexpr int CELL_COUNT = MASK_SIZE * MASK_SIZE;
+	constexpr float SIGMA = 1.5f;
+
+	vector<float> kernel(CELL_COUNT);
+	for (int y = 0; y < MASK_SIZE; y++) {
+		for (int x = 0; x < MASK_SIZE; x++) {
+			int dx = std::min(x, MASK_SIZE - x);
+			int dy = std::min(y, MASK_SIZE - y);
+			kernel[y * MASK_SIZE + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * SIGMA * SIGMA));
+		}
+	}
+
+	vector<uchar> pattern(CELL_COUNT, 0);
+	vector<float> energy(CELL_COUNT, 0.0f);
+	auto Splat = [&](vector<float>& target, int cell, float sign) {
+		int cellX = cell % MASK_SIZE;
+		int cellY = cell / MASK_SIZE;
+		for (int y = 0; y < MASK_SIZE; y++) {
+			int dy = (y - cellY) & (MASK_SIZE - 1);
+			for (int x = 0; x < MASK_SIZE; x++) {
+				target[y * MASK_SIZE + x] += sign * kernel[dy * MASK_SIZE + ((x - cellX) & (MASK_SIZE - 1))];
+			}
+		}
+	};
+	// Tightest cluster: the filled cell with the most energy. Largest void: the empty cell with the least
+	auto Find = [&](const vector<uchar>& cells, const vector<float>& cellEnergy, uchar filled) {
+		int best = -1;
+		for (int i = 0; i < CELL_COUNT; i++) {
+			if (cells[i] == filled && (best < 0 || (filled ? cellEnergy[i] > cellEnergy[best] : cellEnergy[i] < cellEnergy[best]))) {
+				best = i;
+			}
+		}
+		return best;
+	};
+
+	// Start from 10% random points and move the tightest cluster into the largest void until that changes nothing
+	RandomGenerator random(0, 0, 0);
+	int initialCount = CELL_COUNT / 10;
+	for (int placed = 0; placed < initialCount;) {
+		int cell = random.NextUint() % CELL_COUNT;
+		if (!pattern[cell]) {
+			pattern[cell] = 1;
+			Splat(energy, cell, 1.0f);
+			placed++;
+		}
+	}
+
+	for (int iteration = 0; iteration < CELL_COUNT; iteration++) {
+		int cluster = Find(pattern, energy, 1);
+		pattern[cluster] = 0;
+		Splat(energy, cluster, -1.0f);
+
+		int gap = Find(pattern, energy, 0);
+		pattern[gap] = 1;
+		Splat(energy, gap, 1.0f);
+		if (gap == cluster) {
+			break;
+		}
+	}
+
+	vector<int> rank(CELL_COUNT);
+
+	// The initial points are ranked by taking the tightest cluster out first
+	vector<uchar> removed = pattern;
+	vector<float> removedEnergy = energy;
+	for (int r = initialCount - 1; r >= 0; r--) {
+		int cluster = Find(removed, removedEnergy, 1);
+		removed[cluster] = 0;
+		Splat(removedEnergy, cluster, -1.0f);
+		rank[cluster] = r;
+	}
+
+	// And the rest by filling the largest void
+	for (int r = initialCount; r < CELL_COUNT; r++) {
+		int gap = Find(pattern, energy, 0);
+		pattern[gap] = 1;
+		Splat(energy, gap, 1.0f);
+		rank[gap] = r;
+	}
+
+	// Ranks spread evenly over [0, 2^32)
+	m_mask.resize(CELL_COUNT);
+	for (int i = 0; i < CELL_COUNT; i++) {
+		m_mask[i] = (uint)((rank[i] + 0.5) / CELL_COUNT * 4294967296.0);
+	}
+}
+
+#pragma endregion
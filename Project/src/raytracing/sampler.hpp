@@ -0,0 +1,69 @@
+#pragma once
+
+enum class SamplerType {
+	Independent,
+	Stratified,
+	Sobol,
+	BlueNoise
+};
+
+// Where the sample points of a pixel come from. A point only depends on (pixel, sample, dimension, frame), so it does not matter which
+// thread or pass traces it. Every dimension is a 2D point in [0, 1)^2 and dimensions are decorrelated from each other:
+// PIXEL_JITTER is used now, further dimensions are meant for light and BSDF sampling
+class Sampler {
+public:
+	static constexpr int PIXEL_JITTER = 0;
+
+	virtual ~Sampler() = default;
+	virtual float2 Get2D(int x, int y, int sample, int dimension, uint frame) const = 0;
+
+	static Sampler* Create(SamplerType type, int imageWidth, int samplesPerPixel);
+	static cstring GetName(SamplerType type);
+};
+
+// Uniform random points, the reference the others are measured against
+class IndependentSampler : public Sampler {
+public:
+	IndependentSampler(int imageWidth) : m_imageWidth(imageWidth) {}
+	float2 Get2D(int x, int y, int sample, int dimension, uint frame) const override;
+
+private:
+	int m_imageWidth;
+};
+
+// Jittered grid over samplesPerPixel strata, visited in a random order per pixel. Samples beyond samplesPerPixel start a new grid
+class StratifiedSampler : public Sampler {
+public:
+	StratifiedSampler(int imageWidth, int samplesPerPixel);
+	float2 Get2D(int x, int y, int sample, int dimension, uint frame) const override;
+
+private:
+	int m_imageWidth;
+	int m_strataX;
+	int m_strataY;
+};
+
+// The first two Sobol dimensions with hash-based Owen scrambling and a shuffled sample order (Burley 2020). Every power of two
+// samples is well distributed, so it also works for progressive and adaptive rendering
+class SobolSampler : public Sampler {
+public:
+	SobolSampler(int imageWidth) : m_imageWidth(imageWidth) {}
+	float2 Get2D(int x, int y, int sample, int dimension, uint frame) const override;
+
+private:
+	int m_imageWidth;
+};
+
+// R2 sequence per pixel, offset by a tiled blue-noise mask, so the error of neighbouring pixels is uncorrelated and looks like
+// fine grain instead of clumps at low sample counts. The mask is made with void-and-cluster when the sampler is created
+class BlueNoiseSampler : public Sampler {
+public:
+	BlueNoiseSampler();
+	float2 Get2D(int x, int y, int sample, int dimension, uint frame) const override;
+
+private:
+	static constexpr int MASK_SIZE = 64;
+	vector<uint> m_mask;
+
+	void GenerateMask();
+};
@@ -0,0 +1,101 @@
+#include "tile_scheduler.hpp"
+#include <chrono>
+#include <thread>
+#include "../utils/parallel.hpp"
+
+TileScheduler::TileScheduler(int tileSize, int threadCount) : m_tileSize(tileSize) {
+	m_threadCount = ResolveThreadCount(threadCount);
+
+	for (int i = 0; i < m_threadCount; i++) {
+		m_queues.push_back(std::make_unique<WorkerQueue>());
+	}
+	m_busyTimes.resize(m_threadCount, 0.0);
+}
+
+void TileScheduler::Run(int width, int height, const std::function<void(const Tile&, int)>& renderTile) {
+	auto start = std::chrono::steady_clock::now();
+
+	// Tiles left over from a cancelled run are dropped
+	for (std::unique_ptr<WorkerQueue>& queue : m_queues) {
+		queue->tiles.clear();
+	}
+
+	// Hand every worker a contiguous band of tiles, so neighbouring tiles stay on the same core until stolen
+	int tilesX = (width + m_tileSize - 1) / m_tileSize;
+	int tilesY = (height + m_tileSize - 1) / m_tileSize;
+	int tileCount = tilesX * tilesY;
+
+	for (int i = 0; i < tileCount; i++) {
+		int x0 = (i % tilesX) * m_tileSize;
+		int y0 = (i / tilesX) * m_tileSize;
+		Tile tile = { x0, y0, std::min(x0 + m_tileSize, width), std::min(y0 + m_tileSize, height), i };
+
+		int owner = (int)((long long)i * m_threadCount / tileCount);
+		m_queues[owner]->tiles.push_back(tile);
+	}
+
+	std::fill(m_busyTimes.begin(), m_busyTimes.end(), 0.0);
+
+	vector<std::thread> workers;
+	for (int threadIndex = 1; threadIndex < m_threadCount; threadIndex++) {
+		workers.emplace_back(&TileScheduler::WorkerLoop, this, threadIndex, std::cref(renderTile));
+	}
+
+	// The calling thread works as well
+	WorkerLoop(0, renderTile);
+
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	m_wallTime = std::chrono::duration<double>(end - start).count();
+}
+
+double TileScheduler::GetUtilization(int threadIndex) const {
+	if (m_wallTime <= 0.0) {
+		return 0.0;
+	}
+	return m_busyTimes[threadIndex] / m_wallTime;
+}
+
+void TileScheduler::WorkerLoop(int threadIndex, const std::function<void(const Tile&, int)>& renderTile) {
+	if (threadIndex > 0) {
+		PROFILE_THREAD_NAME("Tile worker");
+	}
+
+	Tile tile;
+	while (!m_cancelled && (PopTile(threadIndex, tile) || StealTile(threadIndex, tile))) {
+		PROFILE_SCOPE("Tile");
+		auto start = std::chrono::steady_clock::now();
+		renderTile(tile, threadIndex);
+		auto end = std::chrono::steady_clock::now();
+		m_busyTimes[threadIndex] += std::chrono::duration<double>(end - start).count();
+	}
+}
+
+bool TileScheduler::PopTile(int threadIndex, Tile& tile) {
+	WorkerQueue& queue = *m_queues[threadIndex];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tiles.empty()) {
+		return false;
+	}
+
+	tile = queue.tiles.front();
+	queue.tiles.pop_front();
+	return true;
+}
+
+bool TileScheduler::StealTile(int threadIndex, Tile& tile) {
+	// Take from the far end of a victim's band, away from the tiles it is working through
+	for (int offset = 1; offset < m_threadCount; offset++) {
+		WorkerQueue& victim = *m_queues[(threadIndex + offset) % m_threadCount];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tiles.empty()) {
+			tile = victim.tiles.back();
+			victim.tiles.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
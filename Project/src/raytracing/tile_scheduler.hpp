@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+// Screen-space rectangle [x0, x1) x [y0, y1)
+struct Tile {
+	int x0, y0;
+	int x1, y1;
+	int index;
+};
+
+class TileScheduler {
+public:
+	// A thread count of 0 uses all hardware threads
+	TileScheduler(int tileSize, int threadCount = 0);
+	~TileScheduler() = default;
+
+	// Calls renderTile(tile, threadIndex) once for every tile of the image, spread over all workers
+	void Run(int width, int height, const std::function<void(const Tile&, int)>& renderTile);
+
+	// Can be called from any thread, workers stop taking new tiles and Run returns once the tiles in flight are done.
+	// The cancel holds until Reset, so a cancel that arrives before Run stops that run too
+	void Cancel() { m_cancelled = true; }
+	void Reset() { m_cancelled = false; }
+	bool WasCancelled() const { return m_cancelled; }
+
+	int GetThreadCount() const { return m_threadCount; }
+	double GetWallTime() const { return m_wallTime; }
+	double GetUtilization(int threadIndex) const;
+
+private:
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::deque<Tile> tiles;
+	};
+
+	int m_tileSize;
+	int m_threadCount;
+
+	vector<std::unique_ptr<WorkerQueue>> m_queues;
+	vector<double> m_busyTimes;
+	double m_wallTime = 0.0;
+	std::atomic<bool> m_cancelled = false;
+
+	void WorkerLoop(int threadIndex, const std::function<void(const Tile&, int)>& renderTile);
+	bool PopTile(int threadIndex, Tile& tile);
+	bool StealTile(int threadIndex, Tile& tile);
+};
@@ -1,12 +1,13 @@
 #include "camera.hpp"
 
-Camera::Camera(float3 position, float3 lookAt, float3 worldUp) : m_cameraCenter(position) {
+Camera::Camera(const RenderSettings& settings, float3 position, float3 lookAt, float3 worldUp) :
+	m_cameraCenter(position), m_imageWidth(settings.width), m_imageHeight(settings.height) {
 	float3 forward = normalize(lookAt - position);
 	float3 right = normalize(cross(worldUp, forward));
 	float3 up = cross(forward, right);
 	
 	// Default values
-	m_aspectRatio = (float)IMAGE_WIDTH / (float)IMAGE_HEIGHT;
+	m_aspectRatio = settings.GetAspectRatio();
 	m_focalLength = 1.0f;
 	m_fieldOfView = 90;
 
@@ -33,7 +34,7 @@ void Camera::PrecomputeImagePlane(const float3& right, const float3& up, const f
 	float3 imagePlaneCenter = m_cameraCenter + forward * m_focalLength;
 	float3 imagePlaneTopleft = imagePlaneCenter - (right * 0.5f * imagePlaneWidth) - (up * 0.5f * imagePlaneHeight);
 
-	m_pixelU = right * (imagePlaneWidth / (float)IMAGE_WIDTH);
-	m_pixelV = up * (imagePlaneHeight / (float)IMAGE_HEIGHT);
+	m_pixelU = right * (imagePlaneWidth / (float)m_imageWidth);
+	m_pixelV = up * (imagePlaneHeight / (float)m_imageHeight);
 	m_pixelTopLeft = imagePlaneTopleft + 0.5f * m_pixelU + 0.5f * m_pixelV;
 }
\ No newline at end of file
@@ -1,14 +1,17 @@
 #pragma once
 #include "../raytracing/ray.hpp"
+#include "../raytracing/render_settings.hpp"
 
 class Camera {
 public:
-	Camera(float3 position, float3 lookAt = float3(0.f, 0.f, 1.0f), float3 worldUp = float3(0.f, 1.f, 0.f));
+	Camera(const RenderSettings& settings, float3 position, float3 lookAt = float3(0.f, 0.f, 1.0f), float3 worldUp = float3(0.f, 1.f, 0.f));
 	~Camera() = default;
 
 	Ray GeneratePrimaryRay(float x, float y);
 private:
 	float3 m_cameraCenter;
+	int m_imageWidth;
+	int m_imageHeight;
 
 	float3 m_pixelU;
 	float3 m_pixelV;
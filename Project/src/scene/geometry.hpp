@@ -2,16 +2,30 @@
 #include "../utils/base_types.hpp"
 #include "../raytracing/acceleration_structures/aabb.hpp"
 #include "../raytracing/intersection_point.hpp"
+#include "../raytracing/ray_packet.hpp"
 
 class GeometricObject {
 public:
 	virtual bool Hit(const Ray& ray, const Interval& ray_t, IntersectionPoint& intersectionPoint) const = 0;
+	// Any-hit query, true as soon as anything is hit within ray_t. Does not compute the intersection point
+	virtual bool Occluded(const Ray& ray, const Interval& ray_t) const = 0;
+	// Closest-hit query for the packet lanes in laneMask, shortens packet.tMax and fills intersectionPoints per hit lane
+	virtual void HitPacket(RayPacket& packet, int laneMask, IntersectionPoint* intersectionPoints) const;
 	AABB GetBoundingBox() const;
 
 protected:
 	AABB m_bbox;
 };
 
+inline void GeometricObject::HitPacket(RayPacket& packet, int laneMask, IntersectionPoint* intersectionPoints) const {
+	// Default: one ray at a time
+	for (int lane = 0; lane < packet.size; lane++) {
+		if ((laneMask & (1 << lane)) != 0 && Hit(packet.GetRay(lane), Interval(packet.tMin, packet.tMax[lane]), intersectionPoints[lane])) {
+			packet.tMax[lane] = intersectionPoints[lane].t;
+		}
+	}
+}
+
 inline AABB GeometricObject::GetBoundingBox() const {
 	return m_bbox;
 }
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include <chrono>
+#include "instance.hpp"
+
+Transform Transform::Translation(const float3& offset) {
+	Transform transform;
+	transform.translation = offset;
+	return transform;
+}
+
+Transform Transform::Scale(const float3& factors) {
+	Transform transform;
+	transform.x = float3(factors.x, 0.0f, 0.0f);
+	transform.y = float3(0.0f, factors.y, 0.0f);
+	transform.z = float3(0.0f, 0.0f, factors.z);
+	return transform;
+}
+
+// Rodrigues' rotation formula, column i is the rotated unit vector i
+Transform Transform::Rotation(const float3& axis, float angle) {
+	float3 a = normalize(axis);
+	float c = std::cos(angle);
+	float s = std::sin(angle);
+	float3 t = a * (1.0f - c);
+
+	Transform transform;
+	transform.x = float3(c + t.x * a.x, t.x * a.y + s * a.z, t.x * a.z - s * a.y);
+	transform.y = float3(t.y * a.x - s * a.z, c + t.y * a.y, t.y * a.z + s * a.x);
+	transform.z = float3(t.z * a.x + s * a.y, t.z * a.y - s * a.x, c + t.z * a.z);
+	return transform;
+}
+
+// The rows of the inverse of a 3x3 matrix are the cross products of its columns over the determinant
+Transform Transform::Inverse() const {
+	float3 row0 = cross(y, z);
+	float3 row1 = cross(z, x);
+	float3 row2 = cross(x, y);
+	float inverseDeterminant = 1.0f / dot(x, row0);
+	row0 *= inverseDeterminant;
+	row1 *= inverseDeterminant;
+	row2 *= inverseDeterminant;
+
+	Transform inverse;
+	inverse.x = float3(row0.x, row1.x, row2.x);
+	inverse.y = float3(row0.y, row1.y, row2.y);
+	inverse.z = float3(row0.z, row1.z, row2.z);
+	inverse.translation = -inverse.TransformDirection(translation);
+	return inverse;
+}
+
+Transform Transform::operator*(const Transform& other) const {
+	Transform product;
+	product.x = TransformDirection(other.x);
+	product.y = TransformDirection(other.y);
+	product.z = TransformDirection(other.z);
+	product.translation = TransformPoint(other.translation);
+	return product;
+}
+
+InstancedMesh::InstancedMesh(Mesh* mesh, const BVHBuildSettings& settings) : m_mesh(mesh) {
+	PROFILE_SCOPE("Build BLAS");
+	auto start = std::chrono::steady_clock::now();
+
+	vector<std::shared_ptr<Primitive>> triangles;
+	triangles.reserve(mesh->GetTriangleCount());
+	for (int i = 0; i < mesh->GetTriangleCount(); i++) {
+		triangles.push_back(std::make_shared<Triangle>(mesh, i));
+		triangles.back()->SetID(i);
+	}
+
+	SAHBuilder builder(settings);
+	m_pBVH = builder.Build(triangles);
+	m_pBVH->GatherTriangleData();
+#if BVH_WIDTH == 4 || BVH_WIDTH == 8
+	m_pWideBVH = new WideBVH<BVH_WIDTH>(*m_pBVH);
+#endif
+
+	const LinearBVHNode& root = m_pBVH->GetNodes()[0];
+	m_bbox = AABB(float3(root.boundsMin[0], root.boundsMin[1], root.boundsMin[2]), float3(root.boundsMax[0], root.boundsMax[1], root.boundsMax[2]));
+
+	auto end = std::chrono::steady_clock::now();
+	std::chrono::duration<double> duration = end - start;
+	spdlog::info("Timer | Build BLAS: {} | Triangles: {} | Nodes: {}", duration.count(), mesh->GetTriangleCount(), m_pBVH->GetNodeCount());
+}
+
+InstancedMesh::~InstancedMesh() {
+#if BVH_WIDTH == 4 || BVH_WIDTH == 8
+	delete m_pWideBVH;
+#endif
+	// The BVH's triangles point into the mesh
+	delete m_pBVH;
+	delete m_mesh;
+}
+
+bool InstancedMesh::Hit(const Ray& ray, const Interval& ray_t, IntersectionPoint& intersectionPoint) const {
+#if BVH_WIDTH == 4 || BVH_WIDTH == 8
+	return m_pWideBVH->Hit(ray, ray_t, intersectionPoint);
+#else
+	return m_pBVH->Hit(ray, ray_t, intersectionPoint);
+#endif
+}
+
+bool InstancedMesh::Occluded(const Ray& ray, const Interval& ray_t) const {
+#if BVH_WIDTH == 4 || BVH_WIDTH == 8
+	return m_pWideBVH->Occluded(ray, ray_t);
+#else
+	return m_pBVH->Occluded(ray, ray_t);
+#endif
+}
+
+Instance::Instance(const InstancedMesh* mesh, const Transform& objectToWorld, Color albedo) : Primitive(float3(0.0f), albedo), m_mesh(mesh) {
+	SetTransform(objectToWorld);
+}
+
+void Instance::SetTransform(const Transform& objectToWorld) {
+	m_worldToObject = objectToWorld.Inverse();
+
+	// The world box is the box around the corners of the transformed object box
+	const AABB& bbox = m_mesh->GetBoundingBox();
+	float3 min = float3(INFINITY);
+	float3 max = float3(-INFINITY);
+	for (int corner = 0; corner < 8; corner++) {
+		float3 point = float3(
+			(corner & 1) != 0 ? bbox.GetAxis(0).max : bbox.GetAxis(0).min,
+			(corner & 2) != 0 ? bbox.GetAxis(1).max : bbox.GetAxis(1).min,
+			(corner & 4) != 0 ? bbox.GetAxis(2).max : bbox.GetAxis(2).min);
+		point = objectToWorld.TransformPoint(point);
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+	m_bbox = AABB(min, max);
+	m_center = 0.5f * (min + max);
+}
+
+// The direction is not normalized, so a distance along the object space ray is the same distance along the world ray
+Ray Instance::ToObjectSpace(const Ray& ray) const {
+	return Ray(m_worldToObject.TransformPoint(ray.origin), m_worldToObject.TransformDirection(ray.direction));
+}
+
+bool Instance::Hit(const Ray& ray, const Interval& ray_t, IntersectionPoint& intersectionPoint) const {
+	if (!m_mesh->Hit(ToObjectSpace(ray), ray_t, intersectionPoint)) {
+		return false;
+	}
+
+	intersectionPoint.point = ray.GetPoint(intersectionPoint.t);
+	intersectionPoint.normal = normalize(m_worldToObject.TransformNormal(intersectionPoint.normal));
+	intersectionPoint.objectID = m_id;
+	return true;
+}
+
+bool Instance::Occluded(const Ray& ray, const Interval& ray_t) const {
+	return m_mesh->Occluded(ToObjectSpace(ray), ray_t);
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "mesh.hpp"
+#include "primitives.hpp"
+#include "../raytracing/acceleration_structures/sah_builder.hpp"
+#include "../raytracing/acceleration_structures/wide_bvh.hpp"
+
+// Affine transform as the four columns of a 3x4 matrix, 48 bytes where a mat4 takes 64
+struct Transform {
+	float3 x = float3(1.0f, 0.0f, 0.0f);
+	float3 y = float3(0.0f, 1.0f, 0.0f);
+	float3 z = float3(0.0f, 0.0f, 1.0f);
+	float3 translation = float3(0.0f);
+
+	static Transform Translation(const float3& offset);
+	static Transform Scale(const float3& factors);
+	// Counterclockwise around axis when it points at the viewer, angle in radians
+	static Transform Rotation(const float3& axis, float angle);
+
+	float3 TransformPoint(const float3& point) const { return x * point.x + y * point.y + z * point.z + translation; }
+	float3 TransformDirection(const float3& direction) const { return x * direction.x + y * direction.y + z * direction.z; }
+	// The transposed linear part. Applied by a world to object transform, it takes object space normals to world space (not normalized)
+	float3 TransformNormal(const float3& normal) const { return float3(dot(x, normal), dot(y, normal), dot(z, normal)); }
+
+	// Only for invertible transforms, a zero scale gives infinities
+	Transform Inverse() const;
+	// other first, then this
+	Transform operator*(const Transform& other) const;
+};
+
+// Bottom level of the two-level acceleration structure: a BVH over one mesh's triangles in object space, built once and shared by all
+// the Instances of the mesh. Owns the mesh
+class InstancedMesh {
+public:
+	InstancedMesh(Mesh* mesh, const BVHBuildSettings& settings = BVHBuildSettings());
+	~InstancedMesh();
+
+	InstancedMesh(const InstancedMesh&) = delete;
+	InstancedMesh& operator=(const InstancedMesh&) = delete;
+
+	bool Hit(const Ray& ray, const Interval& ray_t, IntersectionPoint& intersectionPoint) const;
+	bool Occluded(const Ray& ray, const Interval& ray_t) const;
+
+	const Mesh& GetMesh() const { return *m_mesh; }
+	// In object space, around the triangles' padded boxes
+	const AABB& GetBoundingBox() const { return m_bbox; }
+
+private:
+	Mesh* m_mesh;
+	AABB m_bbox;
+
+	LinearBVH* m_pBVH = nullptr;
+#if BVH_WIDTH == 4 || BVH_WIDTH == 8
+	WideBVH<BVH_WIDTH>* m_pWideBVH = nullptr;
+#endif
+};
+
+// A placed copy of an InstancedMesh, which has to outlive it. Rays are moved into the mesh's object space and traced through its BVH,
+// so the instances only cost their transform. Hits report the instance's ID, and with it its albedo
+class Instance : public Primitive {
+public:
+	Instance(const InstancedMesh* mesh, const Transform& objectToWorld, Color albedo = COLOR_GREY);
+	~Instance() = default;
+
+	bool Hit(const Ray& ray, const Interval& ray_t, IntersectionPoint& intersectionPoint) const override;
+	bool Occluded(const Ray& ray, const Interval& ray_t) const override;
+
+	// Moves the instance, the top level BVH only sees the new box once it is rebuilt
+	void SetTransform(const Transform& objectToWorld);
+	const InstancedMesh* GetMesh() const { return m_mesh; }
+
+private:
+	const InstancedMesh* m_mesh;
+	// Only the inverse is kept: world space points come from the world ray, and normals from the transpose of the inverse
+	Transform m_worldToObject;
+
+	Ray ToObjectSpace(const Ray& ray) const;
+};
@@ -0,0 +1,317 @@
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include "mesh.hpp"
+#include "../utils/parallel.hpp"
+
+// .tmesh layout (little endian): the header, vertexCount vertices of three floats and 3 * triangleCount uint vertex indices.
+// Everything is 4-byte aligned, so the arrays are used in place. Bump the version whenever the layout changes
+struct MeshFileHeader {
+	char magic[4];
+	uint version;
+	uint vertexCount;
+	uint triangleCount;
+};
+
+static constexpr char MESH_FILE_MAGIC[4] = { 'T', 'M', 'S', 'H' };
+static constexpr uint MESH_FILE_VERSION = 1;
+
+// Files smaller than this are not worth splitting over threads
+static constexpr size_t OBJ_MIN_CHUNK_SIZE = 1 << 16;
+
+// What one thread parsed from its part of an OBJ file
+struct OBJChunk {
+	vector<float3> vertices;
+	vector<uint> indices;
+	// Negative face indices count back from the last vertex, they are stored relative to the first vertex of this chunk and listed
+	// here, so they can be made absolute once the vertex counts of the chunks before are known
+	vector<size_t> relativeIndices;
+	string error;
+};
+
+static bool IsSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* SkipSpaces(const char* p, const char* end) {
+	while (p < end && IsSpace(*p)) {
+		p++;
+	}
+	return p;
+}
+
+static const char* ParseFloat(const char* p, const char* end, float& value) {
+	p = SkipSpaces(p, end);
+	if (p < end && *p == '+') {
+		p++;
+	}
+	std::from_chars_result result = std::from_chars(p, end, value);
+	return result.ec == std::errc() ? result.ptr : nullptr;
+}
+
+static void ParseOBJLine(const char* p, const char* end, OBJChunk& chunk) {
+	if (end - p < 2 || !IsSpace(p[1])) {
+		return;
+	}
+
+	if (p[0] == 'v') {
+		float3 vertex;
+		for (int axis = 0; axis < 3 && p != nullptr; axis++) {
+			p = ParseFloat(p + (axis == 0 ? 1 : 0), end, vertex[axis]);
+		}
+		if (p == nullptr) {
+			chunk.error = "vertex without three coordinates";
+			return;
+		}
+		chunk.vertices.push_back(vertex);
+	}
+	else if (p[0] == 'f') {
+		// Polygons become a fan of triangles around their first vertex
+		uint fan[2];
+		bool fanIsRelative[2];
+		int vertexCount = 0;
+
+		p++;
+		while (true) {
+			p = SkipSpaces(p, end);
+			if (p == end) {
+				break;
+			}
+
+			int value = 0;
+			std::from_chars_result result = std::from_chars(p, end, value);
+			if (result.ec != std::errc() || value == 0) {
+				chunk.error = "face with an invalid vertex index";
+				return;
+			}
+			// Texture coordinate and normal indices (v/vt/vn) are skipped
+			p = result.ptr;
+			while (p < end && !IsSpace(*p)) {
+				p++;
+			}
+
+			bool isRelative = value < 0;
+			uint index = isRelative ? (uint)((int)chunk.vertices.size() + value) : (uint)(value - 1);
+			if (vertexCount >= 2) {
+				uint triangle[3] = { fan[0], fan[1], index };
+				bool triangleIsRelative[3] = { fanIsRelative[0], fanIsRelative[1], isRelative };
+				for (int i = 0; i < 3; i++) {
+					if (triangleIsRelative[i]) {
+						chunk.relativeIndices.push_back(chunk.indices.size());
+					}
+					chunk.indices.push_back(triangle[i]);
+				}
+			}
+
+			int slot = std::min(vertexCount, 1);
+			fan[slot] = index;
+			fanIsRelative[slot] = isRelative;
+			vertexCount++;
+		}
+	}
+}
+
+// Parses whole lines only, begin is the start of a line and end the start of a line or the end of the file
+static void ParseOBJChunk(const char* begin, const char* end, OBJChunk& chunk) {
+	const char* line = begin;
+	while (line < end && chunk.error.empty()) {
+		const char* lineEnd = (const char*)std::memchr(line, '\n', end - line);
+		if (lineEnd == nullptr) {
+			lineEnd = end;
+		}
+
+		ParseOBJLine(SkipSpaces(line, lineEnd), lineEnd, chunk);
+		if (!chunk.error.empty()) {
+			chunk.error += fmt::format(": \"{}\"", string(line, std::min<size_t>(lineEnd - line, 80)));
+		}
+		line = lineEnd + 1;
+	}
+}
+
+// Start of the first line at or after offset
+static size_t FindLineStart(const char* data, size_t size, size_t offset) {
+	if (offset == 0 || offset >= size) {
+		return std::min(offset, size);
+	}
+	const char* lineEnd = (const char*)std::memchr(data + offset - 1, '\n', size - offset + 1);
+	return lineEnd != nullptr ? lineEnd - data + 1 : size;
+}
+
+Mesh::Mesh(vector<float3>&& vertices, vector<uint>&& indices) : m_ownedVertices(std::move(vertices)), m_ownedIndices(std::move(indices)) {
+	m_vertices = m_ownedVertices.data();
+	m_indices = m_ownedIndices.data();
+	m_vertexCount = (int)m_ownedVertices.size();
+	m_triangleCount = (int)(m_ownedIndices.size() / 3);
+}
+
+Mesh* Mesh::Load(const std::filesystem::path& path, int threadCount) {
+	PROFILE_SCOPE("Load mesh");
+	auto start = std::chrono::steady_clock::now();
+
+	string extension = path.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)std::tolower(c); });
+
+	Mesh* mesh = new Mesh();
+	bool loaded = false;
+	if (extension == ".obj") {
+		loaded = mesh->LoadOBJ(path, threadCount);
+	}
+	else if (extension == ".tmesh") {
+		loaded = mesh->LoadBinary(path);
+	}
+	else {
+		spdlog::error("Unsupported mesh format {}, use .obj or .tmesh", extension);
+	}
+
+	if (loaded) {
+		loaded = mesh->ValidateIndices(path, threadCount);
+	}
+	if (!loaded) {
+		delete mesh;
+		return nullptr;
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	std::chrono::duration<double> duration = end - start;
+	spdlog::info("Timer | Mesh load: {} | File: {} | Vertices: {} | Triangles: {}", duration.count(), path.filename().string(), mesh->m_vertexCount,
+		mesh->m_triangleCount);
+	return mesh;
+}
+
+bool Mesh::LoadOBJ(const std::filesystem::path& path, int threadCount) {
+	if (!m_file.Open(path)) {
+		return false;
+	}
+
+	const char* data = (const char*)m_file.GetData();
+	size_t size = m_file.GetSize();
+	int chunkCount = (int)std::clamp<size_t>(size / OBJ_MIN_CHUNK_SIZE, 1, ResolveThreadCount(threadCount));
+
+	vector<OBJChunk> chunks(chunkCount);
+	ParallelForChunks(chunkCount, chunkCount, [&](int chunk, int, int) {
+		size_t begin = FindLineStart(data, size, size * chunk / chunkCount);
+		size_t end = FindLineStart(data, size, size * (chunk + 1) / chunkCount);
+		ParseOBJChunk(data + begin, data + end, chunks[chunk]);
+	});
+
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+	vector<size_t> vertexOffsets, indexOffsets;
+	for (const OBJChunk& chunk : chunks) {
+		if (!chunk.error.empty()) {
+			spdlog::error("{}: {}", path.string(), chunk.error);
+			return false;
+		}
+		vertexOffsets.push_back(vertexCount);
+		indexOffsets.push_back(indexCount);
+		vertexCount += chunk.vertices.size();
+		indexCount += chunk.indices.size();
+	}
+
+	if (indexCount == 0 || vertexCount > INT_MAX || indexCount / 3 > INT_MAX) {
+		spdlog::error("{}: {} vertices and {} triangles, expected at least one and at most {} triangles", path.string(), vertexCount, indexCount / 3, INT_MAX);
+		return false;
+	}
+
+	m_ownedVertices.resize(vertexCount);
+	m_ownedIndices.resize(indexCount);
+	ParallelForChunks(chunkCount, chunkCount, [&](int chunk, int, int) {
+		const OBJChunk& parsed = chunks[chunk];
+		std::copy(parsed.vertices.begin(), parsed.vertices.end(), m_ownedVertices.begin() + vertexOffsets[chunk]);
+		std::copy(parsed.indices.begin(), parsed.indices.end(), m_ownedIndices.begin() + indexOffsets[chunk]);
+		for (size_t position : parsed.relativeIndices) {
+			uint& index = m_ownedIndices[indexOffsets[chunk] + position];
+			index = (uint)((long long)(int)index + (long long)vertexOffsets[chunk]);
+		}
+	});
+
+	// The text is not needed anymore, only the parsed arrays
+	m_file.Close();
+	m_vertices = m_ownedVertices.data();
+	m_indices = m_ownedIndices.data();
+	m_vertexCount = (int)vertexCount;
+	m_triangleCount = (int)(indexCount / 3);
+	return true;
+}
+
+bool Mesh::LoadBinary(const std::filesystem::path& path) {
+	if (!m_file.Open(path)) {
+		return false;
+	}
+
+	MeshFileHeader header;
+	if (m_file.GetSize() < sizeof(header)) {
+		spdlog::error("{} is too small to be a mesh file", path.string());
+		return false;
+	}
+	std::memcpy(&header, m_file.GetData(), sizeof(header));
+
+	if (std::memcmp(header.magic, MESH_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != MESH_FILE_VERSION) {
+		spdlog::error("{} is not a version {} mesh file", path.string(), MESH_FILE_VERSION);
+		return false;
+	}
+
+	size_t vertexBytes = (size_t)header.vertexCount * sizeof(float3);
+	size_t indexBytes = (size_t)header.triangleCount * 3 * sizeof(uint);
+	if (m_file.GetSize() != sizeof(header) + vertexBytes + indexBytes || header.triangleCount == 0 || header.vertexCount > INT_MAX ||
+		header.triangleCount > INT_MAX) {
+		spdlog::error("{}: size does not match {} vertices and {} triangles", path.string(), header.vertexCount, header.triangleCount);
+		return false;
+	}
+
+	m_vertices = (const float3*)(m_file.GetData() + sizeof(header));
+	m_indices = (const uint*)(m_file.GetData() + sizeof(header) + vertexBytes);
+	m_vertexCount = (int)header.vertexCount;
+	m_triangleCount = (int)header.triangleCount;
+	return true;
+}
+
+// Every index is read once, the triangle primitives then never need to check them
+bool Mesh::ValidateIndices(const std::filesystem::path& path, int threadCount) const {
+	std::atomic<bool> valid = true;
+	ParallelForChunks(m_triangleCount, ResolveThreadCount(threadCount), [&](int, int begin, int end) {
+		uint largestIndex = 0;
+		for (size_t i = 3 * (size_t)begin; i < 3 * (size_t)end; i++) {
+			largestIndex = std::max(largestIndex, m_indices[i]);
+		}
+		if (largestIndex >= (uint)m_vertexCount) {
+			valid = false;
+		}
+	});
+
+	if (!valid) {
+		spdlog::error("{}: a triangle refers to a vertex past the {} vertices", path.string(), m_vertexCount);
+	}
+	return valid;
+}
+
+bool Mesh::SaveBinary(const std::filesystem::path& path) const {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		spdlog::error("Cannot open {} for writing", path.string());
+		return false;
+	}
+
+	MeshFileHeader header;
+	std::memcpy(header.magic, MESH_FILE_MAGIC, sizeof(header.magic));
+	header.version = MESH_FILE_VERSION;
+	header.vertexCount = (uint)m_vertexCount;
+	header.triangleCount = (uint)m_triangleCount;
+
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)m_vertices, (std::streamsize)m_vertexCount * sizeof(float3));
+	file.write((const char*)m_indices, (std::streamsize)m_triangleCount * 3 * sizeof(uint));
+	return (bool)file;
+}
+
+AABB Mesh::GetBoundingBox() const {
+	float3 min = float3(INFINITY);
+	float3 max = float3(-INFINITY);
+	for (int i = 0; i < m_vertexCount; i++) {
+		min = glm::min(min, m_vertices[i]);
+		max = glm::max(max, m_vertices[i]);
+	}
+	return AABB(min, max);
+}
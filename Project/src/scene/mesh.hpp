@@ -0,0 +1,53 @@
+#pragma once
+#include <filesystem>
+#include "../raytracing/acceleration_structures/aabb.hpp"
+#include "../utils/mapped_file.hpp"
+
+static_assert(sizeof(float3) == 3 * sizeof(float), "Mesh files store vertices as three packed floats");
+
+// Indexed triangle mesh, triangle i is made of the vertices at indices 3i, 3i + 1 and 3i + 2. The arrays are owned when the mesh is
+// parsed from an OBJ file, and point straight into the mapped file when it is loaded from a binary mesh file
+class Mesh {
+public:
+	Mesh() = default;
+	// Takes the arrays of a generated mesh, the indices have to be valid
+	Mesh(vector<float3>&& vertices, vector<uint>&& indices);
+	~Mesh() = default;
+
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+
+	// Wavefront .obj (positions and faces only, polygons are split into triangle fans) or binary .tmesh, picked by extension.
+	// Both are memory-mapped, OBJ files are parsed by threadCount threads (0 uses all hardware threads). Returns nullptr if the file
+	// cannot be read, the error is logged
+	static Mesh* Load(const std::filesystem::path& path, int threadCount = 0);
+	// Writes the .tmesh file Load maps back without parsing or copying
+	bool SaveBinary(const std::filesystem::path& path) const;
+
+	int GetVertexCount() const { return m_vertexCount; }
+	int GetTriangleCount() const { return m_triangleCount; }
+	const float3& GetVertex(int index) const { return m_vertices[index]; }
+	void GetTriangle(int triangle, float3& v0, float3& v1, float3& v2) const;
+	AABB GetBoundingBox() const;
+
+private:
+	const float3* m_vertices = nullptr;
+	const uint* m_indices = nullptr;
+	int m_vertexCount = 0;
+	int m_triangleCount = 0;
+
+	vector<float3> m_ownedVertices;
+	vector<uint> m_ownedIndices;
+	MappedFile m_file;
+
+	bool LoadOBJ(const std::filesystem::path& path, int threadCount);
+	bool LoadBinary(const std::filesystem::path& path);
+	bool ValidateIndices(const std::filesystem::path& path, int threadCount) const;
+};
+
+inline void Mesh::GetTriangle(int triangle, float3& v0, float3& v1, float3& v2) const {
+	const uint* indices = m_indices + 3 * (size_t)triangle;
+	v0 = m_vertices[indices[0]];
+	v1 = m_vertices[indices[1]];
+	v2 = m_vertices[indices[2]];
+}
@@ -1,4 +1,10 @@
 #include "primitives.hpp"
+#include <bit>
+#include "mesh.hpp"
+#include "triangle_soa.hpp"
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
 
 Primitive::Primitive(float3 position, Color albedo) : m_center(position), m_albedo(albedo) {}
 
@@ -15,6 +21,11 @@ uint Primitive::GetID() const {
 }
 
 Sphere::Sphere(float3 center, float radius, Color albedo) : Primitive(center, albedo), m_radius(radius) {
+    SetCenter(center);
+}
+
+void Sphere::SetCenter(const float3& center) {
+    m_center = center;
     float3 rvec = float3(m_radius, m_radius, m_radius);
     m_bbox = AABB(m_center - rvec, m_center + rvec);
 }
@@ -46,14 +57,243 @@ bool Sphere::Hit(const Ray& ray, const Interval& ray_t, IntersectionPoint& inter
         }
     }
 
-    intersectionPoint.t = root;
-    intersectionPoint.point = ray.GetPoint(root);
+    SetHit(ray, root, intersectionPoint);
+    return true;
+}
+
+void Sphere::SetHit(const Ray& ray, float t, IntersectionPoint& intersectionPoint) const {
+    intersectionPoint.t = t;
+    intersectionPoint.point = ray.GetPoint(t);
     intersectionPoint.normal = (intersectionPoint.point - m_center) * (1.0f / m_radius);
     intersectionPoint.objectID = m_id;
+}
+
+bool Sphere::Occluded(const Ray& ray, const Interval& ray_t) const {
+
+#ifdef STATS
+    stats->sphereRayIntersectionCounter++;
+#endif
+
+    float3 originToCenter = m_center - ray.origin;
+    float tClosestApproach = dot(originToCenter, ray.direction);
+    float distanceToSurfaceSquared = dot(originToCenter, originToCenter) - m_radius * m_radius;
+
+    float discriminant = tClosestApproach * tClosestApproach - distanceToSurfaceSquared;
+    if (discriminant < 0)
+    {
+        return false;
+    }
 
+    float tHalfChord = sqrt(discriminant);
+    return ray_t.Surrounds(tClosestApproach - tHalfChord) || ray_t.Surrounds(tClosestApproach + tHalfChord);
+}
+
+// Same test as Sphere::Hit on 4 lanes at a time
+void Sphere::HitPacket(RayPacket& packet, int laneMask, IntersectionPoint* intersectionPoints) const {
+
+#if defined(__SSE2__) || defined(_M_X64)
+#ifdef STATS
+    // One test per ray, as Hit counts them in the fallback
+    stats->sphereRayIntersectionCounter += std::popcount((uint)laneMask);
+#endif
+
+    const __m128 centerX = _mm_set1_ps(m_center.x);
+    const __m128 centerY = _mm_set1_ps(m_center.y);
+    const __m128 centerZ = _mm_set1_ps(m_center.z);
+    const __m128 radiusSquared = _mm_set1_ps(m_radius * m_radius);
+    const __m128 tMin = _mm_set1_ps(packet.tMin);
+
+    for (int first = 0; first < packet.size; first += 4) {
+        int groupMask = (laneMask >> first) & 0xF;
+        if (groupMask == 0) {
+            continue;
+        }
+
+        __m128 originToCenterX = _mm_sub_ps(centerX, _mm_load_ps(&packet.originX[first]));
+        __m128 originToCenterY = _mm_sub_ps(centerY, _mm_load_ps(&packet.originY[first]));
+        __m128 originToCenterZ = _mm_sub_ps(centerZ, _mm_load_ps(&packet.originZ[first]));
+
+        __m128 tClosestApproach = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(originToCenterX, _mm_load_ps(&packet.directionX[first])),
+            _mm_mul_ps(originToCenterY, _mm_load_ps(&packet.directionY[first]))),
+            _mm_mul_ps(originToCenterZ, _mm_load_ps(&packet.directionZ[first])));
+        __m128 distanceToSurfaceSquared = _mm_sub_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(originToCenterX, originToCenterX),
+            _mm_mul_ps(originToCenterY, originToCenterY)),
+            _mm_mul_ps(originToCenterZ, originToCenterZ)), radiusSquared);
+
+        __m128 discriminant = _mm_sub_ps(_mm_mul_ps(tClosestApproach, tClosestApproach), distanceToSurfaceSquared);
+        __m128 tHalfChord = _mm_sqrt_ps(_mm_max_ps(discriminant, _mm_setzero_ps()));
+
+        __m128 tMax = _mm_load_ps(&packet.tMax[first]);
+        __m128 nearRoot = _mm_sub_ps(tClosestApproach, tHalfChord);
+        __m128 farRoot = _mm_add_ps(tClosestApproach, tHalfChord);
+        __m128 nearInside = _mm_and_ps(_mm_cmpgt_ps(nearRoot, tMin), _mm_cmplt_ps(nearRoot, tMax));
+        __m128 farInside = _mm_and_ps(_mm_cmpgt_ps(farRoot, tMin), _mm_cmplt_ps(farRoot, tMax));
+
+        __m128 root = _mm_or_ps(_mm_and_ps(nearInside, nearRoot), _mm_andnot_ps(nearInside, farRoot));
+        __m128 hit = _mm_and_ps(_mm_cmpge_ps(discriminant, _mm_setzero_ps()), _mm_or_ps(nearInside, farInside));
+
+        int hitMask = _mm_movemask_ps(hit) & groupMask;
+        if (hitMask == 0) {
+            continue;
+        }
+
+        alignas(16) float roots[4];
+        _mm_store_ps(roots, root);
+        for (int i = 0; i < 4; i++) {
+            if ((hitMask & (1 << i)) != 0) {
+                int lane = first + i;
+                packet.tMax[lane] = roots[i];
+                SetHit(packet.GetRay(lane), roots[i], intersectionPoints[lane]);
+            }
+        }
+    }
+#else
+    GeometricObject::HitPacket(packet, laneMask, intersectionPoints);
+#endif
+}
+
+Triangle::Triangle(const Mesh* mesh, int triangle, Color albedo) : Primitive(float3(0.0f), albedo), m_mesh(mesh), m_triangle(triangle) {
+    float3 v0, v1, v2;
+    GetVertices(v0, v1, v2);
+    m_center = (v0 + v1 + v2) * (1.0f / 3.0f);
+
+    // A triangle in an axis-aligned plane has a flat box, which the slab tests never report as hit. A margin a little above the float
+    // precision at the triangle's coordinates keeps it visible
+    float3 min = glm::min(glm::min(v0, v1), v2);
+    float3 max = glm::max(glm::max(v0, v1), v2);
+    float3 magnitude = glm::max(glm::abs(min), glm::abs(max));
+    float padding = 1e-5f * (length(max - min) + std::max(magnitude.x, std::max(magnitude.y, magnitude.z)));
+    m_bbox = AABB(min - float3(padding), max + float3(padding));
+}
+
+void Triangle::GetVertices(float3& v0, float3& v1, float3& v2) const {
+    m_mesh->GetTriangle(m_triangle, v0, v1, v2);
+}
+
+bool Triangle::Hit(const Ray& ray, const Interval& ray_t, IntersectionPoint& intersectionPoint) const {
+
+#ifdef STATS
+    stats->triangleRayIntersectionCounter++;
+#endif
+
+    float3 v0, v1, v2;
+    GetVertices(v0, v1, v2);
+    float3 edge1 = v1 - v0;
+    float3 edge2 = v2 - v0;
+
+    float t;
+    if (!IntersectTriangle(ray, v0, edge1, edge2, ray_t.min, ray_t.max, t)) {
+        return false;
+    }
+
+    intersectionPoint.t = t;
+    intersectionPoint.point = ray.GetPoint(t);
+    intersectionPoint.normal = GetTriangleNormal(ray, edge1, edge2);
+    intersectionPoint.objectID = m_id;
     return true;
 }
 
+bool Triangle::Occluded(const Ray& ray, const Interval& ray_t) const {
+
+#ifdef STATS
+    stats->triangleRayIntersectionCounter++;
+#endif
+
+    float3 v0, v1, v2;
+    GetVertices(v0, v1, v2);
+
+    float t;
+    return IntersectTriangle(ray, v0, v1 - v0, v2 - v0, ray_t.min, ray_t.max, t);
+}
+
+// Same test as IntersectTriangle on 4 lanes at a time
+void Triangle::HitPacket(RayPacket& packet, int laneMask, IntersectionPoint* intersectionPoints) const {
+
+#if defined(__SSE2__) || defined(_M_X64)
+#ifdef STATS
+    // One test per ray, as Hit counts them in the fallback
+    stats->triangleRayIntersectionCounter += std::popcount((uint)laneMask);
+#endif
+
+    float3 v0, v1, v2;
+    GetVertices(v0, v1, v2);
+    float3 edge1 = v1 - v0;
+    float3 edge2 = v2 - v0;
+
+    const __m128 vertexX = _mm_set1_ps(v0.x);
+    const __m128 vertexY = _mm_set1_ps(v0.y);
+    const __m128 vertexZ = _mm_set1_ps(v0.z);
+    const __m128 edge1X = _mm_set1_ps(edge1.x);
+    const __m128 edge1Y = _mm_set1_ps(edge1.y);
+    const __m128 edge1Z = _mm_set1_ps(edge1.z);
+    const __m128 edge2X = _mm_set1_ps(edge2.x);
+    const __m128 edge2Y = _mm_set1_ps(edge2.y);
+    const __m128 edge2Z = _mm_set1_ps(edge2.z);
+    const __m128 tMin = _mm_set1_ps(packet.tMin);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for (int first = 0; first < packet.size; first += 4) {
+        int groupMask = (laneMask >> first) & 0xF;
+        if (groupMask == 0) {
+            continue;
+        }
+
+        __m128 directionX = _mm_load_ps(&packet.directionX[first]);
+        __m128 directionY = _mm_load_ps(&packet.directionY[first]);
+        __m128 directionZ = _mm_load_ps(&packet.directionZ[first]);
+
+        __m128 pX = _mm_sub_ps(_mm_mul_ps(directionY, edge2Z), _mm_mul_ps(directionZ, edge2Y));
+        __m128 pY = _mm_sub_ps(_mm_mul_ps(directionZ, edge2X), _mm_mul_ps(directionX, edge2Z));
+        __m128 pZ = _mm_sub_ps(_mm_mul_ps(directionX, edge2Y), _mm_mul_ps(directionY, edge2X));
+        __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, pX), _mm_mul_ps(edge1Y, pY)), _mm_mul_ps(edge1Z, pZ));
+        __m128 inverseDeterminant = _mm_div_ps(one, determinant);
+
+        __m128 originToVertexX = _mm_sub_ps(_mm_load_ps(&packet.originX[first]), vertexX);
+        __m128 originToVertexY = _mm_sub_ps(_mm_load_ps(&packet.originY[first]), vertexY);
+        __m128 originToVertexZ = _mm_sub_ps(_mm_load_ps(&packet.originZ[first]), vertexZ);
+        __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(originToVertexX, pX),
+            _mm_mul_ps(originToVertexY, pY)),
+            _mm_mul_ps(originToVertexZ, pZ)), inverseDeterminant);
+
+        __m128 qX = _mm_sub_ps(_mm_mul_ps(originToVertexY, edge1Z), _mm_mul_ps(originToVertexZ, edge1Y));
+        __m128 qY = _mm_sub_ps(_mm_mul_ps(originToVertexZ, edge1X), _mm_mul_ps(originToVertexX, edge1Z));
+        __m128 qZ = _mm_sub_ps(_mm_mul_ps(originToVertexX, edge1Y), _mm_mul_ps(originToVertexY, edge1X));
+        __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, qX), _mm_mul_ps(directionY, qY)), _mm_mul_ps(directionZ, qZ)), inverseDeterminant);
+        __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qX), _mm_mul_ps(edge2Y, qY)), _mm_mul_ps(edge2Z, qZ)), inverseDeterminant);
+
+        // Ordered comparisons, the NaNs of rays parallel to the triangle are never a hit
+        __m128 hit = _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero));
+        hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), one));
+        hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpgt_ps(t, tMin), _mm_cmplt_ps(t, _mm_load_ps(&packet.tMax[first]))));
+
+        int hitMask = _mm_movemask_ps(hit) & groupMask;
+        if (hitMask == 0) {
+            continue;
+        }
+
+        alignas(16) float distances[4];
+        _mm_store_ps(distances, t);
+        for (int i = 0; i < 4; i++) {
+            if ((hitMask & (1 << i)) != 0) {
+                int lane = first + i;
+                Ray ray = packet.GetRay(lane);
+                packet.tMax[lane] = distances[i];
+                intersectionPoints[lane].t = distances[i];
+                intersectionPoints[lane].point = ray.GetPoint(distances[i]);
+                intersectionPoints[lane].normal = GetTriangleNormal(ray, edge1, edge2);
+                intersectionPoints[lane].objectID = m_id;
+            }
+        }
+    }
+#else
+    GeometricObject::HitPacket(packet, laneMask, intersectionPoints);
+#endif
+}
+
 //bool Sphere::Hit(const Ray& ray, Interval& ray_t, IntersectionPoint& intersectionPoint) const {
 //    float3 oc = center - ray.origin;
 //    float tca = dot(oc, ray.direction);
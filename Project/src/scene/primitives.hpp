@@ -1,12 +1,15 @@
 #pragma once
 #include "geometry.hpp"
 
+class Mesh;
+
 class Primitive : public GeometricObject {
 public:
 	Primitive(float3 position, Color albedo);
 	~Primitive() = default;
 
 	Color GetAlbedo() const;
+	float3 GetCenter() const { return m_center; }
 	void SetID(uint id);
 	uint GetID() const;
 
@@ -22,7 +25,33 @@ public:
 	~Sphere() = default;
 
 	bool Hit(const Ray& ray, const Interval& ray_t, IntersectionPoint& intersectionPoint) const override;
+	bool Occluded(const Ray& ray, const Interval& ray_t) const override;
+	void HitPacket(RayPacket& packet, int laneMask, IntersectionPoint* intersectionPoints) const override;
+
+	float GetRadius() const { return m_radius; }
+	// Use Scene::SetSphereCenter for spheres in a scene, it also updates the scene's copy
+	void SetCenter(const float3& center);
 
 private:
 	float m_radius;
+
+	void SetHit(const Ray& ray, float t, IntersectionPoint& intersectionPoint) const;
+};
+
+// One triangle of a Mesh, which has to outlive it. The vertices are read through the mesh's index array on every test, the BVH gathers
+// them into a TriangleSoA for the fast path
+class Triangle : public Primitive {
+public:
+	Triangle(const Mesh* mesh, int triangle, Color albedo = COLOR_GREY);
+	~Triangle() = default;
+
+	bool Hit(const Ray& ray, const Interval& ray_t, IntersectionPoint& intersectionPoint) const override;
+	bool Occluded(const Ray& ray, const Interval& ray_t) const override;
+	void HitPacket(RayPacket& packet, int laneMask, IntersectionPoint* intersectionPoints) const override;
+
+	void GetVertices(float3& v0, float3& v1, float3& v2) const;
+
+private:
+	const Mesh* m_mesh;
+	int m_triangle;
 };
\ No newline at end of file
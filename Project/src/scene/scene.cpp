@@ -1,12 +1,15 @@
 #include "scene.hpp"
+#include "instance.hpp"
 
-Scene::Scene() {
-    AddPrimitive(std::make_shared<Sphere>(float3(-3.f, 0.0f, 4.0f), 1.f));
-    AddPrimitive(std::make_shared<Sphere>(float3(0.0f, 0.0f, 4.0f), 1.f, COLOR_GREEN));
-    AddPrimitive(std::make_shared<Sphere>(float3(3.f, 0.0f, 4.0f), 1.f, COLOR_BLUE));
-    AddPrimitive(std::make_shared<Sphere>(float3(0.f, -3.0f, 4.0f), 1.f, COLOR_LIGHTBLUE));
-    AddPrimitive(std::make_shared<Sphere>(float3(0.f, 3.0f, 4.0f), 1.f, COLOR_WHITE));
-    m_lights.push_back(new Light(float3(0.0f, 0.0f, 0.f), float3(20.0f, 20.0f, 20.0f)));
+Scene* Scene::CreateDefault() {
+    Scene* scene = new Scene();
+    scene->AddPrimitive(std::make_shared<Sphere>(float3(-3.f, 0.0f, 4.0f), 1.f));
+    scene->AddPrimitive(std::make_shared<Sphere>(float3(0.0f, 0.0f, 4.0f), 1.f, COLOR_GREEN));
+    scene->AddPrimitive(std::make_shared<Sphere>(float3(3.f, 0.0f, 4.0f), 1.f, COLOR_BLUE));
+    scene->AddPrimitive(std::make_shared<Sphere>(float3(0.f, -3.0f, 4.0f), 1.f, COLOR_LIGHTBLUE));
+    scene->AddPrimitive(std::make_shared<Sphere>(float3(0.f, 3.0f, 4.0f), 1.f, COLOR_WHITE));
+    scene->AddLight(new Light(float3(0.0f, 0.0f, 0.f), float3(20.0f, 20.0f, 20.0f)));
+    return scene;
 }
 
 Scene::~Scene() {
@@ -16,6 +19,16 @@ Scene::~Scene() {
         delete light;
     }
     m_lights.clear();
+
+    for (Mesh* mesh : m_meshes) {
+        delete mesh;
+    }
+    m_meshes.clear();
+
+    for (InstancedMesh* instancedMesh : m_instancedMeshes) {
+        delete instancedMesh;
+    }
+    m_instancedMeshes.clear();
 }
 
 void Scene::AddPrimitive(std::shared_ptr<Primitive> primitiveObject)
@@ -24,5 +37,77 @@ void Scene::AddPrimitive(std::shared_ptr<Primitive> primitiveObject)
     m_objects.push_back(primitiveObject);
     m_bbox = AABB(m_bbox, primitiveObject->GetBoundingBox());
 
+    if (const Sphere* sphere = dynamic_cast<const Sphere*>(primitiveObject.get())) {
+        m_spheres.Add(sphere->GetCenter(), sphere->GetRadius(), GetAlbedoIndex(sphere->GetAlbedo()), primitiveCount);
+    }
+
     primitiveCount++;
+}
+
+void Scene::Reserve(int primitiveCount)
+{
+    m_objects.reserve(primitiveCount);
+    m_spheres.Reserve(primitiveCount);
+}
+
+void Scene::AddLight(Light* light)
+{
+    m_lights.push_back(light);
+}
+
+void Scene::AddMesh(Mesh* mesh, Color albedo)
+{
+    m_meshes.push_back(mesh);
+    Reserve((int)m_objects.size() + mesh->GetTriangleCount());
+    for (int i = 0; i < mesh->GetTriangleCount(); i++) {
+        AddPrimitive(std::make_shared<Triangle>(mesh, i, albedo));
+    }
+}
+
+int Scene::AddInstancedMesh(Mesh* mesh)
+{
+    m_instancedMeshes.push_back(new InstancedMesh(mesh));
+    return (int)m_instancedMeshes.size() - 1;
+}
+
+void Scene::AddInstance(int meshIndex, const Transform& objectToWorld, Color albedo)
+{
+    AddPrimitive(std::make_shared<Instance>(m_instancedMeshes[meshIndex], objectToWorld, albedo));
+}
+
+void Scene::SetSphereCenter(int objectID, const float3& center)
+{
+    if (m_spheres.IsMapped()) {
+        spdlog::error("Spheres of a scene loaded from a cache cannot move");
+        return;
+    }
+
+    Sphere* sphere = dynamic_cast<Sphere*>(m_objects[objectID].get());
+    if (sphere == nullptr) {
+        spdlog::error("Object {} is not a sphere", objectID);
+        return;
+    }
+
+    sphere->SetCenter(center);
+    m_spheres.SetCenter(m_spheres.FindObject(objectID), center);
+    m_bbox = AABB(m_bbox, sphere->GetBoundingBox());
+}
+
+Color Scene::GetAlbedo(int objectID) const
+{
+    // Cached scenes number their spheres in SoA order
+    if (m_objects.empty()) {
+        return m_albedoPalette[m_spheres.GetAlbedoIndex(objectID)];
+    }
+    return m_objects[objectID]->GetAlbedo();
+}
+
+int Scene::GetAlbedoIndex(const Color& albedo)
+{
+    std::array<float, 4> key = { albedo.r, albedo.g, albedo.b, albedo.a };
+    auto [it, inserted] = m_albedoIndices.try_emplace(key, (int)m_albedoPalette.size());
+    if (inserted) {
+        m_albedoPalette.push_back(albedo);
+    }
+    return it->second;
 }
\ No newline at end of file
@@ -1,25 +1,75 @@
 #pragma once
 #include "primitives.hpp"
+#include "mesh.hpp"
 #include "lights.hpp"
+#include "sphere_soa.hpp"
+#include "../utils/mapped_file.hpp"
+#include <array>
+#include <map>
 #include "../raytracing/acceleration_structures/aabb.hpp"
 
+// instance.hpp includes the BVH headers, which include this one
+class InstancedMesh;
+struct Transform;
+
 class Scene {
 public:
-	Scene();
+	// Starts empty, CreateDefault gives the five spheres and one light the app shows
+	Scene() = default;
 	~Scene();
+	static Scene* CreateDefault();
+
+	void AddPrimitive(std::shared_ptr<Primitive> primitiveObject);
+	void Reserve(int primitiveCount);
+	// The scene takes ownership of the light
+	void AddLight(Light* light);
+	// The scene takes ownership of the mesh, each of its triangles is added as a primitive
+	void AddMesh(Mesh* mesh, Color albedo = COLOR_GREY);
+	// Two-level alternative to AddMesh for repeated geometry: the mesh gets its own BVH, built here, and is only placed by AddInstance,
+	// which adds one primitive however many triangles it has. The scene takes ownership, returns the index AddInstance takes
+	int AddInstancedMesh(Mesh* mesh);
+	void AddInstance(int meshIndex, const Transform& objectToWorld, Color albedo = COLOR_GREY);
+	const vector<InstancedMesh*>& GetInstancedMeshes() const { return m_instancedMeshes; }
+
+	// Moves the sphere with this ID and the scene's copy of it. Renders only see the move once RayTracer::UpdateBVH has run, as for
+	// instances moved with Instance::SetTransform
+	void SetSphereCenter(int objectID, const float3& center);
+
+	// Where the camera sits, it always looks down +z. The default suits the built-in and generated scenes, loaded ones move it to frame their contents
+	void SetCameraPosition(const float3& position) { m_cameraPosition = position; }
+	float3 GetCameraPosition() const { return m_cameraPosition; }
+	const AABB& GetBoundingBox() const { return m_bbox; }
 
 	const vector<Light*>& GetLights() const { return m_lights; }
+	// Empty for a scene loaded from a SceneCache, which only has the sphere data
 	const vector<std::shared_ptr<Primitive>>& GetObjects() const { return m_objects; }
 
 	vector<std::shared_ptr<Primitive>> GetObjectsCopy() const { return m_objects;  }
-	int GetObjectsCount() const { return m_objects.size(); }
+	int GetObjectsCount() const { return (int)primitiveCount; }
+	Color GetAlbedo(int objectID) const;
+
+	// Spheres are also kept per component for the SIMD kernels, with their albedo as an index into a palette of distinct colors
+	const SphereSoA& GetSphereData() const { return m_spheres; }
+	const vector<Color>& GetAlbedoPalette() const { return m_albedoPalette; }
 
 private:
 	vector<std::shared_ptr<Primitive>> m_objects;
 	vector<Light*> m_lights;
+	vector<Mesh*> m_meshes;
+	vector<InstancedMesh*> m_instancedMeshes;
+	float3 m_cameraPosition = float3(0.0f, 0.0f, -2.0f);
+
+	SphereSoA m_spheres;
+	vector<Color> m_albedoPalette;
+	std::map<std::array<float, 4>, int> m_albedoIndices;
 
 	AABB m_bbox;
 	uint primitiveCount = 0;
 
-	void AddPrimitive(std::shared_ptr<Primitive> primitiveObject);
+	// A cached scene's sphere data points into this file
+	MappedFile m_cacheFile;
+
+	int GetAlbedoIndex(const Color& albedo);
+
+	friend class SceneCache;
 };
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include "scene_cache.hpp"
+
+// Layout (little endian): the header, then the lights (position and color), the albedo palette (rgba), the BVH nodes and the leaf-order
+// sphere arrays, each section starting on a cache line. Bump the version whenever the layout, the generators or the builder change,
+// files of another version are rebuilt
+struct SceneCacheHeader {
+	char magic[4];
+	uint version;
+	std::uint64_t key;
+	float cameraPosition[3];
+	float boundsMin[3];
+	float boundsMax[3];
+	uint lightCount;
+	uint paletteCount;
+	uint sphereCount;
+	uint nodeCount;
+};
+
+// Byte offsets of the sections, and the size of the whole file
+struct SceneCacheLayout {
+	size_t lights;
+	size_t palette;
+	size_t nodes;
+	size_t spheres;
+	size_t size;
+};
+
+static constexpr char SCENE_CACHE_MAGIC[4] = { 'T', 'S', 'C', 'N' };
+static constexpr uint SCENE_CACHE_VERSION = 1;
+static constexpr size_t SECTION_ALIGNMENT = 64;
+
+static size_t AlignSection(size_t offset) {
+	return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+static SceneCacheLayout GetLayout(const SceneCacheHeader& header) {
+	SceneCacheLayout layout;
+	layout.lights = AlignSection(sizeof(SceneCacheHeader));
+	layout.palette = AlignSection(layout.lights + (size_t)header.lightCount * 6 * sizeof(float));
+	layout.nodes = AlignSection(layout.palette + (size_t)header.paletteCount * 4 * sizeof(float));
+	layout.spheres = AlignSection(layout.nodes + (size_t)header.nodeCount * sizeof(LinearBVHNode));
+	layout.size = layout.spheres + SphereSoA::GetByteSize((int)header.sphereCount);
+	return layout;
+}
+
+// Zeroes up to the start of the next section
+static void WritePadding(std::ofstream& file, size_t offset) {
+	static const char zeros[SECTION_ALIGNMENT] = {};
+	file.write(zeros, (std::streamsize)(offset - (size_t)file.tellp()));
+}
+
+// FNV-1a over the bytes of value
+template<typename T>
+static void Hash(std::uint64_t& hash, const T& value) {
+	const uchar* bytes = (const uchar*)&value;
+	for (size_t i = 0; i < sizeof(T); i++) {
+		hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+	}
+}
+
+std::uint64_t SceneCache::GetKey(const SceneSettings& scene, const BVHBuildSettings& bvh) {
+	// The thread counts and the update settings leave the built tree as it is
+	std::uint64_t hash = 0xcbf29ce484222325ull;
+	Hash(hash, SCENE_CACHE_VERSION);
+	Hash(hash, scene.type);
+	Hash(hash, scene.primitiveCount);
+	Hash(hash, scene.lightCount);
+	Hash(hash, scene.seed);
+	Hash(hash, bvh.builder);
+	Hash(hash, bvh.binCount);
+	Hash(hash, bvh.maxLeafSize);
+	Hash(hash, bvh.traversalCost);
+	Hash(hash, bvh.intersectionCost);
+	return hash;
+}
+
+bool SceneCache::IsSupported(SceneType type) {
+	return type != SceneType::Mesh && type != SceneType::Instances;
+}
+
+bool SceneCache::Save(const std::filesystem::path& path, std::uint64_t key, const Scene& scene, const LinearBVH& bvh) {
+	const SphereSoA& leafSpheres = bvh.GetSphereData();
+	if (!bvh.HasSphereLeaves() || leafSpheres.Size() != scene.GetObjectsCount()) {
+		spdlog::error("Only scenes of spheres can be cached, with a BVH over all of them");
+		return false;
+	}
+
+	// Written next to the cache and renamed over it once complete, so a run that stops halfway (or another run loading it) never sees
+	// a partial file
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp";
+	std::ofstream file(tempPath, std::ios::binary);
+	if (!file) {
+		spdlog::error("Cannot open {} for writing", tempPath.string());
+		return false;
+	}
+
+	SceneCacheHeader header = {};
+	std::memcpy(header.magic, SCENE_CACHE_MAGIC, sizeof(header.magic));
+	header.version = SCENE_CACHE_VERSION;
+	header.key = key;
+	const AABB& bbox = scene.GetBoundingBox();
+	for (int axis = 0; axis < 3; axis++) {
+		header.cameraPosition[axis] = scene.GetCameraPosition()[axis];
+		header.boundsMin[axis] = bbox.GetAxis(axis).min;
+		header.boundsMax[axis] = bbox.GetAxis(axis).max;
+	}
+	header.lightCount = (uint)scene.GetLights().size();
+	header.paletteCount = (uint)scene.GetAlbedoPalette().size();
+	header.sphereCount = (uint)leafSpheres.Size();
+	header.nodeCount = (uint)bvh.GetNodeCount();
+	SceneCacheLayout layout = GetLayout(header);
+
+	file.write((const char*)&header, sizeof(header));
+	WritePadding(file, layout.lights);
+	for (const Light* light : scene.GetLights()) {
+		float values[6] = { light->position.x, light->position.y, light->position.z, light->color.x, light->color.y, light->color.z };
+		file.write((const char*)values, sizeof(values));
+	}
+	WritePadding(file, layout.palette);
+	for (const Color& albedo : scene.GetAlbedoPalette()) {
+		float values[4] = { albedo.r, albedo.g, albedo.b, albedo.a };
+		file.write((const char*)values, sizeof(values));
+	}
+	WritePadding(file, layout.nodes);
+	file.write((const char*)bvh.GetNodes(), (std::streamsize)header.nodeCount * sizeof(LinearBVHNode));
+	WritePadding(file, layout.spheres);
+
+	// Hits report the leaf index as the object, so the loaded scene needs no table from IDs to spheres
+	SphereSoA spheres = leafSpheres;
+	spheres.RenumberObjects();
+	spheres.Write(file);
+	file.close();
+
+	std::error_code error;
+	if (!file) {
+		spdlog::error("Cannot write {}", tempPath.string());
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		spdlog::error("Cannot move {} to {}: {}", tempPath.string(), path.string(), error.message());
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	spdlog::info("Scene cache saved to {} | Spheres: {} | Nodes: {} | Size: {} MB", path.string(), header.sphereCount, header.nodeCount,
+		layout.size / (1024 * 1024));
+	return true;
+}
+
+Scene* SceneCache::Load(const std::filesystem::path& path, std::uint64_t key, LinearBVH*& bvh) {
+	PROFILE_SCOPE("Load scene cache");
+	auto start = std::chrono::steady_clock::now();
+	bvh = nullptr;
+
+	std::error_code error;
+	if (!std::filesystem::exists(path, error)) {
+		spdlog::info("No scene cache at {} yet", path.string());
+		return nullptr;
+	}
+
+	Scene* scene = new Scene();
+	MappedFile& file = scene->m_cacheFile;
+	if (!file.Open(path)) {
+		delete scene;
+		return nullptr;
+	}
+
+	SceneCacheHeader header;
+	bool valid = file.GetSize() >= sizeof(header);
+	if (valid) {
+		std::memcpy(&header, file.GetData(), sizeof(header));
+		valid = std::memcmp(header.magic, SCENE_CACHE_MAGIC, sizeof(header.magic)) == 0 && header.version == SCENE_CACHE_VERSION &&
+			header.sphereCount <= INT_MAX && header.nodeCount <= INT_MAX && file.GetSize() == GetLayout(header).size;
+	}
+	if (!valid || header.key != key) {
+		spdlog::info("Scene cache {} is {}", path.string(), valid ? "for other settings" : fmt::format("not a version {} scene cache", SCENE_CACHE_VERSION));
+		delete scene;
+		return nullptr;
+	}
+
+	// Only the small sections are copied, the nodes and spheres are used where they are mapped. Their contents are trusted, checking
+	// them would read the whole file
+	SceneCacheLayout layout = GetLayout(header);
+	const uchar* data = file.GetData();
+	const float* lights = (const float*)(data + layout.lights);
+	for (uint i = 0; i < header.lightCount; i++, lights += 6) {
+		scene->AddLight(new Light(float3(lights[0], lights[1], lights[2]), float3(lights[3], lights[4], lights[5])));
+	}
+	const float* palette = (const float*)(data + layout.palette);
+	for (uint i = 0; i < header.paletteCount; i++, palette += 4) {
+		scene->m_albedoPalette.push_back(Color(palette[0], palette[1], palette[2], palette[3]));
+	}
+
+	scene->m_cameraPosition = float3(header.cameraPosition[0], header.cameraPosition[1], header.cameraPosition[2]);
+	scene->m_bbox = AABB(float3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]),
+		float3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]));
+	scene->m_spheres.Map(data + layout.spheres, (int)header.sphereCount);
+	scene->primitiveCount = header.sphereCount;
+	bvh = new LinearBVH((const LinearBVHNode*)(data + layout.nodes), (int)header.nodeCount, scene->m_spheres);
+
+	auto end = std::chrono::steady_clock::now();
+	std::chrono::duration<double> duration = end - start;
+	spdlog::info("Timer | Scene cache load: {} | File: {} | Spheres: {} | Nodes: {} | Lights: {}", duration.count(), path.filename().string(),
+		header.sphereCount, header.nodeCount, header.lightCount);
+	return scene;
+}
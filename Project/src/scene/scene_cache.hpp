@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include "scene.hpp"
+#include "scene_generator.hpp"
+#include "../raytracing/acceleration_structures/sah_builder.hpp"
+
+// Binary copy of a generated sphere scene together with its built BVH, so a later run with the same settings skips generating the
+// scene and building the tree. The file is mapped and used in place: loading reads the header and the lights, the nodes and spheres
+// are only paged in when rays reach them.
+// Scenes are identified by a key hashed from everything they and their tree are made from, a file with another key or version is stale.
+// Loaded scenes are static (no Scene::SetSphereCenter or RayTracer::UpdateBVH), and number their spheres in leaf order
+class SceneCache {
+public:
+	static std::uint64_t GetKey(const SceneSettings& scene, const BVHBuildSettings& bvh);
+	// Only the generated sphere scenes, meshes have their own binary format (.tmesh)
+	static bool IsSupported(SceneType type);
+
+	// Needs a scene of spheres only, and bvh built over them with GatherSphereData
+	static bool Save(const std::filesystem::path& path, std::uint64_t key, const Scene& scene, const LinearBVH& bvh);
+	// nullptr if there is no valid cache with this key at path, the reason is logged. bvh receives the tree, which views the scene's
+	// mapped file: delete it before the scene
+	static Scene* Load(const std::filesystem::path& path, std::uint64_t key, LinearBVH*& bvh);
+};
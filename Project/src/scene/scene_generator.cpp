@@ -0,0 +1,285 @@
+#include <chrono>
+#include "scene_generator.hpp"
+#include "scene.hpp"
+#include "instance.hpp"
+
+static constexpr float SPHERE_RADIUS = 0.5f;
+// The default scene's light gives 20 at a distance of 4, generated lights are scaled to give the same at the middle of the cube
+static constexpr float LIGHT_INTENSITY_AT_CENTER = 20.0f / 16.0f;
+
+static const Color PALETTE[] = { COLOR_RED, COLOR_GREEN, COLOR_BLUE, COLOR_LIGHTBLUE, COLOR_WHITE };
+
+// The default camera sits at (0, 0, -2) looking down +z with a 90 degree field of view. Keeping the front face of the cube
+// side / 2 + 1 away from it keeps the whole cube in view
+static float3 GetCubeCenter(float side) {
+	return float3(0.0f, 0.0f, side - 1.0f);
+}
+
+static float3 RandomInCube(RandomGenerator& random) {
+	return float3(random.NextFloat() - 0.5f, random.NextFloat() - 0.5f, random.NextFloat() - 0.5f);
+}
+
+static float3 RandomGaussian(RandomGenerator& random) {
+	// Box-Muller, 1 - u keeps the logarithm finite
+	float radius = std::sqrt(-2.0f * std::log(1.0f - random.NextFloat()));
+	float angle = 2.0f * PI * random.NextFloat();
+	float radius2 = std::sqrt(-2.0f * std::log(1.0f - random.NextFloat()));
+	float angle2 = 2.0f * PI * random.NextFloat();
+	return float3(radius * std::cos(angle), radius * std::sin(angle), radius2 * std::cos(angle2));
+}
+
+static float3 RandomDirection(RandomGenerator& random) {
+	float z = 2.0f * random.NextFloat() - 1.0f;
+	float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+	float phi = 2.0f * PI * random.NextFloat();
+	return float3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+static void AddSphere(Scene& scene, const float3& center, RandomGenerator& random) {
+	scene.AddPrimitive(std::make_shared<Sphere>(center, SPHERE_RADIUS, PALETTE[random.NextUint() % 5]));
+}
+
+static void AddUniformSpheres(Scene& scene, int count, float side, RandomGenerator& random) {
+	float3 center = GetCubeCenter(side);
+	for (int i = 0; i < count; i++) {
+		AddSphere(scene, center + RandomInCube(random) * side, random);
+	}
+}
+
+// sqrt(count) / 4 clusters of about 4 sqrt(count) spheres each, together they take up about a tenth of the cube
+static void AddClusteredSpheres(Scene& scene, int count, float side, RandomGenerator& random) {
+	float3 center = GetCubeCenter(side);
+	int clusterCount = std::max(1, (int)std::sqrt((float)count) / 4);
+	float sigma = 0.5f * side / std::cbrt(10.0f * clusterCount);
+
+	vector<float3> clusterCenters;
+	for (int i = 0; i < clusterCount; i++) {
+		clusterCenters.push_back(center + RandomInCube(random) * (side - 4.0f * sigma));
+	}
+
+	for (int i = 0; i < count; i++) {
+		const float3& clusterCenter = clusterCenters[random.NextUint() % clusterCount];
+		AddSphere(scene, clusterCenter + RandomGaussian(random) * sigma, random);
+	}
+}
+
+// Filled in x, then y, then z, so a count that is not a cube leaves the back layer partly empty
+static void AddGridSpheres(Scene& scene, int count, float side, RandomGenerator& random) {
+	int cellsPerSide = (int)std::ceil(std::cbrt((double)count) - 1e-6);
+	float spacing = side / cellsPerSide;
+	float3 first = GetCubeCenter(side) - float3(0.5f * side - 0.5f * spacing);
+
+	for (int i = 0; i < count; i++) {
+		int x = i % cellsPerSide;
+		int y = (i / cellsPerSide) % cellsPerSide;
+		int z = i / (cellsPerSide * cellsPerSide);
+		AddSphere(scene, first + float3((float)x, (float)y, (float)z) * spacing, random);
+	}
+}
+
+// Shell k of n has radius k / n of the outer one and gets spheres in proportion to its volume, which roughly keeps the density on
+// every shell the same
+static void AddShellSpheres(Scene& scene, int count, float side, RandomGenerator& random) {
+	float3 center = GetCubeCenter(side);
+	int shellCount = std::max(1, (int)(std::cbrt((float)count) / 4.0f));
+
+	for (int i = 0; i < count; i++) {
+		int shell = std::min(shellCount, 1 + (int)(shellCount * std::cbrt(random.NextFloat())));
+		float radius = 0.5f * side * shell / shellCount;
+		AddSphere(scene, center + RandomDirection(random) * radius, random);
+	}
+}
+
+// Above the camera, so the scene casts shadows towards the bottom of the image. Scaled by the distance to the center of the scene
+static void AddLightAboveCamera(Scene& scene, const float3& center, float height) {
+	float3 position = scene.GetCameraPosition() + float3(0.0f, height, 0.0f);
+	float3 toCenter = center - position;
+	float intensity = LIGHT_INTENSITY_AT_CENTER * dot(toCenter, toCenter);
+	scene.AddLight(new Light(position, float3(intensity)));
+}
+
+static void AddLights(Scene& scene, int count, float side, RandomGenerator& random) {
+	float3 center = GetCubeCenter(side);
+
+	if (count == 1) {
+		AddLightAboveCamera(scene, center, 0.5f * side);
+		return;
+	}
+
+	// Spread through the cube, a sphere is mostly lit by the few lights close to it
+	float intensity = LIGHT_INTENSITY_AT_CENTER * side * side / count;
+	for (int i = 0; i < count; i++) {
+		scene.AddLight(new Light(center + RandomInCube(random) * side, float3(intensity)));
+	}
+}
+
+// The camera looks down +z with a 90 degree vertical field of view, so it sees as far up and down as it is away. It is moved that far
+// back from the front of the mesh's box (plus a margin), centered on the box
+static bool AddMesh(Scene& scene, const SceneSettings& settings) {
+	Mesh* mesh = Mesh::Load(settings.meshPath);
+	if (mesh == nullptr) {
+		return false;
+	}
+	scene.AddMesh(mesh);
+
+	const AABB& bbox = scene.GetBoundingBox();
+	float3 min = float3(bbox.GetAxis(0).min, bbox.GetAxis(1).min, bbox.GetAxis(2).min);
+	float3 max = float3(bbox.GetAxis(0).max, bbox.GetAxis(1).max, bbox.GetAxis(2).max);
+	float3 center = 0.5f * (min + max);
+	float distance = std::max(1.1f * 0.5f * std::max(max.x - min.x, max.y - min.y), 1e-3f);
+
+	scene.SetCameraPosition(float3(center.x, center.y, min.z - distance));
+	AddLightAboveCamera(scene, center, distance);
+	return true;
+}
+
+// Ring around the z axis through the origin, made of rings x sides quads of two triangles each
+static Mesh* CreateTorus(float majorRadius, float minorRadius, int rings, int sides) {
+	vector<float3> vertices;
+	vector<uint> indices;
+	for (int ring = 0; ring < rings; ring++) {
+		float u = 2.0f * PI * ring / rings;
+		for (int side = 0; side < sides; side++) {
+			float v = 2.0f * PI * side / sides;
+			float radius = majorRadius + minorRadius * std::cos(v);
+			vertices.push_back(float3(radius * std::cos(u), radius * std::sin(u), minorRadius * std::sin(v)));
+		}
+	}
+
+	for (int ring = 0; ring < rings; ring++) {
+		int nextRing = (ring + 1) % rings;
+		for (int side = 0; side < sides; side++) {
+			int nextSide = (side + 1) % sides;
+			uint quad[4] = { (uint)(ring * sides + side), (uint)(nextRing * sides + side), (uint)(nextRing * sides + nextSide), (uint)(ring * sides + nextSide) };
+			indices.insert(indices.end(), { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] });
+		}
+	}
+	return new Mesh(std::move(vertices), std::move(indices));
+}
+
+static bool AddInstances(Scene& scene, const SceneSettings& settings, int count, float side, RandomGenerator& random) {
+	if (!settings.meshPath.empty()) {
+		Mesh* mesh = Mesh::Load(settings.meshPath);
+		if (mesh == nullptr) {
+			return false;
+		}
+		scene.AddInstancedMesh(mesh);
+	}
+	else {
+		for (float minorRadius : { 0.15f, 0.3f, 0.45f }) {
+			scene.AddInstancedMesh(CreateTorus(1.0f, minorRadius, 48, 24));
+		}
+	}
+
+	// Centers every mesh on the origin and scales its longest side to a sphere's diameter
+	vector<Transform> toSphereSize;
+	for (const InstancedMesh* instancedMesh : scene.GetInstancedMeshes()) {
+		const AABB& bbox = instancedMesh->GetBoundingBox();
+		float3 min = float3(bbox.GetAxis(0).min, bbox.GetAxis(1).min, bbox.GetAxis(2).min);
+		float3 max = float3(bbox.GetAxis(0).max, bbox.GetAxis(1).max, bbox.GetAxis(2).max);
+		float3 extent = max - min;
+		float scale = 2.0f * SPHERE_RADIUS / std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+		toSphereSize.push_back(Transform::Scale(float3(scale)) * Transform::Translation(-0.5f * (min + max)));
+	}
+
+	float3 center = GetCubeCenter(side);
+	int meshCount = (int)toSphereSize.size();
+	for (int i = 0; i < count; i++) {
+		int mesh = (int)(random.NextUint() % meshCount);
+		Transform rotation = Transform::Rotation(RandomDirection(random), 2.0f * PI * random.NextFloat());
+		Transform objectToWorld = Transform::Translation(center + RandomInCube(random) * side) * rotation * toSphereSize[mesh];
+		scene.AddInstance(mesh, objectToWorld, PALETTE[random.NextUint() % 5]);
+	}
+	return true;
+}
+
+Scene* SceneGenerator::Generate(const SceneSettings& settings) {
+	if (settings.type == SceneType::Default) {
+		return Scene::CreateDefault();
+	}
+
+	PROFILE_SCOPE("Generate scene");
+	auto start = std::chrono::steady_clock::now();
+
+	int count = settings.primitiveCount;
+	float side = 4.0f * std::cbrt((float)count);
+	RandomGenerator random(settings.seed, 0, 0);
+
+	Scene* scene = new Scene();
+	scene->Reserve(count);
+
+	switch (settings.type) {
+	case SceneType::Uniform:
+	case SceneType::ManyLights:
+		AddUniformSpheres(*scene, count, side, random);
+		break;
+	case SceneType::Clustered:
+		AddClusteredSpheres(*scene, count, side, random);
+		break;
+	case SceneType::Grid:
+		AddGridSpheres(*scene, count, side, random);
+		break;
+	case SceneType::Shells:
+		AddShellSpheres(*scene, count, side, random);
+		break;
+	case SceneType::Mesh:
+		if (!AddMesh(*scene, settings)) {
+			delete scene;
+			return nullptr;
+		}
+		break;
+	case SceneType::Instances:
+		if (!AddInstances(*scene, settings, count, side, random)) {
+			delete scene;
+			return nullptr;
+		}
+		break;
+	default:
+		break;
+	}
+
+	// The mesh scene has its light already
+	if (settings.type != SceneType::Mesh) {
+		AddLights(*scene, settings.type == SceneType::ManyLights ? settings.lightCount : 1, side, random);
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	std::chrono::duration<double> duration = end - start;
+	spdlog::info("Timer | Scene generation: {} | Scene: {} | Primitives: {} | Lights: {}", duration.count(), GetName(settings.type), scene->GetObjectsCount(),
+		scene->GetLights().size());
+	return scene;
+}
+
+cstring SceneGenerator::GetName(SceneType type) {
+	switch (type) {
+	case SceneType::Default:
+		return "default";
+	case SceneType::Uniform:
+		return "uniform";
+	case SceneType::Clustered:
+		return "clustered";
+	case SceneType::Grid:
+		return "grid";
+	case SceneType::Shells:
+		return "shells";
+	case SceneType::ManyLights:
+		return "manylights";
+	case SceneType::Mesh:
+		return "mesh";
+	case SceneType::Instances:
+		return "instances";
+	}
+	return "unknown";
+}
+
+bool SceneGenerator::ParseType(cstring name, SceneType& type) {
+	static const SceneType types[] = { SceneType::Default, SceneType::Uniform, SceneType::Clustered, SceneType::Grid, SceneType::Shells, SceneType::ManyLights,
+		SceneType::Mesh, SceneType::Instances };
+	for (SceneType candidate : types) {
+		if (IsStringEqual(name, GetName(candidate))) {
+			type = candidate;
+			return true;
+		}
+	}
+	return false;
+}
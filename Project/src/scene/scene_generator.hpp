@@ -0,0 +1,45 @@
+#pragma once
+
+class Scene;
+
+enum class SceneType {
+	Default,
+	Uniform,
+	Clustered,
+	Grid,
+	Shells,
+	ManyLights,
+	Mesh,
+	Instances
+};
+
+// Which scene a Core renders. Everything but Default is generated from the seed, so the same settings always give the same scene
+struct SceneSettings {
+	SceneType type = SceneType::Default;
+	int primitiveCount = 10000;
+	// Only ManyLights scatters lights through the scene, the others have a single light above the camera
+	int lightCount = 64;
+	uint seed = 0;
+	// .obj or .tmesh file the Mesh scene loads, and Instances places copies of (optional for Instances)
+	string meshPath;
+};
+
+// Procedural sphere scenes for scaling and stress tests, from 1 to 10M spheres of radius 0.5. The spheres fill a cube in front of the
+// default camera whose side grows with the cube root of the count, so every scene covers a similar part of the image and is about 1%
+// solid whatever its size:
+//   Uniform:    scattered evenly through the cube
+//   Clustered:  gaussian clumps around random centers, dense and overlapping where uniform is sparse
+//   Grid:       a regular lattice, many rays see the same number of spheres in the same order
+//   Shells:     concentric hollow shells, most spheres are hidden behind the outer one
+//   ManyLights: the uniform spheres with lightCount lights scattered through the cube
+// Mesh is not generated but loaded from meshPath, with the camera moved back until the whole mesh is in view and a light above it.
+// Instances scatters primitiveCount copies of the meshPath mesh, or of three procedural tori without one, through the cube like Uniform.
+// Each is randomly turned and scaled to the size of a sphere, and all of them share one BVH per mesh
+class SceneGenerator {
+public:
+	// nullptr if the mesh cannot be loaded, the error is logged
+	static Scene* Generate(const SceneSettings& settings);
+	static cstring GetName(SceneType type);
+	// False when name is none of the GetName names
+	static bool ParseType(cstring name, SceneType& type);
+};
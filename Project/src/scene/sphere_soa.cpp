@@ -0,0 +1,272 @@
+#include "sphere_soa.hpp"
+#include <algorithm>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX__)
+static constexpr int SIMD_WIDTH = 8;
+#elif defined(__SSE2__) || defined(_M_X64)
+static constexpr int SIMD_WIDTH = 4;
+#else
+static constexpr int SIMD_WIDTH = 1;
+#endif
+
+SphereSoA::SphereSoA() {
+    Clear();
+}
+
+SphereSoA::SphereSoA(const SphereSoA& other) {
+    *this = other;
+}
+
+SphereSoA& SphereSoA::operator=(const SphereSoA& other) {
+    m_ownedCenterX = other.m_ownedCenterX;
+    m_ownedCenterY = other.m_ownedCenterY;
+    m_ownedCenterZ = other.m_ownedCenterZ;
+    m_ownedRadiusSquared = other.m_ownedRadiusSquared;
+    m_ownedAlbedoIndex = other.m_ownedAlbedoIndex;
+    m_ownedObjectID = other.m_ownedObjectID;
+    m_size = other.m_size;
+    m_isMapped = other.m_isMapped;
+
+    if (m_isMapped) {
+        m_centerX = other.m_centerX;
+        m_centerY = other.m_centerY;
+        m_centerZ = other.m_centerZ;
+        m_radiusSquared = other.m_radiusSquared;
+        m_albedoIndex = other.m_albedoIndex;
+        m_objectID = other.m_objectID;
+    }
+    else {
+        PointAtOwnedArrays();
+    }
+    return *this;
+}
+
+// The vectors can reallocate on every change, so the pointers are refreshed after each one
+void SphereSoA::PointAtOwnedArrays() {
+    m_centerX = m_ownedCenterX.data();
+    m_centerY = m_ownedCenterY.data();
+    m_centerZ = m_ownedCenterZ.data();
+    m_radiusSquared = m_ownedRadiusSquared.data();
+    m_albedoIndex = m_ownedAlbedoIndex.data();
+    m_objectID = m_ownedObjectID.data();
+    m_isMapped = false;
+}
+
+void SphereSoA::Add(const float3& center, float radius, int albedoIndex, int objectID) {
+    // Padding spheres have a negative squared radius, so their discriminant is always negative
+    int size = m_size + 1 + PADDING;
+    m_ownedCenterX.resize(size, 0.0f);
+    m_ownedCenterY.resize(size, 0.0f);
+    m_ownedCenterZ.resize(size, 0.0f);
+    m_ownedRadiusSquared.resize(size, -1.0f);
+    m_ownedAlbedoIndex.resize(size, 0);
+    m_ownedObjectID.resize(size, -1);
+
+    m_ownedCenterX[m_size] = center.x;
+    m_ownedCenterY[m_size] = center.y;
+    m_ownedCenterZ[m_size] = center.z;
+    m_ownedRadiusSquared[m_size] = radius * radius;
+    m_ownedAlbedoIndex[m_size] = albedoIndex;
+    m_ownedObjectID[m_size] = objectID;
+    m_size++;
+    PointAtOwnedArrays();
+}
+
+void SphereSoA::SetCenter(int index, const float3& center) {
+    m_ownedCenterX[index] = center.x;
+    m_ownedCenterY[index] = center.y;
+    m_ownedCenterZ[index] = center.z;
+}
+
+int SphereSoA::FindObject(int objectID) const {
+    const int* end = m_objectID + m_size;
+    const int* it = std::lower_bound(m_objectID, end, objectID);
+    return it != end && *it == objectID ? (int)(it - m_objectID) : -1;
+}
+
+void SphereSoA::RenumberObjects() {
+    for (int i = 0; i < m_size; i++) {
+        m_ownedObjectID[i] = i;
+    }
+}
+
+void SphereSoA::Clear() {
+    m_size = 0;
+    m_ownedCenterX.assign(PADDING, 0.0f);
+    m_ownedCenterY.assign(PADDING, 0.0f);
+    m_ownedCenterZ.assign(PADDING, 0.0f);
+    m_ownedRadiusSquared.assign(PADDING, -1.0f);
+    m_ownedAlbedoIndex.assign(PADDING, 0);
+    m_ownedObjectID.assign(PADDING, -1);
+    PointAtOwnedArrays();
+}
+
+void SphereSoA::Reserve(int count) {
+    m_ownedCenterX.reserve(count + PADDING);
+    m_ownedCenterY.reserve(count + PADDING);
+    m_ownedCenterZ.reserve(count + PADDING);
+    m_ownedRadiusSquared.reserve(count + PADDING);
+    m_ownedAlbedoIndex.reserve(count + PADDING);
+    m_ownedObjectID.reserve(count + PADDING);
+    PointAtOwnedArrays();
+}
+
+void SphereSoA::Write(std::ostream& file) const {
+    std::streamsize bytes = (std::streamsize)(m_size + PADDING) * sizeof(float);
+    file.write((const char*)m_centerX, bytes);
+    file.write((const char*)m_centerY, bytes);
+    file.write((const char*)m_centerZ, bytes);
+    file.write((const char*)m_radiusSquared, bytes);
+    file.write((const char*)m_albedoIndex, bytes);
+    file.write((const char*)m_objectID, bytes);
+}
+
+void SphereSoA::Map(const uchar* data, int size) {
+    static_assert(sizeof(int) == sizeof(float), "Mapped sphere arrays are all 4-byte elements");
+    size_t count = (size_t)size + PADDING;
+    const float* arrays = (const float*)data;
+    m_centerX = arrays;
+    m_centerY = arrays + count;
+    m_centerZ = arrays + 2 * count;
+    m_radiusSquared = arrays + 3 * count;
+    m_albedoIndex = (const int*)(arrays + 4 * count);
+    m_objectID = (const int*)(arrays + 5 * count);
+    m_size = size;
+    m_isMapped = true;
+
+    m_ownedCenterX.clear();
+    m_ownedCenterY.clear();
+    m_ownedCenterZ.clear();
+    m_ownedRadiusSquared.clear();
+    m_ownedAlbedoIndex.clear();
+    m_ownedObjectID.clear();
+}
+
+int SphereSoA::IntersectClosest(int start, int count, const Ray& ray, float tMin, float& tMax) const {
+#ifdef STATS
+    stats->sphereRayIntersectionCounter += count;
+#endif
+
+    int closestIndex = -1;
+    float roots[SIMD_WIDTH];
+    for (int first = start; first < start + count; first += SIMD_WIDTH) {
+        int hitMask = IntersectLanes(first, std::min(SIMD_WIDTH, start + count - first), ray, tMin, tMax, roots);
+        for (int lane = 0; hitMask != 0; lane++, hitMask >>= 1) {
+            if ((hitMask & 1) != 0 && roots[lane] < tMax) {
+                tMax = roots[lane];
+                closestIndex = first + lane;
+            }
+        }
+    }
+
+    return closestIndex;
+}
+
+bool SphereSoA::IntersectAny(int start, int count, const Ray& ray, float tMin, float tMax) const {
+#ifdef STATS
+    stats->sphereRayIntersectionCounter += count;
+#endif
+
+    float roots[SIMD_WIDTH];
+    for (int first = start; first < start + count; first += SIMD_WIDTH) {
+        if (IntersectLanes(first, std::min(SIMD_WIDTH, start + count - first), ray, tMin, tMax, roots) != 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void SphereSoA::SetHit(int index, const Ray& ray, IntersectionPoint& intersectionPoint) const {
+    intersectionPoint.point = ray.GetPoint(intersectionPoint.t);
+    intersectionPoint.normal = (intersectionPoint.point - GetCenter(index)) * (1.0f / GetRadius(index));
+    intersectionPoint.objectID = m_objectID[index];
+}
+
+// Same test as Sphere::Hit on SIMD_WIDTH spheres at a time. Returns a bit per sphere hit within (tMin, tMax), with its distance in roots
+int SphereSoA::IntersectLanes(int first, int laneCount, const Ray& ray, float tMin, float tMax, float* roots) const {
+    int laneMask = (1 << laneCount) - 1;
+
+#if defined(__AVX__)
+    __m256 originToCenterX = _mm256_sub_ps(_mm256_loadu_ps(&m_centerX[first]), _mm256_set1_ps(ray.origin.x));
+    __m256 originToCenterY = _mm256_sub_ps(_mm256_loadu_ps(&m_centerY[first]), _mm256_set1_ps(ray.origin.y));
+    __m256 originToCenterZ = _mm256_sub_ps(_mm256_loadu_ps(&m_centerZ[first]), _mm256_set1_ps(ray.origin.z));
+
+    __m256 tClosestApproach = _mm256_add_ps(_mm256_add_ps(
+        _mm256_mul_ps(originToCenterX, _mm256_set1_ps(ray.direction.x)),
+        _mm256_mul_ps(originToCenterY, _mm256_set1_ps(ray.direction.y))),
+        _mm256_mul_ps(originToCenterZ, _mm256_set1_ps(ray.direction.z)));
+    __m256 distanceToSurfaceSquared = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(
+        _mm256_mul_ps(originToCenterX, originToCenterX),
+        _mm256_mul_ps(originToCenterY, originToCenterY)),
+        _mm256_mul_ps(originToCenterZ, originToCenterZ)), _mm256_loadu_ps(&m_radiusSquared[first]));
+
+    __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(tClosestApproach, tClosestApproach), distanceToSurfaceSquared);
+    __m256 tHalfChord = _mm256_sqrt_ps(_mm256_max_ps(discriminant, _mm256_setzero_ps()));
+
+    __m256 min = _mm256_set1_ps(tMin);
+    __m256 max = _mm256_set1_ps(tMax);
+    __m256 nearRoot = _mm256_sub_ps(tClosestApproach, tHalfChord);
+    __m256 farRoot = _mm256_add_ps(tClosestApproach, tHalfChord);
+    __m256 nearInside = _mm256_and_ps(_mm256_cmp_ps(nearRoot, min, _CMP_GT_OQ), _mm256_cmp_ps(nearRoot, max, _CMP_LT_OQ));
+    __m256 farInside = _mm256_and_ps(_mm256_cmp_ps(farRoot, min, _CMP_GT_OQ), _mm256_cmp_ps(farRoot, max, _CMP_LT_OQ));
+
+    __m256 hit = _mm256_and_ps(_mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_or_ps(nearInside, farInside));
+    _mm256_storeu_ps(roots, _mm256_blendv_ps(farRoot, nearRoot, nearInside));
+    return _mm256_movemask_ps(hit) & laneMask;
+#elif defined(__SSE2__) || defined(_M_X64)
+    __m128 originToCenterX = _mm_sub_ps(_mm_loadu_ps(&m_centerX[first]), _mm_set1_ps(ray.origin.x));
+    __m128 originToCenterY = _mm_sub_ps(_mm_loadu_ps(&m_centerY[first]), _mm_set1_ps(ray.origin.y));
+    __m128 originToCenterZ = _mm_sub_ps(_mm_loadu_ps(&m_centerZ[first]), _mm_set1_ps(ray.origin.z));
+
+    __m128 tClosestApproach = _mm_add_ps(_mm_add_ps(
+        _mm_mul_ps(originToCenterX, _mm_set1_ps(ray.direction.x)),
+        _mm_mul_ps(originToCenterY, _mm_set1_ps(ray.direction.y))),
+        _mm_mul_ps(originToCenterZ, _mm_set1_ps(ray.direction.z)));
+    __m128 distanceToSurfaceSquared = _mm_sub_ps(_mm_add_ps(_mm_add_ps(
+        _mm_mul_ps(originToCenterX, originToCenterX),
+        _mm_mul_ps(originToCenterY, originToCenterY)),
+        _mm_mul_ps(originToCenterZ, originToCenterZ)), _mm_loadu_ps(&m_radiusSquared[first]));
+
+    __m128 discriminant = _mm_sub_ps(_mm_mul_ps(tClosestApproach, tClosestApproach), distanceToSurfaceSquared);
+    __m128 tHalfChord = _mm_sqrt_ps(_mm_max_ps(discriminant, _mm_setzero_ps()));
+
+    __m128 min = _mm_set1_ps(tMin);
+    __m128 max = _mm_set1_ps(tMax);
+    __m128 nearRoot = _mm_sub_ps(tClosestApproach, tHalfChord);
+    __m128 farRoot = _mm_add_ps(tClosestApproach, tHalfChord);
+    __m128 nearInside = _mm_and_ps(_mm_cmpgt_ps(nearRoot, min), _mm_cmplt_ps(nearRoot, max));
+    __m128 farInside = _mm_and_ps(_mm_cmpgt_ps(farRoot, min), _mm_cmplt_ps(farRoot, max));
+
+    __m128 hit = _mm_and_ps(_mm_cmpge_ps(discriminant, _mm_setzero_ps()), _mm_or_ps(nearInside, farInside));
+    _mm_storeu_ps(roots, _mm_or_ps(_mm_and_ps(nearInside, nearRoot), _mm_andnot_ps(nearInside, farRoot)));
+    return _mm_movemask_ps(hit) & laneMask;
+#else
+    int hitMask = 0;
+    for (int lane = 0; lane < laneCount; lane++) {
+        int index = first + lane;
+        float3 originToCenter = GetCenter(index) - ray.origin;
+        float tClosestApproach = dot(originToCenter, ray.direction);
+        float discriminant = tClosestApproach * tClosestApproach - (dot(originToCenter, originToCenter) - m_radiusSquared[index]);
+        if (discriminant < 0) {
+            continue;
+        }
+
+        float tHalfChord = sqrt(discriminant);
+        float root = tClosestApproach - tHalfChord;
+        if (root <= tMin || tMax <= root) {
+            root = tClosestApproach + tHalfChord;
+            if (root <= tMin || tMax <= root) {
+                continue;
+            }
+        }
+
+        roots[lane] = root;
+        hitMask |= 1 << lane;
+    }
+    return hitMask & laneMask;
+#endif
+}
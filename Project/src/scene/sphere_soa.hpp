@@ -0,0 +1,66 @@
+#pragma once
+#include <ostream>
+#include "../raytracing/ray.hpp"
+#include "../raytracing/intersection_point.hpp"
+
+// Spheres stored per component (structure of arrays), so several spheres are tested against a ray with one SIMD instruction.
+// The arrays are padded with spheres that can never be hit, so a full SIMD register can always be loaded.
+// Like a Mesh, the arrays are either owned or point straight into a mapped file (a scene cache), which is read-only
+class SphereSoA {
+public:
+	SphereSoA();
+	~SphereSoA() = default;
+	// A copy of a mapped SoA views the same file
+	SphereSoA(const SphereSoA& other);
+	SphereSoA& operator=(const SphereSoA& other);
+
+	void Add(const float3& center, float radius, int albedoIndex, int objectID);
+	void Clear();
+	void Reserve(int count);
+	int Size() const { return m_size; }
+
+	float3 GetCenter(int index) const { return float3(m_centerX[index], m_centerY[index], m_centerZ[index]); }
+	float GetRadius(int index) const { return std::sqrt(m_radiusSquared[index]); }
+	int GetAlbedoIndex(int index) const { return m_albedoIndex[index]; }
+	int GetObjectID(int index) const { return m_objectID[index]; }
+	void SetCenter(int index, const float3& center);
+	// Index of the sphere with objectID, -1 if there is none. Needs the spheres added in increasing objectID order, as the scene does
+	int FindObject(int objectID) const;
+	// Gives every sphere its index as objectID
+	void RenumberObjects();
+
+	// Write puts the arrays out one after the other, padding included, and Map views such bytes. The mapping has to outlive the SoA
+	static size_t GetByteSize(int size) { return (size_t)(size + PADDING) * 6 * sizeof(float); }
+	void Write(std::ostream& file) const;
+	void Map(const uchar* data, int size);
+	bool IsMapped() const { return m_isMapped; }
+
+	// Index of the closest sphere in [start, start + count) hit within (tMin, tMax), tMax is shortened to the hit. -1 if none is hit.
+	// Only the distance is computed, the caller fills in point and normal once the overall closest hit is known
+	int IntersectClosest(int start, int count, const Ray& ray, float tMin, float& tMax) const;
+	bool IntersectAny(int start, int count, const Ray& ray, float tMin, float tMax) const;
+
+	// Fills in everything but t for a hit on the sphere at index
+	void SetHit(int index, const Ray& ray, IntersectionPoint& intersectionPoint) const;
+
+private:
+	static constexpr int PADDING = 8;
+
+	const float* m_centerX = nullptr;
+	const float* m_centerY = nullptr;
+	const float* m_centerZ = nullptr;
+	const float* m_radiusSquared = nullptr;
+	const int* m_albedoIndex = nullptr;
+	const int* m_objectID = nullptr;
+	int m_size = 0;
+	bool m_isMapped = false;
+
+	vector<float> m_ownedCenterX, m_ownedCenterY, m_ownedCenterZ;
+	vector<float> m_ownedRadiusSquared;
+	vector<int> m_ownedAlbedoIndex;
+	vector<int> m_ownedObjectID;
+
+	void PointAtOwnedArrays();
+
+	int IntersectLanes(int first, int laneCount, const Ray& ray, float tMin, float tMax, float* roots) const;
+};
@@ -0,0 +1,190 @@
+#include "triangle_soa.hpp"
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX__)
+static constexpr int SIMD_WIDTH = 8;
+#elif defined(__SSE2__) || defined(_M_X64)
+static constexpr int SIMD_WIDTH = 4;
+#else
+static constexpr int SIMD_WIDTH = 1;
+#endif
+
+TriangleSoA::TriangleSoA() {
+	Clear();
+}
+
+void TriangleSoA::Add(const float3& v0, const float3& v1, const float3& v2, int objectID) {
+	// Padding triangles have zero edges, so their determinant is zero and the barycentric tests fail on NaN
+	int size = m_size + 1 + PADDING;
+	for (vector<float>* component : { &m_vertexX, &m_vertexY, &m_vertexZ, &m_edge1X, &m_edge1Y, &m_edge1Z, &m_edge2X, &m_edge2Y, &m_edge2Z }) {
+		component->resize(size, 0.0f);
+	}
+	m_objectID.resize(size, -1);
+
+	float3 edge1 = v1 - v0;
+	float3 edge2 = v2 - v0;
+	m_vertexX[m_size] = v0.x;
+	m_vertexY[m_size] = v0.y;
+	m_vertexZ[m_size] = v0.z;
+	m_edge1X[m_size] = edge1.x;
+	m_edge1Y[m_size] = edge1.y;
+	m_edge1Z[m_size] = edge1.z;
+	m_edge2X[m_size] = edge2.x;
+	m_edge2Y[m_size] = edge2.y;
+	m_edge2Z[m_size] = edge2.z;
+	m_objectID[m_size] = objectID;
+	m_size++;
+}
+
+void TriangleSoA::Clear() {
+	m_size = 0;
+	for (vector<float>* component : { &m_vertexX, &m_vertexY, &m_vertexZ, &m_edge1X, &m_edge1Y, &m_edge1Z, &m_edge2X, &m_edge2Y, &m_edge2Z }) {
+		component->assign(PADDING, 0.0f);
+	}
+	m_objectID.assign(PADDING, -1);
+}
+
+void TriangleSoA::Reserve(int count) {
+	for (vector<float>* component : { &m_vertexX, &m_vertexY, &m_vertexZ, &m_edge1X, &m_edge1Y, &m_edge1Z, &m_edge2X, &m_edge2Y, &m_edge2Z }) {
+		component->reserve(count + PADDING);
+	}
+	m_objectID.reserve(count + PADDING);
+}
+
+int TriangleSoA::IntersectClosest(int start, int count, const Ray& ray, float tMin, float& tMax) const {
+#ifdef STATS
+	stats->triangleRayIntersectionCounter += count;
+#endif
+
+	int closestIndex = -1;
+	float distances[SIMD_WIDTH];
+	for (int first = start; first < start + count; first += SIMD_WIDTH) {
+		int hitMask = IntersectLanes(first, std::min(SIMD_WIDTH, start + count - first), ray, tMin, tMax, distances);
+		for (int lane = 0; hitMask != 0; lane++, hitMask >>= 1) {
+			if ((hitMask & 1) != 0 && distances[lane] < tMax) {
+				tMax = distances[lane];
+				closestIndex = first + lane;
+			}
+		}
+	}
+
+	return closestIndex;
+}
+
+bool TriangleSoA::IntersectAny(int start, int count, const Ray& ray, float tMin, float tMax) const {
+#ifdef STATS
+	stats->triangleRayIntersectionCounter += count;
+#endif
+
+	float distances[SIMD_WIDTH];
+	for (int first = start; first < start + count; first += SIMD_WIDTH) {
+		if (IntersectLanes(first, std::min(SIMD_WIDTH, start + count - first), ray, tMin, tMax, distances) != 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void TriangleSoA::SetHit(int index, const Ray& ray, IntersectionPoint& intersectionPoint) const {
+	intersectionPoint.point = ray.GetPoint(intersectionPoint.t);
+	intersectionPoint.normal = GetTriangleNormal(ray, GetEdge1(index), GetEdge2(index));
+	intersectionPoint.objectID = m_objectID[index];
+}
+
+// Same test as IntersectTriangle on SIMD_WIDTH triangles at a time. Returns a bit per triangle hit within (tMin, tMax), with its distance
+// in distances. The comparisons are ordered, so the NaNs of parallel rays and padding triangles never count as a hit
+int TriangleSoA::IntersectLanes(int first, int laneCount, const Ray& ray, float tMin, float tMax, float* distances) const {
+	int laneMask = (1 << laneCount) - 1;
+
+#if defined(__AVX__)
+	__m256 directionX = _mm256_set1_ps(ray.direction.x);
+	__m256 directionY = _mm256_set1_ps(ray.direction.y);
+	__m256 directionZ = _mm256_set1_ps(ray.direction.z);
+	__m256 edge1X = _mm256_loadu_ps(&m_edge1X[first]);
+	__m256 edge1Y = _mm256_loadu_ps(&m_edge1Y[first]);
+	__m256 edge1Z = _mm256_loadu_ps(&m_edge1Z[first]);
+	__m256 edge2X = _mm256_loadu_ps(&m_edge2X[first]);
+	__m256 edge2Y = _mm256_loadu_ps(&m_edge2Y[first]);
+	__m256 edge2Z = _mm256_loadu_ps(&m_edge2Z[first]);
+
+	__m256 pX = _mm256_sub_ps(_mm256_mul_ps(directionY, edge2Z), _mm256_mul_ps(directionZ, edge2Y));
+	__m256 pY = _mm256_sub_ps(_mm256_mul_ps(directionZ, edge2X), _mm256_mul_ps(directionX, edge2Z));
+	__m256 pZ = _mm256_sub_ps(_mm256_mul_ps(directionX, edge2Y), _mm256_mul_ps(directionY, edge2X));
+	__m256 determinant = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(edge1X, pX), _mm256_mul_ps(edge1Y, pY)), _mm256_mul_ps(edge1Z, pZ));
+	__m256 inverseDeterminant = _mm256_div_ps(_mm256_set1_ps(1.0f), determinant);
+
+	__m256 originToVertexX = _mm256_sub_ps(_mm256_set1_ps(ray.origin.x), _mm256_loadu_ps(&m_vertexX[first]));
+	__m256 originToVertexY = _mm256_sub_ps(_mm256_set1_ps(ray.origin.y), _mm256_loadu_ps(&m_vertexY[first]));
+	__m256 originToVertexZ = _mm256_sub_ps(_mm256_set1_ps(ray.origin.z), _mm256_loadu_ps(&m_vertexZ[first]));
+	__m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(
+		_mm256_mul_ps(originToVertexX, pX),
+		_mm256_mul_ps(originToVertexY, pY)),
+		_mm256_mul_ps(originToVertexZ, pZ)), inverseDeterminant);
+
+	__m256 qX = _mm256_sub_ps(_mm256_mul_ps(originToVertexY, edge1Z), _mm256_mul_ps(originToVertexZ, edge1Y));
+	__m256 qY = _mm256_sub_ps(_mm256_mul_ps(originToVertexZ, edge1X), _mm256_mul_ps(originToVertexX, edge1Z));
+	__m256 qZ = _mm256_sub_ps(_mm256_mul_ps(originToVertexX, edge1Y), _mm256_mul_ps(originToVertexY, edge1X));
+	__m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(directionX, qX), _mm256_mul_ps(directionY, qY)), _mm256_mul_ps(directionZ, qZ)),
+		inverseDeterminant);
+	__m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(edge2X, qX), _mm256_mul_ps(edge2Y, qY)), _mm256_mul_ps(edge2Z, qZ)),
+		inverseDeterminant);
+
+	__m256 zero = _mm256_setzero_ps();
+	__m256 hit = _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+	hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_add_ps(u, v), _mm256_set1_ps(1.0f), _CMP_LE_OQ));
+	hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, _mm256_set1_ps(tMin), _CMP_GT_OQ));
+	hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, _mm256_set1_ps(tMax), _CMP_LT_OQ));
+	_mm256_storeu_ps(distances, t);
+	return _mm256_movemask_ps(hit) & laneMask;
+#elif defined(__SSE2__) || defined(_M_X64)
+	__m128 directionX = _mm_set1_ps(ray.direction.x);
+	__m128 directionY = _mm_set1_ps(ray.direction.y);
+	__m128 directionZ = _mm_set1_ps(ray.direction.z);
+	__m128 edge1X = _mm_loadu_ps(&m_edge1X[first]);
+	__m128 edge1Y = _mm_loadu_ps(&m_edge1Y[first]);
+	__m128 edge1Z = _mm_loadu_ps(&m_edge1Z[first]);
+	__m128 edge2X = _mm_loadu_ps(&m_edge2X[first]);
+	__m128 edge2Y = _mm_loadu_ps(&m_edge2Y[first]);
+	__m128 edge2Z = _mm_loadu_ps(&m_edge2Z[first]);
+
+	__m128 pX = _mm_sub_ps(_mm_mul_ps(directionY, edge2Z), _mm_mul_ps(directionZ, edge2Y));
+	__m128 pY = _mm_sub_ps(_mm_mul_ps(directionZ, edge2X), _mm_mul_ps(directionX, edge2Z));
+	__m128 pZ = _mm_sub_ps(_mm_mul_ps(directionX, edge2Y), _mm_mul_ps(directionY, edge2X));
+	__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, pX), _mm_mul_ps(edge1Y, pY)), _mm_mul_ps(edge1Z, pZ));
+	__m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+	__m128 originToVertexX = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_loadu_ps(&m_vertexX[first]));
+	__m128 originToVertexY = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_loadu_ps(&m_vertexY[first]));
+	__m128 originToVertexZ = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_loadu_ps(&m_vertexZ[first]));
+	__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(
+		_mm_mul_ps(originToVertexX, pX),
+		_mm_mul_ps(originToVertexY, pY)),
+		_mm_mul_ps(originToVertexZ, pZ)), inverseDeterminant);
+
+	__m128 qX = _mm_sub_ps(_mm_mul_ps(originToVertexY, edge1Z), _mm_mul_ps(originToVertexZ, edge1Y));
+	__m128 qY = _mm_sub_ps(_mm_mul_ps(originToVertexZ, edge1X), _mm_mul_ps(originToVertexX, edge1Z));
+	__m128 qZ = _mm_sub_ps(_mm_mul_ps(originToVertexX, edge1Y), _mm_mul_ps(originToVertexY, edge1X));
+	__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, qX), _mm_mul_ps(directionY, qY)), _mm_mul_ps(directionZ, qZ)), inverseDeterminant);
+	__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qX), _mm_mul_ps(edge2Y, qY)), _mm_mul_ps(edge2Z, qZ)), inverseDeterminant);
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 hit = _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero));
+	hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+	hit = _mm_and_ps(hit, _mm_cmpgt_ps(t, _mm_set1_ps(tMin)));
+	hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_set1_ps(tMax)));
+	_mm_storeu_ps(distances, t);
+	return _mm_movemask_ps(hit) & laneMask;
+#else
+	int hitMask = 0;
+	for (int lane = 0; lane < laneCount; lane++) {
+		int index = first + lane;
+		if (IntersectTriangle(ray, GetVertex(index), GetEdge1(index), GetEdge2(index), tMin, tMax, distances[lane])) {
+			hitMask |= 1 << lane;
+		}
+	}
+	return hitMask & laneMask;
+#endif
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "../raytracing/ray.hpp"
+#include "../raytracing/intersection_point.hpp"
+
+// Moller-Trumbore ray/triangle test, triangles are two-sided. True if the triangle at vertex + u edge1 + v edge2 is hit within (tMin, tMax)
+inline bool IntersectTriangle(const Ray& ray, const float3& vertex, const float3& edge1, const float3& edge2, float tMin, float tMax, float& t) {
+	float3 p = cross(ray.direction, edge2);
+	float determinant = dot(edge1, p);
+	if (determinant == 0.0f) {
+		return false;
+	}
+
+	float inverseDeterminant = 1.0f / determinant;
+	float3 originToVertex = ray.origin - vertex;
+	float u = dot(originToVertex, p) * inverseDeterminant;
+	if (u < 0.0f || u > 1.0f) {
+		return false;
+	}
+
+	float3 q = cross(originToVertex, edge1);
+	float v = dot(ray.direction, q) * inverseDeterminant;
+	if (v < 0.0f || u + v > 1.0f) {
+		return false;
+	}
+
+	t = dot(edge2, q) * inverseDeterminant;
+	return tMin < t && t < tMax;
+}
+
+// Geometric normal, flipped to face the ray so shading and shadow ray offsets work from both sides
+inline float3 GetTriangleNormal(const Ray& ray, const float3& edge1, const float3& edge2) {
+	float3 normal = normalize(cross(edge1, edge2));
+	return dot(normal, ray.direction) > 0.0f ? -normal : normal;
+}
+
+// Triangles stored per component like SphereSoA, as one vertex and the two edges leaving it (all the Moller-Trumbore test needs), so
+// several triangles are tested against a ray with one SIMD instruction. The padding triangles have no area and can never be hit.
+class TriangleSoA {
+public:
+	TriangleSoA();
+	~TriangleSoA() = default;
+
+	void Add(const float3& v0, const float3& v1, const float3& v2, int objectID);
+	void Clear();
+	void Reserve(int count);
+	int Size() const { return m_size; }
+
+	float3 GetVertex(int index) const { return float3(m_vertexX[index], m_vertexY[index], m_vertexZ[index]); }
+	float3 GetEdge1(int index) const { return float3(m_edge1X[index], m_edge1Y[index], m_edge1Z[index]); }
+	float3 GetEdge2(int index) const { return float3(m_edge2X[index], m_edge2Y[index], m_edge2Z[index]); }
+	int GetObjectID(int index) const { return m_objectID[index]; }
+
+	// Index of the closest triangle in [start, start + count) hit within (tMin, tMax), tMax is shortened to the hit. -1 if none is hit.
+	// Only the distance is computed, the caller fills in point and normal once the overall closest hit is known
+	int IntersectClosest(int start, int count, const Ray& ray, float tMin, float& tMax) const;
+	bool IntersectAny(int start, int count, const Ray& ray, float tMin, float tMax) const;
+
+	// Fills in everything but t for a hit on the triangle at index
+	void SetHit(int index, const Ray& ray, IntersectionPoint& intersectionPoint) const;
+
+private:
+	static constexpr int PADDING = 8;
+
+	vector<float> m_vertexX, m_vertexY, m_vertexZ;
+	vector<float> m_edge1X, m_edge1Y, m_edge1Z;
+	vector<float> m_edge2X, m_edge2Y, m_edge2Z;
+	vector<int> m_objectID;
+	int m_size = 0;
+
+	int IntersectLanes(int first, int laneCount, const Ray& ray, float tMin, float tMax, float* distances) const;
+};
@@ -4,8 +4,16 @@ string GetCompileShaderCommand(cstring path) {
 	return std::format("glslc {} -o {}.spv", path, path);
 }
 
+bool CompileShader(const string& path) {
+	PROFILE_SCOPE("glslc");
+	string command = GetCompileShaderCommand(path.c_str());
+	return system(command.c_str()) == 0;
+}
+
 Shader::Shader(const string name, string vertexShaderPath, string fragmentShaderPath)
 	: m_name(name) {
+	PROFILE_SCOPE("Shader::Shader");
+
 	m_vertexShaderPath = SHADER_DIR + vertexShaderPath;
 	m_fragmentShaderPath = SHADER_DIR + fragmentShaderPath;
 
@@ -13,14 +21,11 @@ Shader::Shader(const string name, string vertexShaderPath, string fragmentShader
 	// TODO: Preprocess files to add #include
 #elif VULKAN
 	// Create SPIR-V files
-	string compileVertexShaderCommand = GetCompileShaderCommand(m_vertexShaderPath.c_str());
-
-	if (system(compileVertexShaderCommand.c_str()) != 0) {
+	if (!CompileShader(m_vertexShaderPath)) {
 		spdlog::error("[Vulkan Error] Vertex shader compilation failed");
 	}
 
-	string compileFragmentShaderCommand = GetCompileShaderCommand(m_fragmentShaderPath.c_str());
-	if (system(compileFragmentShaderCommand.c_str()) != 0) {
+	if (!CompileShader(m_fragmentShaderPath)) {
 		spdlog::error("[Vulkan Error] Fragment shader compilation failed");
 	}
 
@@ -72,19 +72,33 @@
     }
 #endif
 
-inline void WriteColor(uchar* pixels, int x, int y, const Color& pixel_value) {
+inline void WriteColor(uchar* pixels, int width, int x, int y, const Color& pixel_value) {
     Color clampedColor = Clamp(pixel_value);
 
-    int offset = (y * IMAGE_WIDTH + x) * 4;
+    int offset = (y * width + x) * 4;
     pixels[offset + 0] = (int)(clampedColor.r * 255.f);
     pixels[offset + 1] = (int)(clampedColor.g * 255.f);
     pixels[offset + 2] = (int)(clampedColor.b * 255.f);
     pixels[offset + 3] = (int)(clampedColor.a * 255.f);
 }
 
+// Unclamped linear RGB for HDR output, 3 floats per pixel
+inline void WriteColor(float* pixels, int width, int x, int y, const Color& pixel_value) {
+    int offset = (y * width + x) * 3;
+    pixels[offset + 0] = pixel_value.r;
+    pixels[offset + 1] = pixel_value.g;
+    pixels[offset + 2] = pixel_value.b;
+}
+
+// Blue at 0, green at 0.5, red at 1
+inline Color HeatmapColor(float t) {
+    return t < 0.5f ? Color(0.0f, 2.0f * t, 1.0f - 2.0f * t) : Color(2.0f * t - 1.0f, 2.0f - 2.0f * t, 0.0f);
+}
+
 static const Color COLOR_BLACK = Color(0.0f, 0.0f, 0.0f, 1.0f);
 static const Color COLOR_WHITE = Color(1.0f, 1.0f, 1.0f, 1.0f);
 static const Color COLOR_RED = Color(1.0f, 0.0f, 0.0f, 1.0f);
 static const Color COLOR_GREEN = Color(0.0f, 1.0f, 0.0f, 1.0f);
 static const Color COLOR_BLUE = Color(0.0f, 0.0f, 1.0f, 1.0f);
-static const Color COLOR_LIGHTBLUE = Color(0.5f, 0.7f, 1.0f, 1.0f);
\ No newline at end of file
+static const Color COLOR_LIGHTBLUE = Color(0.5f, 0.7f, 1.0f, 1.0f);
+static const Color COLOR_GREY = Color(0.5f, 0.5f, 0.5f, 1.0f);
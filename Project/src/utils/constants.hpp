@@ -1,7 +1,5 @@
 #pragma once
 
-constexpr int IMAGE_WIDTH = 800;
-constexpr int IMAGE_HEIGHT = 600;
 constexpr int VIEWPORT_WIDTH = 800;
 constexpr int VIEWPORT_HEIGHT = 600;
 
@@ -9,5 +7,17 @@ constexpr float OFFSET = 0.001f;
 constexpr float PI = 3.1415926535897932385f;
 
 // Options
+// STATS_LEVEL comes from CMake: 0 compiles the statistics out, 1 counts rays, traversal steps and intersection tests per frame,
+// 2 also records the traversal cost of every pixel
+#ifndef STATS_LEVEL
+#define STATS_LEVEL 1
+#endif
+
+#if STATS_LEVEL >= 1
 #define STATS
+#endif
+
+#if STATS_LEVEL >= 2
+#define STATS_PIXEL_COST
+#endif
 #define USE_OWN_COLOR_TYPE
\ No newline at end of file
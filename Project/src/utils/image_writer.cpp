@@ -0,0 +1,169 @@
+#include "image_writer.hpp"
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <spdlog/spdlog.h>
+
+static std::ofstream OpenImageFile(const std::filesystem::path& filePath) {
+	std::ofstream file(filePath, std::ios::binary);
+	if (!file.is_open()) {
+		spdlog::error("Could not open file at {}", filePath.string());
+	}
+	return file;
+}
+
+static bool CloseImageFile(std::ofstream& file, const std::filesystem::path& filePath) {
+	file.close();
+	if (file.fail()) {
+		spdlog::error("Could not write file at {}", filePath.string());
+		return false;
+	}
+	return true;
+}
+
+bool WritePPM(const std::filesystem::path& filePath, const uchar* pixels, int width, int height) {
+	std::ofstream file = OpenImageFile(filePath);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+
+	vector<uchar> row(width * 3);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			const uchar* pixel = &pixels[(y * width + x) * 4];
+			row[x * 3 + 0] = pixel[0];
+			row[x * 3 + 1] = pixel[1];
+			row[x * 3 + 2] = pixel[2];
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), row.size());
+	}
+
+	return CloseImageFile(file, filePath);
+}
+
+// PNG
+
+static uint UpdateCrc(uint crc, const uchar* data, size_t size) {
+	static const std::array<uint, 256> table = [] {
+		std::array<uint, 256> result;
+		for (uint n = 0; n < 256; n++) {
+			uint c = n;
+			for (int k = 0; k < 8; k++) {
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			result[n] = c;
+		}
+		return result;
+	}();
+
+	for (size_t i = 0; i < size; i++) {
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+static void AppendBigEndian(vector<uchar>& buffer, uint value) {
+	buffer.push_back((uchar)(value >> 24));
+	buffer.push_back((uchar)(value >> 16));
+	buffer.push_back((uchar)(value >> 8));
+	buffer.push_back((uchar)value);
+}
+
+static void WriteChunk(std::ofstream& file, cstring type, const vector<uchar>& data) {
+	vector<uchar> chunk;
+	chunk.reserve(data.size() + 12);
+	AppendBigEndian(chunk, (uint)data.size());
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+
+	// The CRC covers the type and the data, not the length
+	uint crc = UpdateCrc(0xFFFFFFFFu, chunk.data() + 4, chunk.size() - 4) ^ 0xFFFFFFFFu;
+	AppendBigEndian(chunk, crc);
+
+	file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+}
+
+// Stores the image uncompressed: a zlib stream of stored deflate blocks. Larger files, but no compression time in batch jobs
+bool WritePNG(const std::filesystem::path& filePath, const uchar* pixels, int width, int height) {
+	std::ofstream file = OpenImageFile(filePath);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	static const uchar signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+	vector<uchar> header;
+	AppendBigEndian(header, (uint)width);
+	AppendBigEndian(header, (uint)height);
+	header.push_back(8); // bit depth
+	header.push_back(2); // color type RGB
+	header.push_back(0); // compression
+	header.push_back(0); // filter
+	header.push_back(0); // no interlacing
+	WriteChunk(file, "IHDR", header);
+
+	// Every row starts with its filter type, 0 (none)
+	vector<uchar> scanlines;
+	scanlines.reserve((size_t)height * (width * 3 + 1));
+	for (int y = 0; y < height; y++) {
+		scanlines.push_back(0);
+		for (int x = 0; x < width; x++) {
+			const uchar* pixel = &pixels[(y * width + x) * 4];
+			scanlines.insert(scanlines.end(), pixel, pixel + 3);
+		}
+	}
+
+	constexpr size_t MAX_BLOCK_SIZE = 65535;
+	vector<uchar> data;
+	data.reserve(scanlines.size() + (scanlines.size() / MAX_BLOCK_SIZE + 1) * 5 + 6);
+	data.push_back(0x78);
+	data.push_back(0x01);
+
+	size_t offset = 0;
+	do {
+		size_t blockSize = std::min(MAX_BLOCK_SIZE, scanlines.size() - offset);
+		bool isLast = offset + blockSize == scanlines.size();
+		data.push_back(isLast ? 1 : 0);
+		data.push_back((uchar)(blockSize & 0xFF));
+		data.push_back((uchar)(blockSize >> 8));
+		data.push_back((uchar)(~blockSize & 0xFF));
+		data.push_back((uchar)((~blockSize >> 8) & 0xFF));
+		data.insert(data.end(), scanlines.begin() + offset, scanlines.begin() + offset + blockSize);
+		offset += blockSize;
+	} while (offset < scanlines.size());
+
+	uint a = 1, b = 0;
+	for (uchar value : scanlines) {
+		a = (a + value) % 65521;
+		b = (b + a) % 65521;
+	}
+	AppendBigEndian(data, (b << 16) | a);
+
+	WriteChunk(file, "IDAT", data);
+	WriteChunk(file, "IEND", {});
+
+	return CloseImageFile(file, filePath);
+}
+
+// Portable float map, rows are stored bottom to top and a negative scale marks little-endian floats
+bool WritePFM(const std::filesystem::path& filePath, const float* pixels, int width, int height) {
+	static_assert(sizeof(float) == 4, "PFM stores 32-bit floats");
+
+	std::ofstream file = OpenImageFile(filePath);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	const std::uint16_t endianProbe = 1;
+	bool isLittleEndian = *reinterpret_cast<const uchar*>(&endianProbe) == 1;
+	file << "PF\n" << width << " " << height << "\n" << (isLittleEndian ? "-1.0" : "1.0") << "\n";
+
+	for (int y = height - 1; y >= 0; y--) {
+		file.write(reinterpret_cast<const char*>(&pixels[(size_t)y * width * 3]), (size_t)width * 3 * sizeof(float));
+	}
+
+	return CloseImageFile(file, filePath);
+}
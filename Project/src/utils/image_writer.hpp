@@ -0,0 +1,9 @@
+#pragma once
+
+#include <filesystem>
+
+// 8-bit images take RGBA pixels (alpha is dropped), HDR images take linear RGB floats. Rows run top to bottom.
+// All writers log an error and return false when the file cannot be written
+bool WritePPM(const std::filesystem::path& filePath, const uchar* pixels, int width, int height);
+bool WritePNG(const std::filesystem::path& filePath, const uchar* pixels, int width, int height);
+bool WritePFM(const std::filesystem::path& filePath, const float* pixels, int width, int height);
@@ -0,0 +1,101 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::filesystem::path& path) {
+	Close();
+
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		spdlog::error("Cannot open {}", path.string());
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		spdlog::error("{} is empty or its size cannot be read", path.string());
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	void* data = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (data == nullptr) {
+		spdlog::error("Cannot map {} into memory", path.string());
+		if (mapping != nullptr) {
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+		return false;
+	}
+
+	m_file = file;
+	m_mapping = mapping;
+	m_data = (const uchar*)data;
+	m_size = (size_t)size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close() {
+	if (m_data != nullptr) {
+		UnmapViewOfFile(m_data);
+		CloseHandle(m_mapping);
+		CloseHandle(m_file);
+	}
+	m_data = nullptr;
+	m_size = 0;
+	m_file = nullptr;
+	m_mapping = nullptr;
+}
+#else
+bool MappedFile::Open(const std::filesystem::path& path) {
+	Close();
+
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		spdlog::error("Cannot open {}", path.string());
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size == 0) {
+		spdlog::error("{} is empty or its size cannot be read", path.string());
+		close(file);
+		return false;
+	}
+
+	// The mapping keeps its own reference to the file, the descriptor is not needed anymore
+	void* data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (data == MAP_FAILED) {
+		spdlog::error("Cannot map {} into memory", path.string());
+		return false;
+	}
+
+	m_data = (const uchar*)data;
+	m_size = (size_t)status.st_size;
+	return true;
+}
+
+void MappedFile::Close() {
+	if (m_data != nullptr) {
+		munmap((void*)m_data, m_size);
+	}
+	m_data = nullptr;
+	m_size = 0;
+}
+#endif
@@ -0,0 +1,29 @@
+#pragma once
+#include <filesystem>
+
+// Read-only view of a whole file, mapped into memory instead of read. Opening is cheap whatever the size: the OS reads a page the first
+// time it is touched and keeps it in its page cache, so a file that was loaded before comes back without any disk access
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Logs the error and returns false if the file cannot be opened or is empty
+	bool Open(const std::filesystem::path& path);
+	void Close();
+
+	bool IsOpen() const { return m_data != nullptr; }
+	const uchar* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	const uchar* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#endif
+};
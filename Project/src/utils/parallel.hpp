@@ -0,0 +1,30 @@
+#pragma once
+#include <thread>
+
+// Number of worker threads to use, 0 means all hardware threads
+inline int ResolveThreadCount(int requested) {
+	if (requested > 0) {
+		return requested;
+	}
+	return std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+// Splits [0, count) into chunkCount contiguous ranges and runs body(chunkIndex, begin, end) for each on its own thread.
+// The chunk boundaries only depend on count and chunkCount, so two calls with the same arguments see the same ranges.
+template<typename Function>
+void ParallelForChunks(int count, int chunkCount, const Function& body) {
+	chunkCount = std::max(1, std::min(chunkCount, count));
+
+	auto chunkBegin = [=](int chunk) { return (int)((long long)count * chunk / chunkCount); };
+
+	vector<std::thread> workers;
+	for (int chunk = 1; chunk < chunkCount; chunk++) {
+		workers.emplace_back([&, chunk]() { body(chunk, chunkBegin(chunk), chunkBegin(chunk + 1)); });
+	}
+
+	body(0, chunkBegin(0), chunkBegin(1));
+
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
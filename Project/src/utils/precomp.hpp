@@ -11,4 +11,6 @@
 #include "base_types.hpp"
 #include "constants.hpp"
 #include "utilities.hpp"
+#include "profiler.hpp"
+#include "random.hpp"
 #include "color.hpp"
\ No newline at end of file
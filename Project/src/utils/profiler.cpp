@@ -0,0 +1,187 @@
+#include "profiler.hpp"
+
+#if PROFILING
+#include <atomic>
+#include <chrono>
+#include <fstream>
+
+struct ProfileEvent {
+	cstring name; // zone names are string literals, so only the pointer is stored
+	long long timestamp; // nanoseconds since the profiler started
+	bool isBegin;
+};
+
+// Events are appended to fixed-size chunks, a chunk is published with a release store of its count so the writer never waits
+// and a dump can read while threads keep recording
+struct ProfileChunk {
+	static constexpr int CAPACITY = 4096;
+	ProfileEvent events[CAPACITY];
+	std::atomic<int> count = 0;
+	std::atomic<ProfileChunk*> next = nullptr;
+};
+
+// Buffers are never freed, a thread that exits hands its buffer to the next new thread. That way threads that come and go every
+// frame, like the tile workers, show up as a few long-lived tracks in the trace
+struct ProfileThreadBuffer {
+	int threadIndex;
+	std::atomic<bool> inUse = true;
+	std::atomic<cstring> name = nullptr;
+	std::atomic<ProfileChunk*> first = nullptr;
+	ProfileChunk* last = nullptr;
+	int chunkCount = 0;
+	// Zones begun and not ended yet, recorded ones and dropped ones (every zone inside a dropped one is dropped too)
+	int openZones = 0;
+	int droppedZones = 0;
+	std::atomic<ProfileThreadBuffer*> next = nullptr;
+};
+
+// Caps the memory of a thread that records for a long time, later zones are dropped
+static constexpr int MAX_CHUNKS_PER_THREAD = 256;
+
+static const std::chrono::steady_clock::time_point s_startTime = std::chrono::steady_clock::now();
+static std::atomic<ProfileThreadBuffer*> s_threadBuffers = nullptr;
+static std::atomic<int> s_threadCount = 0;
+
+// Gives the buffer back when its thread exits
+struct ProfileThreadBufferOwner {
+	ProfileThreadBuffer* buffer = nullptr;
+
+	~ProfileThreadBufferOwner() {
+		if (buffer != nullptr) {
+			buffer->inUse.store(false, std::memory_order_release);
+		}
+	}
+};
+
+static ProfileThreadBuffer& GetThreadBuffer() {
+	thread_local ProfileThreadBufferOwner owner;
+	if (owner.buffer != nullptr) {
+		return *owner.buffer;
+	}
+
+	// Take over the buffer of a thread that exited, or add a new one to the front of the list
+	for (ProfileThreadBuffer* buffer = s_threadBuffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next.load(std::memory_order_acquire)) {
+		bool inUse = false;
+		if (buffer->inUse.compare_exchange_strong(inUse, true, std::memory_order_acquire)) {
+			buffer->name.store(nullptr, std::memory_order_relaxed);
+			owner.buffer = buffer;
+			return *buffer;
+		}
+	}
+
+	ProfileThreadBuffer* buffer = new ProfileThreadBuffer();
+	buffer->threadIndex = s_threadCount++;
+	ProfileThreadBuffer* head = s_threadBuffers.load(std::memory_order_relaxed);
+	do {
+		buffer->next.store(head, std::memory_order_relaxed);
+	} while (!s_threadBuffers.compare_exchange_weak(head, buffer, std::memory_order_release, std::memory_order_relaxed));
+
+	owner.buffer = buffer;
+	return *buffer;
+}
+
+// Events the thread can still record before it reaches MAX_CHUNKS_PER_THREAD
+static long long GetRemainingEvents(const ProfileThreadBuffer& buffer) {
+	int count = buffer.last != nullptr ? buffer.last->count.load(std::memory_order_relaxed) : ProfileChunk::CAPACITY;
+	return (long long)(MAX_CHUNKS_PER_THREAD - buffer.chunkCount) * ProfileChunk::CAPACITY + ProfileChunk::CAPACITY - count;
+}
+
+// The caller checked there is room left
+static void Record(ProfileThreadBuffer& buffer, long long timestamp, cstring name, bool isBegin) {
+	ProfileChunk* chunk = buffer.last;
+	int count = chunk != nullptr ? chunk->count.load(std::memory_order_relaxed) : ProfileChunk::CAPACITY;
+	if (count == ProfileChunk::CAPACITY) {
+		ProfileChunk* newChunk = new ProfileChunk();
+		if (chunk != nullptr) {
+			chunk->next.store(newChunk, std::memory_order_release);
+		}
+		else {
+			buffer.first.store(newChunk, std::memory_order_release);
+		}
+		buffer.last = newChunk;
+		buffer.chunkCount++;
+		chunk = newChunk;
+		count = 0;
+	}
+
+	chunk->events[count] = { name, timestamp, isBegin };
+	chunk->count.store(count + 1, std::memory_order_release);
+}
+
+static long long GetTimestamp() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_startTime).count();
+}
+
+void Profiler::Begin(cstring name) {
+	long long timestamp = GetTimestamp();
+	ProfileThreadBuffer& buffer = GetThreadBuffer();
+
+	// Room stays reserved for the End of every recorded zone, so a full buffer drops whole zones instead of leaving them open
+	if (buffer.droppedZones > 0 || GetRemainingEvents(buffer) < buffer.openZones + 2) {
+		buffer.droppedZones++;
+		return;
+	}
+	buffer.openZones++;
+	Record(buffer, timestamp, name, true);
+}
+
+void Profiler::End() {
+	long long timestamp = GetTimestamp();
+	ProfileThreadBuffer& buffer = GetThreadBuffer();
+
+	if (buffer.droppedZones > 0) {
+		buffer.droppedZones--;
+		return;
+	}
+	buffer.openZones--;
+	Record(buffer, timestamp, nullptr, false);
+}
+
+void Profiler::SetThreadName(cstring name) {
+	GetThreadBuffer().name.store(name, std::memory_order_relaxed);
+}
+
+bool Profiler::WriteChromeTrace(const std::filesystem::path& path) {
+	std::ofstream file(path);
+	if (!file) {
+		spdlog::error("Cannot open {} for writing", path.string());
+		return false;
+	}
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	long long eventCount = 0;
+	auto separator = [&]() {
+		if (!first) {
+			file << ",\n";
+		}
+		first = false;
+	};
+
+	for (ProfileThreadBuffer* buffer = s_threadBuffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next.load(std::memory_order_acquire)) {
+		if (cstring name = buffer->name.load(std::memory_order_relaxed)) {
+			separator();
+			file << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":" << buffer->threadIndex << ",\"args\":{\"name\":\"" << name << "\"}}";
+		}
+
+		for (ProfileChunk* chunk = buffer->first.load(std::memory_order_acquire); chunk != nullptr; chunk = chunk->next.load(std::memory_order_acquire)) {
+			int count = chunk->count.load(std::memory_order_acquire);
+			for (int i = 0; i < count; i++) {
+				const ProfileEvent& event = chunk->events[i];
+				separator();
+				file << "{\"ph\":\"" << (event.isBegin ? "B" : "E") << "\",\"pid\":0,\"tid\":" << buffer->threadIndex << ",\"ts\":"
+					<< fmt::format("{:.3f}", event.timestamp * 1e-3);
+				if (event.isBegin) {
+					file << ",\"name\":\"" << event.name << "\"";
+				}
+				file << "}";
+			}
+			eventCount += count;
+		}
+	}
+
+	file << "\n]}\n";
+	spdlog::info("Profile | {} events of {} threads written to {}", eventCount, s_threadCount.load(), path.string());
+	return (bool)file;
+}
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+// Scoped zones for finding where startup and frame time go, written as Chrome trace JSON (chrome://tracing or ui.perfetto.dev):
+//   PROFILE_SCOPE("Build BVH");          zone from here to the end of the enclosing scope
+//   PROFILE_FUNCTION();                  zone named after the enclosing function
+//   PROFILE_THREAD_NAME("Render thread"); name of the calling thread in the trace
+// Names are stored as pointers, so they have to be string literals
+// With PROFILING off (the ENABLE_PROFILING CMake option) the macros expand to nothing and the profiler is not compiled in
+#if PROFILING
+#include <filesystem>
+
+class Profiler {
+public:
+	// Called by the zones, only the calling thread writes to its own buffer so no lock is taken
+	static void Begin(cstring name);
+	static void End();
+	static void SetThreadName(cstring name);
+
+	// Events of every thread so far. Threads that are still recording can be dumped too, their newest events may be left out
+	static bool WriteChromeTrace(const std::filesystem::path& path);
+};
+
+class ProfileScope {
+public:
+	ProfileScope(cstring name) { Profiler::Begin(name); }
+	~ProfileScope() { Profiler::End(); }
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+#define PROFILE_THREAD_NAME(name) Profiler::SetThreadName(name)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD_NAME(name)
+#endif
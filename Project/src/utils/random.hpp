@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+
+// PCG32 generator (pcg-random.org), small enough to create one per pixel sample.
+// The seed is derived from (pixel, sample, frame) only, so the image does not depend on thread count or scheduling.
+class RandomGenerator {
+public:
+	RandomGenerator(uint pixel, uint sample, uint frame = 0);
+	~RandomGenerator() = default;
+
+	uint NextUint();
+	float NextFloat(); // random in [0, 1)
+
+private:
+	std::uint64_t m_state = 0;
+
+	static constexpr std::uint64_t MULTIPLIER = 6364136223846793005ull;
+	static constexpr std::uint64_t INCREMENT = 1442695040888963407ull;
+
+	static std::uint64_t Mix(std::uint64_t x);
+};
+
+inline RandomGenerator::RandomGenerator(uint pixel, uint sample, uint frame) {
+	std::uint64_t seed = Mix(((std::uint64_t)pixel << 32) | sample) ^ Mix((std::uint64_t)frame + INCREMENT);
+	m_state = seed + INCREMENT;
+	NextUint();
+}
+
+inline uint RandomGenerator::NextUint() {
+	std::uint64_t oldState = m_state;
+	m_state = oldState * MULTIPLIER + INCREMENT;
+	uint xorShifted = (uint)(((oldState >> 18u) ^ oldState) >> 27u);
+	uint rotation = (uint)(oldState >> 59u);
+	return (xorShifted >> rotation) | (xorShifted << ((32u - rotation) & 31u));
+}
+
+inline float RandomGenerator::NextFloat() {
+	// Top 24 bits fit the float mantissa exactly, so the result never rounds up to 1
+	return (NextUint() >> 8) * (1.0f / 16777216.0f);
+}
+
+// SplitMix64 finalizer, spreads neighbouring pixel/sample indices over the whole state space
+inline std::uint64_t RandomGenerator::Mix(std::uint64_t x) {
+	x += 0x9e3779b97f4a7c15ull;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	return x ^ (x >> 31);
+}
@@ -17,11 +17,6 @@ float Lerp(float start, float end, float t) {
 	return start + t * (end - start);
 }
 
-float GetRandomFloat() {
-	// random in [0, 1)
-	return std::rand() / (RAND_MAX + 1.0);
-}
-
 float DegreesToRadians(float degrees) {
 	return degrees * PI / 180.0f;
 }
@@ -5,16 +5,39 @@
 bool IsStringEqual(cstring left, cstring right);
 float Saturate(float x);
 float Lerp(float start, float end, float t);
-float GetRandomFloat();
 float DegreesToRadians(float degrees);
 
 vector<uchar> ReadFile(std::filesystem::path filePath, bool addNullTerminator = false);
 
 #ifdef STATS
 	struct Stats {
-		int primaryRayCounter = 0;
-		int sphereRayIntersectionCounter = 0;
-		int aabbRayIntersectionCounter = 0;
+		long long primaryRayCounter = 0;
+		long long shadowRayCounter = 0;
+		long long sphereRayIntersectionCounter = 0;
+		long long triangleRayIntersectionCounter = 0;
+		long long aabbRayIntersectionCounter = 0;
+		long long rayPacketCounter = 0;
+		// Nodes taken from the traversal stack, and the leaves among them whose primitives were tested
+		long long traversalStepCounter = 0;
+		long long leafVisitCounter = 0;
+
+		Stats& operator+=(const Stats& other);
+		// Work of one ray in units of a box or primitive test, what the traversal cost heatmap shows
+		long long GetTraversalCost() const { return aabbRayIntersectionCounter + sphereRayIntersectionCounter + triangleRayIntersectionCounter; }
 	};
-	inline Stats* stats;
+
+	inline Stats& Stats::operator+=(const Stats& other) {
+		primaryRayCounter += other.primaryRayCounter;
+		shadowRayCounter += other.shadowRayCounter;
+		sphereRayIntersectionCounter += other.sphereRayIntersectionCounter;
+		triangleRayIntersectionCounter += other.triangleRayIntersectionCounter;
+		aabbRayIntersectionCounter += other.aabbRayIntersectionCounter;
+		rayPacketCounter += other.rayPacketCounter;
+		traversalStepCounter += other.traversalStepCounter;
+		leafVisitCounter += other.leafVisitCounter;
+		return *this;
+	}
+
+	// Every render thread counts into its own Stats, which are merged once the frame is done
+	inline thread_local Stats* stats;
 #endif
\ No newline at end of file